@@ -0,0 +1,260 @@
+#include <benchmark/benchmark.h>
+
+#include <src/Board.h>
+#include <src/CardSequence.h>
+#include <src/GameDriverStrategy.h>
+#include <src/Hashing.h>
+#include <src/Rng.h>
+#include <src/StaticGameDriver.h>
+#include <src/TreeStrategy.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Benchmarks over a fixed corpus of positions taken from seeded random
+ * games, so numbers are comparable between runs and between commits.
+ * Micro benchmarks report time per operation (items/s is ops/s), the
+ * search ones nodes/s, the whole game ones games/s.
+ */
+
+namespace {
+
+  using ProdBoard = threes::game::Board<4>;
+  using BoardPtr = std::unique_ptr<ProdBoard>;
+  using SeqPtr = threes::game::ICardSequence<ProdBoard>::ICardSeqPtr;
+
+  static constexpr uint64_t CorpusSeed = 20240601;
+  static constexpr unsigned CorpusGames = 32;
+  static constexpr unsigned CorpusStride = 5; // keep every 5th position of a game
+
+  // a position and the card sequence as it stood there
+  struct Position {
+    BoardPtr board;
+    SeqPtr seq;
+  };
+
+  const std::vector<Position>& corpus() {
+    static const std::vector<Position> s_corpus = []() {
+      std::vector<Position> result;
+      for(unsigned game = 0; game < CorpusGames; ++game) {
+	threes::game::RngContext rng(threes::game::hashCombine(CorpusSeed, game));
+	SeqPtr seq(threes::game::Kamikaze28Sequence<ProdBoard>::create("default"));
+	seq->seed(rng());
+
+	std::vector<threes::game::Card> initialCards(9);
+	for(auto& card : initialCards) { card = seq->draw(nullptr); }
+	BoardPtr board(new ProdBoard(initialCards, threes::game::pickNRandomIndicies(9, 4, rng)));
+
+	for(unsigned move = 0; ; ++move) {
+	  std::vector<threes::game::ShiftDirection> valid;
+	  for(auto dir : {threes::game::DIRECTION_UP, threes::game::DIRECTION_DOWN,
+			  threes::game::DIRECTION_LEFT, threes::game::DIRECTION_RIGHT}) {
+	    if(board->canShift(dir)) { valid.push_back(dir); }
+	  }
+	  if(valid.empty()) { break; }
+	  if(move % CorpusStride == 0) {
+	    result.push_back(Position{ BoardPtr(new ProdBoard(*board)), seq->clone() });
+	  }
+	  const auto dir = valid[rng.uniformInt(0, valid.size()-1)];
+	  const threes::game::Card next = seq->draw(board);
+	  board->shiftBoard(dir, next, rng);
+	}
+      }
+      return result;
+    }();
+    return s_corpus;
+  }
+
+  void registerCreators() {
+    threes::game::ICardSequence<ProdBoard>::s_factory.registerCreator(
+      "k28d",
+      threes::game::Kamikaze28Sequence<ProdBoard>::create);
+    threes::game::IThreesStgy<ProdBoard>::s_factory.registerCreator(
+      "random",
+      threes::game::RandomStgy<ProdBoard>::create);
+    threes::game::IThreesStgy<ProdBoard>::s_factory.registerCreator(
+      "emtree",
+      threes::game::ExpectiMaxTree<ProdBoard>::create);
+
+    using SeqType = threes::game::Kamikaze28Sequence<ProdBoard>;
+    threes::game::registerStaticGames<ProdBoard, SeqType, threes::game::RandomStgy<ProdBoard>>("k28d/random");
+    threes::game::registerStaticGames<ProdBoard, SeqType, threes::game::ExpectiMaxTree<ProdBoard>>("k28d/emtree");
+  }
+
+  ////////////////////////////////////////////////////
+  // micro benchmarks
+
+  void BM_CanShift(benchmark::State& state) {
+    const auto& positions = corpus();
+    size_t i = 0;
+    for(auto _ : state) {
+      const ProdBoard& board = *positions[i].board;
+      for(auto dir : {threes::game::DIRECTION_UP, threes::game::DIRECTION_DOWN,
+		      threes::game::DIRECTION_LEFT, threes::game::DIRECTION_RIGHT}) {
+	benchmark::DoNotOptimize(board.canShift(dir));
+      }
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations() * threes::game::NUM_DIRECTIONS);
+  }
+  BENCHMARK(BM_CanShift);
+
+  // all four directions in one pass, compare with BM_CanShift
+  void BM_Moves(benchmark::State& state) {
+    const auto& positions = corpus();
+    size_t i = 0;
+    for(auto _ : state) {
+      benchmark::DoNotOptimize(positions[i].board->moves());
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations() * threes::game::NUM_DIRECTIONS);
+  }
+  BENCHMARK(BM_Moves);
+
+  // copy, slide and insert, in the first direction that moves
+  void BM_ShiftBoard(benchmark::State& state) {
+    const auto& positions = corpus();
+    threes::game::RngContext rng(CorpusSeed);
+    size_t i = 0;
+    for(auto _ : state) {
+      ProdBoard board(*positions[i].board);
+      for(auto dir : {threes::game::DIRECTION_UP, threes::game::DIRECTION_DOWN,
+		      threes::game::DIRECTION_LEFT, threes::game::DIRECTION_RIGHT}) {
+	if(board.canShift(dir)) {
+	  board.shiftBoard(dir, threes::game::Card(1), rng);
+	  break;
+	}
+      }
+      benchmark::DoNotOptimize(board);
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK(BM_ShiftBoard);
+
+  void BM_SequenceDraw(benchmark::State& state) {
+    const auto& positions = corpus();
+    SeqPtr seq(positions[0].seq->clone());
+    size_t i = 0;
+    for(auto _ : state) {
+      benchmark::DoNotOptimize(seq->draw(positions[i].board));
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK(BM_SequenceDraw);
+
+  void BM_SequenceClone(benchmark::State& state) {
+    const auto& positions = corpus();
+    size_t i = 0;
+    for(auto _ : state) {
+      SeqPtr copy(positions[i].seq->clone());
+      benchmark::DoNotOptimize(copy.get());
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK(BM_SequenceClone);
+
+  void BM_SequenceAssignFrom(benchmark::State& state) {
+    const auto& positions = corpus();
+    SeqPtr seq(positions[0].seq->clone());
+    size_t i = 0;
+    for(auto _ : state) {
+      seq->assignFrom(*positions[i].seq);
+      benchmark::DoNotOptimize(seq.get());
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK(BM_SequenceAssignFrom);
+
+  void BM_ValueFunction(benchmark::State& state, const std::string& eval) {
+    const auto& positions = corpus();
+    threes::game::ExpectiMaxTree<ProdBoard> tree(
+      threes::game::ExpectiMaxConfig::fromStr("1;1;eval=" + eval));
+    size_t i = 0;
+    for(auto _ : state) {
+      benchmark::DoNotOptimize(tree.valueFunction(*positions[i].board));
+      if(++i == positions.size()) { i = 0; }
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK_CAPTURE(BM_ValueFunction, heuristic, std::string("heuristic"));
+  BENCHMARK_CAPTURE(BM_ValueFunction, lut, std::string("lut"));
+
+  ////////////////////////////////////////////////////
+  // search
+
+  // expectedValue of every valid move at each position, arg 0 is depth
+  void BM_ExpectedValue(benchmark::State& state, const std::string& opts) {
+    const auto& positions = corpus();
+    const unsigned depth = state.range(0);
+    threes::game::ExpectiMaxTree<ProdBoard> tree(
+      threes::game::ExpectiMaxConfig::fromStr(std::to_string(depth) + ";1" + opts));
+    size_t i = 0;
+    for(auto _ : state) {
+      const Position& pos = positions[i];
+      for(auto dir : {threes::game::DIRECTION_UP, threes::game::DIRECTION_DOWN,
+		      threes::game::DIRECTION_LEFT, threes::game::DIRECTION_RIGHT}) {
+	if(pos.board->canShift(dir)) {
+	  benchmark::DoNotOptimize(tree.expectedValue(*pos.board, *pos.seq, dir, depth));
+	}
+      }
+      if(++i == positions.size()) { i = 0; }
+    }
+    // the node count isn't reset outside of move(), so it covers every iteration
+    state.counters["nodes/s"] = benchmark::Counter(tree.lastSearchNodes(), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations());
+  }
+  BENCHMARK_CAPTURE(BM_ExpectedValue, sampled, std::string(""))->DenseRange(1, 3)->Unit(benchmark::kMicrosecond);
+  BENCHMARK_CAPTURE(BM_ExpectedValue, exact, std::string(";exact"))->DenseRange(1, 2)->Unit(benchmark::kMicrosecond);
+  BENCHMARK_CAPTURE(BM_ExpectedValue, exact_lut, std::string(";exact;eval=lut"))->DenseRange(1, 2)->Unit(benchmark::kMicrosecond);
+
+  ////////////////////////////////////////////////////
+  // whole games
+
+  // games/s through GameDriverStgy with the given strategy
+  void BM_FullGame(benchmark::State& state, const std::string& stgyName, const std::string& stgyArgs) {
+    uint64_t game = 0;
+    for(auto _ : state) {
+      threes::game::IThreesStgy<ProdBoard>::ThreesStgyPtr
+	stgyPtr(threes::game::IThreesStgy<ProdBoard>::s_factory.create(stgyName, stgyArgs));
+      threes::game::GameDriverStgy<ProdBoard> driver("k28d", "default", 9, stgyPtr, false,
+						     threes::game::hashCombine(CorpusSeed, game++));
+      benchmark::DoNotOptimize(driver.play());
+    }
+    state.counters["games/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  }
+  BENCHMARK_CAPTURE(BM_FullGame, random, std::string("random"), std::string(""))->Unit(benchmark::kMicrosecond);
+  BENCHMARK_CAPTURE(BM_FullGame, emtree_1, std::string("emtree"), std::string("1;1;exact"))->Unit(benchmark::kMillisecond);
+  BENCHMARK_CAPTURE(BM_FullGame, emtree_2, std::string("emtree"), std::string("2;1;exact;eval=lut"))->Unit(benchmark::kMillisecond);
+
+  // the same games through StaticGameDriver, looked up by name once and
+  // bound at compile time from there on
+  void BM_FullGameStatic(benchmark::State& state, const std::string& stgyName, const std::string& stgyArgs) {
+    threes::game::IStaticGames<ProdBoard>::StaticGamesPtr
+      games(threes::game::IStaticGames<ProdBoard>::s_factory.create("k28d/" + stgyName, stgyArgs));
+    uint64_t game = 0;
+    for(auto _ : state) {
+      benchmark::DoNotOptimize(games->play("default", 9, threes::game::hashCombine(CorpusSeed, game++), false));
+    }
+    state.counters["games/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  }
+  BENCHMARK_CAPTURE(BM_FullGameStatic, random, std::string("random"), std::string(""))->Unit(benchmark::kMicrosecond);
+  BENCHMARK_CAPTURE(BM_FullGameStatic, emtree_1, std::string("emtree"), std::string("1;1;exact"))->Unit(benchmark::kMillisecond);
+
+} // anon ns
+
+int main(int argc, char** argv) {
+  registerCreators();
+  corpus(); // build it before anything is timed
+
+  benchmark::Initialize(&argc, argv);
+  if(benchmark::ReportUnrecognizedArguments(argc, argv)) { return 1; }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <src/GameDriverStrategy.h>
+#include <src/TreeStrategy.h>
+#include <src/Board.h>
+// every heap allocation made while a search is running gets counted
+#include <src/AllocationCounter.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Times ExpectiMaxTree searches over seeded games and reports allocations
+// per move, which should be zero once the search arena has warmed up.
+// usage: bench_search [emtree args] [moves] [seed]
+int main(int argc, char** argv) {
+  using ProdBoard = threes::game::Board<4>;
+
+  std::string stgyArgs("3;4");
+  unsigned numMoves = 200;
+  uint64_t seed = 1;
+  if(argc > 1) { stgyArgs = argv[1]; }
+  if(argc > 2) { numMoves = std::stoi(argv[2]); }
+  if(argc > 3) { seed = std::stoull(argv[3]); }
+
+  threes::game::ICardSequence<ProdBoard>::s_factory.registerCreator(
+    "k28d",
+    threes::game::Kamikaze28Sequence<ProdBoard>::create);
+
+  threes::game::ExpectiMaxTree<ProdBoard> stgy(threes::game::ExpectiMaxConfig::fromStr(stgyArgs));
+
+  unsigned movesDone = 0;
+  double searchSeconds = 0.0;
+  for(uint64_t game = 0; movesDone < numMoves; ++game) {
+    // plays the game the same way GameDriver does, just with the search timed
+    threes::game::RngContext boardRng(threes::game::hashCombine(seed, game));
+    threes::game::ICardSequence<ProdBoard>::ICardSeqPtr seqPtr(
+      threes::game::ICardSequence<ProdBoard>::s_factory.create("k28d", "default") );
+    seqPtr->seed(boardRng());
+    std::vector<threes::game::Card> initialCards;
+    for(unsigned i = 0; i < 9; ++i) { initialCards.push_back(seqPtr->draw(nullptr)); }
+    threes::game::GameDriver<ProdBoard>::BoardPtr boardPtr(
+      new ProdBoard(initialCards, threes::game::pickNRandomIndicies(9, ProdBoard::dim, boardRng)) );
+    stgy.seed(boardRng());
+
+    while(boardPtr->moves().any() && movesDone < numMoves) {
+      // the first search of the run sizes the arena, leave it out
+      const bool measured = (movesDone > 0);
+      const auto start = std::chrono::steady_clock::now();
+      s_countAllocations = measured;
+      const threes::game::ShiftDirection dir = stgy.move(boardPtr, seqPtr);
+      s_countAllocations = false;
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if(measured) { searchSeconds += elapsed.count(); }
+
+      const threes::game::Card toInsert = seqPtr->draw(boardPtr);
+      boardPtr->shiftBoard(dir, toInsert, boardRng);
+      ++movesDone;
+    }
+  }
+  const unsigned measuredMoves = numMoves > 1 ? numMoves - 1 : 1;
+  std::cout << "emtree " << stgyArgs << ": " << measuredMoves << " searches, "
+	    << (searchSeconds * 1e6) / measuredMoves << " us/move, "
+	    << static_cast<double>(s_allocations) / measuredMoves << " allocations/move"
+	    << std::endl;
+  return 0;
+}
@@ -1,7 +1,11 @@
 #include <src/GameDriverStrategy.h>
 #include <src/TreeStrategy.h>
+#include <src/MCTSStrategy.h>
+#include <src/BatchRunner.h>
+#include <src/StaticGameDriver.h>
 #include <src/Board.h>
 
+#include <fstream>
 #include <string>
 
 template<typename BOARD>
@@ -17,30 +21,107 @@ void registerCreators() {
   threes::game::IThreesStgy<BOARD>::s_factory.registerCreator(
     "emtree",
     threes::game::ExpectiMaxTree<BOARD>::create);
+
+  threes::game::IThreesStgy<BOARD>::s_factory.registerCreator(
+    "mcts",
+    threes::game::MCTSStrategy<BOARD>::create);
+
+  // the same strategies for batch mode's static driver
+  using SeqType = threes::game::Kamikaze28Sequence<BOARD>;
+  threes::game::registerStaticGames<BOARD, SeqType, threes::game::RandomStgy<BOARD>>("k28d/random");
+  threes::game::registerStaticGames<BOARD, SeqType, threes::game::ExpectiMaxTree<BOARD>>("k28d/emtree");
+  threes::game::registerStaticGames<BOARD, SeqType, threes::game::MCTSStrategy<BOARD>>("k28d/mcts");
+}
+
+void writeStats(const threes::game::SearchStats& stats, const std::string& path) {
+  if(path.empty()) { return; }
+  if(path == "-") {
+    stats.writeJson(std::cout);
+    return;
+  }
+  std::ofstream out(path);
+  stats.writeJson(out);
+  if(!out.good()) { std::cerr << "couldn't write stats to " << path << std::endl; }
 }
 
+// usage: stgy_main [repeats] [strategy] [strategy args] [threads] [seed] [record file] [archive file]
+//                  [stats file] [driver]
+// Giving a thread count switches to batch mode: games are spread over that
+// many workers and only the aggregate results are printed. A nonzero seed
+// makes the run reproducible. A record file gets a binary log of every game
+// (see GameRecord.h), an archive file the much smaller seed + moves form
+// (see ReplayArchive.h). Either can be "" to skip it. A stats file gets the
+// search counters and move latencies of the whole run as JSON ("-" for stdout).
+// A driver of "static" plays batch mode games through StaticGameDriver (see
+// StaticGameDriver.h), which can't record or archive.
 int main(int argc, char** argv) {
 
   unsigned repeats=1;
   std::string stgyName("random");
   std::string stgyArgs("");
+  unsigned numThreads=0;
+  uint64_t seed=0;
+  std::string recordPath("");
+  std::string archivePath("");
+  std::string statsPath("");
+  bool staticGames = false;
   if(argc > 1) { repeats = std::stoi(argv[1]); }
   if(argc > 2) { stgyName = argv[2]; }
   if(argc > 3) { stgyArgs = argv[3]; }
+  if(argc > 4) { numThreads = std::stoi(argv[4]); }
+  if(argc > 5) { seed = std::stoull(argv[5]); }
+  if(argc > 6) { recordPath = argv[6]; }
+  if(argc > 7) { archivePath = argv[7]; }
+  if(argc > 8) { statsPath = argv[8]; }
+  if(argc > 9) { staticGames = (std::string(argv[9]) == "static"); }
+  if(seed == 0) { seed = threes::game::RngContext::randomSeed(); }
 
-  std::cout << "Running strategy " << stgyName << " with args " << stgyArgs << std::endl;
+  std::cout << "Running strategy " << stgyName << " with args " << stgyArgs
+	    << " seed " << seed << std::endl;
 
   using ProdBoard = threes::game::Board<4>;
   registerCreators<ProdBoard>();
 
+  if(numThreads > 0) {
+    threes::game::BatchConfig config;
+    config.numGames = repeats;
+    config.numThreads = numThreads;
+    config.stgyName = stgyName;
+    config.stgyArgs = stgyArgs;
+    config.seed = seed;
+    config.recordPath = recordPath;
+    config.archivePath = archivePath;
+    config.staticGames = staticGames;
+
+    const threes::game::BatchResult result = threes::game::runBatch<ProdBoard>(config);
+    result.print(std::cout);
+    writeStats(result.stats, statsPath);
+    return 0;
+  }
+
+  threes::game::SearchStats stats;
+  std::unique_ptr<threes::game::GameRecordWriter> recorder;
+  if(!recordPath.empty()) {
+    recorder.reset(new threes::game::GameRecordWriter(recordPath, ProdBoard::dim));
+  }
+  std::unique_ptr<threes::game::ReplayArchiveWriter> archive;
+  if(!archivePath.empty()) {
+    archive.reset(new threes::game::ReplayArchiveWriter(archivePath, ProdBoard::dim, "k28d", "default", 9));
+  }
+
   for(unsigned i = 0; i < repeats; ++i) {
     threes::game::IThreesStgy<ProdBoard>::ThreesStgyPtr
       stgyPtr(threes::game::IThreesStgy<ProdBoard>::s_factory.create(stgyName, stgyArgs) );
   
-    std::unique_ptr<threes::game::GameDriver<ProdBoard>> game(
-      new threes::game::GameDriverStgy<ProdBoard>("k28d", "default", 9, stgyPtr) );
+    std::unique_ptr<threes::game::GameDriverStgy<ProdBoard>> game(
+      new threes::game::GameDriverStgy<ProdBoard>("k28d", "default", 9, stgyPtr, true,
+						  threes::game::hashCombine(seed, i)) );
+    game->setRecorder(recorder.get());
+    game->setArchive(archive.get());
       
     game->play();
+    stats.merge(game->releaseStgy()->stats());
   }
+  writeStats(stats, statsPath);
 
 }
@@ -0,0 +1,52 @@
+#include <src/GameDriverStrategy.h>
+#include <src/TreeStrategy.h>
+#include <src/MCTSStrategy.h>
+#include <src/Tournament.h>
+#include <src/Board.h>
+
+#include <iostream>
+#include <string>
+
+template<typename BOARD>
+void registerCreators() {
+  threes::game::ICardSequence<BOARD>::s_factory.registerCreator(
+    "k28d",
+    threes::game::Kamikaze28Sequence<BOARD>::create);
+
+  threes::game::IThreesStgy<BOARD>::s_factory.registerCreator(
+    "random",
+    threes::game::RandomStgy<BOARD>::create);
+
+  threes::game::IThreesStgy<BOARD>::s_factory.registerCreator(
+    "emtree",
+    threes::game::ExpectiMaxTree<BOARD>::create);
+
+  threes::game::IThreesStgy<BOARD>::s_factory.registerCreator(
+    "mcts",
+    threes::game::MCTSStrategy<BOARD>::create);
+}
+
+// Plays two strategies against each other until a sequential test tells
+// them apart (see Tournament.h).
+// usage: tournament [strategy] [strategy args] [other strategy] [other args] [settings]
+// settings are ';' delimited, e.g. "games=10000;threads=8;score=250;card=384;rate=0.05;seed=1",
+// add "paired" to play both on the same games with common random numbers
+int main(int argc, char** argv) {
+  std::string settings("");
+  if(argc > 5) { settings = argv[5]; }
+  threes::game::TournamentConfig config = threes::game::TournamentConfig::fromStr(settings);
+  config.stgyNames[1] = "emtree";
+  config.stgyArgs[1] = "1;1";
+  if(argc > 1) { config.stgyNames[0] = argv[1]; }
+  if(argc > 2) { config.stgyArgs[0] = argv[2]; }
+  if(argc > 3) { config.stgyNames[1] = argv[3]; }
+  if(argc > 4) { config.stgyArgs[1] = argv[4]; }
+
+  using ProdBoard = threes::game::Board<4>;
+  registerCreators<ProdBoard>();
+
+  const threes::game::TournamentResult result =
+    threes::game::runTournament<ProdBoard>(config, &std::cout);
+  result.print(std::cout);
+  return 0;
+}
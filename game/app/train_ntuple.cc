@@ -0,0 +1,53 @@
+#include <src/CardSequence.h>
+#include <src/NTupleNetwork.h>
+#include <src/PackedBoard.h>
+#include <src/TDTrainer.h>
+
+#include <iostream>
+#include <string>
+
+// Trains an n-tuple network by TD self-play and saves it for
+// "emtree" with eval=ntuple;weights=<file>.
+// usage: train_ntuple [games] [threads] [out file] [alpha] [lambda] [seed] [in file]
+// Giving an input file continues training from those weights.
+int main(int argc, char** argv) {
+  using TrainBoard = threes::game::PackedBoard4<>;
+
+  threes::game::TDConfig config;
+  config.numGames = 10000;
+  std::string outPath("ntuple.bin");
+  std::string inPath;
+  if(argc > 1) { config.numGames = std::stoi(argv[1]); }
+  if(argc > 2) { config.numThreads = std::stoi(argv[2]); }
+  if(argc > 3) { outPath = argv[3]; }
+  if(argc > 4) { config.alpha = std::stof(argv[4]); }
+  if(argc > 5) { config.lambda = std::stof(argv[5]); }
+  if(argc > 6) { config.seed = std::stoull(argv[6]); }
+  if(argc > 7) { inPath = argv[7]; }
+
+  threes::game::ICardSequence<TrainBoard>::s_factory.registerCreator(
+    "k28d",
+    threes::game::Kamikaze28Sequence<TrainBoard>::create);
+
+  threes::game::NTupleNetwork::NTupleNetworkPtr net;
+  if(!inPath.empty()) {
+    net = threes::game::NTupleNetwork::load(inPath);
+    if(!net) {
+      std::cerr << "couldn't load n-tuple weights from " << inPath << std::endl;
+      return 1;
+    }
+  } else {
+    net.reset(new threes::game::NTupleNetwork());
+  }
+
+  const threes::game::TDResult result = threes::game::trainTD<TrainBoard>(*net, config, &std::cout);
+  std::cout << "trained " << result.scores.size() << " games in " << result.seconds
+	    << " s, seed " << result.seed << std::endl;
+
+  if(!net->save(outPath)) {
+    std::cerr << "couldn't write " << outPath << std::endl;
+    return 1;
+  }
+  std::cout << "wrote " << outPath << std::endl;
+  return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Replaces every global operator new/delete the language has (plain,
+ * array, sized and nothrow; the aligned forms only arrive with C++17) with
+ * malloc/free versions that count each allocation made while
+ * s_countAllocations is set, so a test or benchmark can check a block of
+ * code doesn't allocate.
+ *
+ * The replacements are definitions, include this from exactly one
+ * translation unit of a binary.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+  std::atomic<bool> s_countAllocations(false);
+  std::atomic<unsigned long> s_allocations(0);
+
+  void* countedAlloc(std::size_t size) noexcept {
+    if(s_countAllocations) { ++s_allocations; }
+    return std::malloc(size == 0 ? 1 : size);
+  }
+}
+
+// GCC pairs the frees below with the operator new they were inlined in to
+// and warns at -O2, though every replacement is malloc/free underneath
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+  void* ptr = countedAlloc(size);
+  if(!ptr) { throw std::bad_alloc(); }
+  return ptr;
+}
+void* operator new[](std::size_t size) {
+  void* ptr = countedAlloc(size);
+  if(!ptr) { throw std::bad_alloc(); }
+  return ptr;
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+#pragma GCC diagnostic pop
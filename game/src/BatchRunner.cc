@@ -0,0 +1,64 @@
+#include "BatchRunner.h"
+
+#include <cmath>
+
+namespace threes {
+  namespace game {
+
+    uint64_t BatchResult::scorePercentile(const double p) const {
+      if(scores.empty()) { return 0; }
+      std::vector<uint64_t> sorted(scores);
+      std::sort(sorted.begin(), sorted.end());
+
+      const double rank = std::ceil( (p / 100.0) * sorted.size() );
+      const size_t idx = rank < 1.0 ? 0 : static_cast<size_t>(rank) - 1;
+      return sorted[std::min(idx, sorted.size()-1)];
+    }
+
+    double BatchResult::meanScore() const {
+      if(scores.empty()) { return 0.0; }
+      double total = 0.0;
+      for(auto score : scores) { total += score; }
+      return total / scores.size();
+    }
+
+    std::map<unsigned, unsigned> BatchResult::maxCardHistogram() const {
+      std::map<unsigned, unsigned> histogram;
+      for(auto maxCard : maxCards) { ++histogram[maxCard]; }
+      return histogram;
+    }
+
+    void BatchResult::append(const BatchResult& other) {
+      scores.insert(scores.end(), other.scores.begin(), other.scores.end());
+      maxCards.insert(maxCards.end(), other.maxCards.begin(), other.maxCards.end());
+      seconds += other.seconds;
+      numThreads = std::max(numThreads, other.numThreads);
+      if(seed == 0) { seed = other.seed; }
+      stats.merge(other.stats);
+    }
+
+    void BatchResult::print(std::ostream& out) const {
+      const std::streamsize oldPrecision = out.precision();
+      out << "Played " << scores.size() << " games on " << numThreads << " threads in "
+	  << std::fixed << std::setprecision(2) << seconds << "s ("
+	  << gamesPerSecond() << " games/s), seed " << seed << std::endl;
+
+      out << "Score mean " << meanScore() << std::endl;
+      out << "Score percentiles:";
+      for(double p : {0.0, 10.0, 25.0, 50.0, 75.0, 90.0, 99.0, 100.0}) {
+	out << " p" << static_cast<unsigned>(p) << "=" << scorePercentile(p);
+      }
+      out << std::endl;
+
+      out << "Max card histogram:" << std::endl;
+      for(const auto& bin : maxCardHistogram()) {
+	out << std::setw(8) << bin.first << " : " << std::setw(8) << bin.second
+	    << " (" << std::setprecision(1) << (100.0 * bin.second) / maxCards.size() << "%)"
+	    << std::endl;
+      }
+      out.unsetf(std::ios_base::floatfield);
+      out.precision(oldPrecision);
+    }
+
+  } // ns game
+} // ns threes
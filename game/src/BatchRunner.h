@@ -0,0 +1,173 @@
+#pragma once
+
+/*
+ * Plays many automated games across a pool of worker threads and
+ * summarizes the results.
+ */
+
+#include "Board.h"
+#include "Card.h"
+#include "GameDriverStrategy.h"
+#include "GameRecord.h"
+#include "ReplayArchive.h"
+#include "Hashing.h"
+#include "Rng.h"
+#include "SearchStats.h"
+#include "StaticGameDriver.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    struct BatchConfig {
+      unsigned numGames = 1;
+      unsigned numThreads = 1;
+      std::string stgyName = "random";
+      std::string stgyArgs = "";
+      std::string seqName = "k28d";
+      std::string seqArgs = "default";
+      unsigned numStartCards = 9;
+      uint64_t seed = 0; // 0 picks a random one, game i is seeded from (seed, firstGame + i)
+      unsigned firstGame = 0; // so a run split over several batches plays the same games
+      bool commonRandom = false; // see GameDriver::setCommonRandom
+      // play through the StaticGames registered as "<seqName>/<stgyName>"
+      // (see StaticGameDriver.h) rather than GameDriverStgy. No records,
+      // archives or move latencies.
+      bool staticGames = false;
+      std::string recordPath = ""; // if set, every game is logged there (see GameRecord.h)
+      std::string archivePath = ""; // if set, every game's seed and moves are archived (see ReplayArchive.h)
+    };
+
+    struct BatchResult {
+      std::vector<uint64_t> scores;    // one per game, in game order
+      std::vector<unsigned> maxCards;  // one per game, in game order
+      double seconds = 0.0;
+      unsigned numThreads = 0;
+      uint64_t seed = 0;               // replays the whole batch exactly
+      SearchStats stats;               // every worker's strategy stats summed
+
+      // nearest rank percentile, p in [0,100]
+      uint64_t scorePercentile(const double p) const;
+      double meanScore() const;
+      std::map<unsigned, unsigned> maxCardHistogram() const;
+      double gamesPerSecond() const { return seconds > 0.0 ? scores.size() / seconds : 0.0; }
+
+      // adds other's games after these, for a run played in several batches
+      void append(const BatchResult& other);
+
+      void print(std::ostream& out) const;
+    };
+
+    // Games are handed out one at a time from a shared counter, so a worker
+    // stuck on a long game doesn't hold up the rest. Every worker creates its
+    // own strategy through IThreesStgy<BOARD>::s_factory and reuses it for all
+    // the games it plays; each game gets a fresh card sequence from
+    // ICardSequence<BOARD>::s_factory.
+    template<class BOARD>
+    BatchResult runBatch(const BatchConfig& config);
+
+
+    //////////////////////////////////////////////////////////
+    // implementations
+    //////////////////////////////////////////////////////////
+
+    template<class BOARD>
+    BatchResult runBatch(const BatchConfig& config) {
+      ASSERT(config.numThreads > 0, "need at least one worker thread");
+
+      BatchResult result;
+      result.scores.resize(config.numGames, 0);
+      result.maxCards.resize(config.numGames, 0);
+      result.numThreads = std::min(config.numThreads, std::max(config.numGames, 1u));
+
+      const uint64_t batchSeed = config.seed != 0 ? config.seed : RngContext::randomSeed();
+      result.seed = batchSeed;
+
+      ASSERT(!config.staticGames || (config.recordPath.empty() && config.archivePath.empty()),
+	     "static games can't be recorded or archived");
+
+      // games land in the record in the order they finish
+      std::unique_ptr<GameRecordWriter> recorder;
+      if(!config.recordPath.empty()) {
+	recorder.reset(new GameRecordWriter(config.recordPath, BOARD::dim));
+	ASSERT(recorder->good(), std::string("couldn't open game record file ") + config.recordPath);
+      }
+      std::unique_ptr<ReplayArchiveWriter> archive;
+      if(!config.archivePath.empty()) {
+	// the archive doesn't say which streams a game used
+	ASSERT(!config.commonRandom, "replay archives only hold games with the default random streams");
+	archive.reset(new ReplayArchiveWriter(config.archivePath, BOARD::dim, config.seqName,
+					      config.seqArgs, config.numStartCards));
+	ASSERT(archive->good(), std::string("couldn't open replay archive ") + config.archivePath);
+      }
+
+      std::atomic<unsigned> nextGame(0);
+      std::mutex statsMutex;
+      auto staticWorker = [&config, &result, &nextGame, &statsMutex, batchSeed]() {
+	// the only lookup, every game after this is statically bound
+	typename IStaticGames<BOARD>::StaticGamesPtr games(
+	  IStaticGames<BOARD>::s_factory.create(config.seqName + "/" + config.stgyName, config.stgyArgs) );
+
+	for(unsigned gameIdx = nextGame++; gameIdx < config.numGames; gameIdx = nextGame++) {
+	  result.scores[gameIdx] = games->play(config.seqArgs, config.numStartCards,
+					       hashCombine(batchSeed, config.firstGame + gameIdx),
+					       config.commonRandom);
+	  result.maxCards[gameIdx] = games->board().maxCard().value;
+	}
+	std::lock_guard<std::mutex> lock(statsMutex);
+	result.stats.merge(games->stats());
+      };
+
+      auto worker = [&config, &result, &nextGame, &recorder, &archive, &statsMutex, batchSeed]() {
+	typename IThreesStgy<BOARD>::ThreesStgyPtr stgyPtr(
+	  IThreesStgy<BOARD>::s_factory.create(config.stgyName, config.stgyArgs) );
+
+	for(unsigned gameIdx = nextGame++; gameIdx < config.numGames; gameIdx = nextGame++) {
+	  GameDriverStgy<BOARD> game(config.seqName, config.seqArgs, config.numStartCards,
+				     stgyPtr, false, hashCombine(batchSeed, config.firstGame + gameIdx));
+	  game.setCommonRandom(config.commonRandom);
+	  game.setRecorder(recorder.get());
+	  game.setArchive(archive.get());
+	  // each slot is written by exactly one worker
+	  result.scores[gameIdx] = game.play();
+	  result.maxCards[gameIdx] = game.board().maxCard().value;
+	  stgyPtr = game.releaseStgy();
+	}
+	// once per worker, the strategy kept its own counts until now
+	std::lock_guard<std::mutex> lock(statsMutex);
+	result.stats.merge(stgyPtr->stats());
+      };
+
+      const auto start = std::chrono::steady_clock::now();
+
+      std::vector<std::thread> workers;
+      for(unsigned i = 1; i < result.numThreads; ++i) {
+	if(config.staticGames) { workers.emplace_back(staticWorker); }
+	else { workers.emplace_back(worker); }
+      }
+      // calling thread does its share too
+      if(config.staticGames) { staticWorker(); }
+      else { worker(); }
+      for(auto& thread : workers) {
+	thread.join();
+      }
+
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      result.seconds = elapsed.count();
+      return result;
+    }
+
+  } // ns game
+} // ns threes
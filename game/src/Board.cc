@@ -6,6 +6,12 @@ threes::game::Board<5> b(std::vector<threes::game::Card>{});
 
 std::vector<unsigned> threes::game::pickNRandomIndicies(const unsigned n,
 							const unsigned dim) {
+  return pickNRandomIndicies(n, dim, defaultRngContext());
+}
+
+std::vector<unsigned> threes::game::pickNRandomIndicies(const unsigned n,
+							const unsigned dim,
+							RngContext& rng) {
   // shuffle the indices 0 .. (DIM*DIM)-1 and select the first numStartCards of them
   // to place the initial cards.
   std::vector<unsigned> oneToN(dim*dim);
@@ -13,8 +19,7 @@ std::vector<unsigned> threes::game::pickNRandomIndicies(const unsigned n,
   
   // Inefficient if DIM*DIM very big and numStartCards small, but practical for
   // reasonable cases and only called once per game.
-  std::shuffle(std::begin(oneToN), std::end(oneToN),
-	       std::mt19937{ std::random_device{}() } );
+  std::shuffle(std::begin(oneToN), std::end(oneToN), rng);
   
   std::vector<unsigned> result(n);
   std::copy( oneToN.begin(), oneToN.begin()+n, result.begin() );
@@ -5,13 +5,18 @@
  */
 
 #include <array>
+#include <cstdint>
 #include <random>
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <type_traits>
 
 #include "Utils.h"
+#include "BoardFeatures.h"
 #include "Card.h"
+#include "RowTable.h"
+#include "Rng.h"
 
 namespace threes {
   namespace game {
@@ -24,7 +29,54 @@ namespace threes {
       NUM_DIRECTIONS
     };
 
+    // Where the tiles of each slice lie for a shift in DIR, all known at
+    // compile time. Slice i is row i (LEFT/RIGHT) or column i (UP/DOWN), and
+    // tile(i, 0) is the tile against the wall the cards move toward, with
+    // tile(i, k) stepping away from it.
+    template<unsigned DIM, ShiftDirection DIR>
+    struct ShiftGeometry {
+      static constexpr bool vertical = (DIR == DIRECTION_UP || DIR == DIRECTION_DOWN);
+      static constexpr bool reversed = (DIR == DIRECTION_DOWN || DIR == DIRECTION_RIGHT);
+
+      static constexpr unsigned tile(const unsigned slice, const unsigned k) {
+	return vertical ?
+	  slice + DIM * (reversed ? DIM-1-k : k) :
+	  DIM*slice + (reversed ? DIM-1-k : k);
+      }
+    };
+
+    // Every direction's legality and moving slices from one scan of the
+    // board (see Board::moves). moved[d] has bit i set when slice i (as
+    // numbered in ShiftGeometry) shifts in direction d, so it is also the
+    // set of insertion slots before the same-slice rule narrows it (see
+    // Board::insertCandidates). A direction is legal when any slice moves.
+    struct MoveSet {
+      std::array<unsigned, NUM_DIRECTIONS> moved{{0, 0, 0, 0}};
+      unsigned legal = 0; // bit d <=> direction d is legal
+
+      bool canShift(const ShiftDirection dir) const { return legal & (1u << dir); }
+      bool any() const { return legal != 0; }
+      unsigned count() const { return __builtin_popcount(legal); }
+    };
+
+    // calls f(std::integral_constant<unsigned, i>()) for i = 0 .. N-1, so the
+    // body sees i as a compile time constant
+    template<unsigned N>
+    struct Unroll {
+      template<class F>
+      static void apply(F&& f) {
+	Unroll<N-1>::apply(f);
+	f(std::integral_constant<unsigned, N-1>());
+      }
+    };
+    template<>
+    struct Unroll<0> {
+      template<class F>
+      static void apply(F&&) {}
+    };
+
     // helper to select some random indices for initial card insert
+    std::vector<unsigned> pickNRandomIndicies(const unsigned n, const unsigned dim, RngContext& rng);
     std::vector<unsigned> pickNRandomIndicies(const unsigned n, const unsigned dim);
 
     /* 
@@ -49,6 +101,10 @@ namespace threes {
       Board(const std::vector<Card>& initialCards,
 	    const std::vector<unsigned>& insertLocations = std::vector<unsigned>(0) );
 
+      // Build directly from a full set of tiles, e.g. when converting
+      // from another board representation. maxCard() is taken from the tiles.
+      explicit Board(const storage_t& data);
+
       // const access to underlying data
     public:
       const storage_t& underlyingDataRef() const {
@@ -59,8 +115,9 @@ namespace threes {
       unsigned write_binary(std::ostream& out) const {
 	if(!out.good()) { return 0; }
 	
-	out.write( reinterpret_cast<char*>(m_data.data()), sizeof(unsigned)*DIM*DIM );
-	out << m_prevInsertIdx << m_prevDir;
+	out.write( reinterpret_cast<const char*>(m_data.data()), sizeof(unsigned)*DIM*DIM );
+	out.write( reinterpret_cast<const char*>(&m_prevInsertIdx), sizeof(m_prevInsertIdx) );
+	out.write( reinterpret_cast<const char*>(&m_prevDir), sizeof(m_prevDir) );
 	return StateSize;
       }
       
@@ -85,12 +142,50 @@ namespace threes {
       // utilites for actually playing the game  
     public:
       bool canShift(const ShiftDirection dir) const;
+      // canShift and the moving slices for all four directions at once,
+      // cheaper than even one canShift
+      MoveSet moves() const;
 
       // (hacky?) helper for some random sequence algorithms
       // (importantly, the offical one)
       const Card& maxCard() const { return m_max; }
+
+      // Value function features, kept up to date as cards move (see
+      // BoardFeatures.h). Ranks are per cardRank, so they assume the
+      // standard 1/2/3*2^n card values.
+      unsigned numEmpty() const { return countTiles(m_rankMasks[0]); }
+      tile_mask_t occupiedMask() const { return ~m_rankMasks[0] & TileMasks<DIM>::all(); }
+      tile_mask_t rankMask(const unsigned rank) const { return m_rankMasks[rank]; }
+      std::array<unsigned, 3> topThreeValues() const;
+      // lineFeatureScore summed over every row and column. Only the lines
+      // changed since the last call get rescanned.
+      int lineScores() const;
+
+      // the game score, cardScore summed over the tiles, kept up to date
+      // as cards merge and get inserted
+      uint64_t score() const { return m_score; }
       
-      void shiftBoard(const ShiftDirection dir, const Card insertVal);
+      // the insertion slot is drawn from rng, the two argument version
+      // uses this thread's defaultRngContext()
+      void shiftBoard(const ShiftDirection dir, const Card insertVal, RngContext& rng);
+      void shiftBoard(const ShiftDirection dir, const Card insertVal) {
+	shiftBoard(dir, insertVal, defaultRngContext());
+      }
+      // same, with moves() of this board already in hand so the slices
+      // needn't be checked again
+      void shiftBoard(const MoveSet& moves, const ShiftDirection dir, const Card insertVal,
+		      RngContext& rng);
+
+      // shiftBoard split in to its deterministic steps, for search that
+      // enumerates every insertion slot rather than sampling one.
+      // shiftTiles slides the cards and returns a mask of the slices that
+      // moved (bit i <=> row/col i), insertCandidates narrows that to the
+      // slices the new card may go in, insertCard places it in one of them.
+      unsigned shiftTiles(const ShiftDirection dir);
+      // shifts just the slices in movedMask, which must be moves().moved[dir]
+      void shiftTiles(const ShiftDirection dir, const unsigned movedMask);
+      unsigned insertCandidates(const ShiftDirection dir, const unsigned movedMask) const;
+      void insertCard(const ShiftDirection dir, const unsigned slice, const Card insertVal);
       
     private:
       const Card& matrixIndex(const unsigned row, const unsigned col) const {
@@ -102,12 +197,73 @@ namespace threes {
       // helper for finding a valid random index for inserting new card
       unsigned chooseInsertIndex(const ShiftDirection dir) const;
 
+      // one of the slices in candidates, drawn from rng
+      unsigned pickInsertSlice(const unsigned candidates, RngContext& rng) const;
+
+      // The shift kernels, one instantiation per direction (and slice) so
+      // every tile index is a constant. The public calls switch on the
+      // direction once and land here.
+      template<ShiftDirection DIR>
+      bool canShiftDir() const;
+      template<ShiftDirection DIR>
+      unsigned shiftTilesDir();
+      template<ShiftDirection DIR>
+      void shiftTilesDir(const unsigned movedMask);
+
       // single impl for shifting an individual row or column, dedupes
-      // the logic of figuring out what gets combined and what gets moved
-      // choice of start/stride selects the relevant row/col and the direction
-      void shiftSlice(const int startIdx, const int stride);
+      // the logic of figuring out what gets combined and what gets moved.
+      // 4x4 boards look their slices up in the RowTables instead, the
+      // ranks of every tile being kept packed in m_ranks for that.
+      static constexpr bool UseRowTables = (DIM == 4);
+      using RowTablesTag = std::integral_constant<bool, UseRowTables>;
+      template<ShiftDirection DIR, unsigned SLICE>
+      void shiftSlice() { shiftSlice<DIR, SLICE>(RowTablesTag()); }
+      template<ShiftDirection DIR, unsigned SLICE>
+      bool canShiftSlice() const { return canShiftSlice<DIR, SLICE>(RowTablesTag()); }
+      template<ShiftDirection DIR, unsigned SLICE>
+      void shiftSlice(std::false_type);
+      template<ShiftDirection DIR, unsigned SLICE>
+      bool canShiftSlice(std::false_type) const;
+      template<ShiftDirection DIR, unsigned SLICE>
+      void shiftSlice(std::true_type);
+      template<ShiftDirection DIR, unsigned SLICE>
+      bool canShiftSlice(std::true_type) const;
+      // the slice's ranks as a RowTables line, the tile nearest the wall
+      // in the low nibble, so the towardLow table shifts it
+      template<ShiftDirection DIR, unsigned SLICE>
+      unsigned sliceLine() const;
+
+      // every tile write goes through here to keep the features current
+      void setTile(const unsigned idx, const Card card) {
+	const tile_mask_t bit = tile_mask_t(1) << idx;
+	const unsigned oldRank = cardRank(m_data[idx]);
+	const unsigned newRank = cardRank(card);
+	ASSERT(newRank <= S_MAX_CARD_RANK, "card " << card.value << " too big for a rank");
+	m_rankMasks[oldRank] &= ~bit;
+	m_rankMasks[newRank] |= bit;
+	m_score += S_RANK_SCORES[newRank];
+	m_score -= S_RANK_SCORES[oldRank];
+	m_data[idx] = card;
+	m_dirtyLines |= (1u << (idx / DIM)) | (1u << (DIM + idx % DIM));
+	if(UseRowTables) { setPackedRank(idx, newRank); }
+      }
 
-      bool canShiftSlice(const int startIdx, const int stride) const;
+      // setTile for the table shifts, which already know the rank and
+      // account for the score a whole line at a time
+      void setTileRank(const unsigned idx, const unsigned rank) {
+	const tile_mask_t bit = tile_mask_t(1) << idx;
+	m_rankMasks[(m_ranks >> (4*idx)) & 0xFu] &= ~bit;
+	m_rankMasks[rank] |= bit;
+	m_data[idx] = cardFromRank(rank);
+	m_dirtyLines |= (1u << (idx / DIM)) | (1u << (DIM + idx % DIM));
+	setPackedRank(idx, rank);
+      }
+      void setPackedRank(const unsigned idx, const unsigned rank) {
+	m_ranks = (m_ranks & ~(0xFull << (4*idx))) | (static_cast<uint64_t>(rank) << (4*idx));
+      }
+
+      // features from scratch, after the tiles were set directly
+      void rebuildFeatures();
       
     private:
       
@@ -115,6 +271,17 @@ namespace threes {
       Card m_max;
       int m_prevInsertIdx;
       ShiftDirection m_prevDir;
+
+      // tiles holding each card rank, rank 0 being the empty tiles
+      std::array<tile_mask_t, S_MAX_CARD_RANK+1> m_rankMasks;
+      // lineFeatureScore of rows 0..DIM-1 then columns 0..DIM-1, refreshed
+      // lazily for the lines with a bit set in m_dirtyLines
+      mutable std::array<int, 2*DIM> m_lineScores;
+      mutable int m_lineScoreTotal;
+      mutable unsigned m_dirtyLines;
+      uint64_t m_score;
+      // tile i's rank in bits [4i, 4i+4), only kept when UseRowTables
+      uint64_t m_ranks;
       
     }; // class Board
 
@@ -150,115 +317,264 @@ namespace threes {
       for(unsigned i=0; i < numStartCards; ++i) {
 	m_data[randomInsertIndices[i]] = initialCards[i];
       }
-      
+      rebuildFeatures();
+    }
+
+    template<unsigned DIM, class RAND_GEN>
+    Board<DIM, RAND_GEN>::Board(const storage_t& data)
+      : m_data(data)
+      , m_max(*std::max_element(data.begin(), data.end()))
+      , m_prevInsertIdx(0)
+      , m_prevDir(DIRECTION_UP)
+    {
+      rebuildFeatures();
     }
 
     /////////////////////
 
     template<unsigned DIM, class RAND_GEN>
-    bool Board<DIM, RAND_GEN>::canShift(const ShiftDirection dir) const {
-      // shifting across rows shifts by DIM at a time
-      const bool isVertical = (dir == DIRECTION_UP || dir == DIRECTION_DOWN);
-      const int shiftStrideMultiplier = (isVertical ? DIM : 1);
-      const int shiftStartMultiplier  = (isVertical ? 1 : DIM);
-      // shifting down or right has a negative stride b/c shift starts at end of row/column
-      const int shiftDirection = (dir == DIRECTION_DOWN || dir == DIRECTION_RIGHT) ? -1 : 1;
-      // shifting from left of bottom, we don't start our shift from 0 index
-      int shiftStartConst = 0;
-      if     (dir == DIRECTION_RIGHT) {shiftStartConst = DIM-1;}
-      else if(dir == DIRECTION_DOWN ) {shiftStartConst = DIM*(DIM-1);}
-      
-      for(unsigned i=0; i<DIM; ++i) {
-	const int shiftStartIdx = shiftStartConst + shiftStartMultiplier*i;
-	const int shiftStride = shiftDirection*shiftStrideMultiplier;
-	if(canShiftSlice(shiftStartIdx, shiftStride)) {
-	  return true;
-	}
+    void Board<DIM, RAND_GEN>::rebuildFeatures() {
+      m_rankMasks.fill(0);
+      m_score = 0;
+      m_ranks = 0;
+      for(unsigned i = 0; i < DIM*DIM; ++i) {
+	const unsigned rank = cardRank(m_data[i]);
+	ASSERT(rank <= S_MAX_CARD_RANK, "card " << m_data[i].value << " too big for a rank");
+	m_rankMasks[rank] |= tile_mask_t(1) << i;
+	m_score += S_RANK_SCORES[rank];
+	if(UseRowTables) { setPackedRank(i, rank); }
       }
+      m_lineScores.fill(0);
+      m_lineScoreTotal = 0;
+      m_dirtyLines = (1u << (2*DIM)) - 1;
+    }
+
+    template<unsigned DIM, class RAND_GEN>
+    std::array<unsigned, 3> Board<DIM, RAND_GEN>::topThreeValues() const {
+      unsigned rankPresent = 0;
+      for(unsigned rank = 0; rank <= S_MAX_CARD_RANK; ++rank) {
+	if(m_rankMasks[rank]) { rankPresent |= (1u << rank); }
+      }
+      return topThreeFromRanks(rankPresent);
+    }
 
+    template<unsigned DIM, class RAND_GEN>
+    int Board<DIM, RAND_GEN>::lineScores() const {
+      for(unsigned dirty = m_dirtyLines; dirty; dirty &= dirty - 1) {
+	const unsigned line = __builtin_ctz(dirty);
+	// rows run along stride 1, columns along stride DIM
+	const int score = (line < DIM) ?
+	  lineFeatureScore<DIM>(m_data, DIM*line, 1) :
+	  lineFeatureScore<DIM>(m_data, line - DIM, DIM);
+	m_lineScoreTotal += score - m_lineScores[line];
+	m_lineScores[line] = score;
+      }
+      m_dirtyLines = 0;
+      return m_lineScoreTotal;
+    }
+
+    /////////////////////
+
+    template<unsigned DIM, class RAND_GEN>
+    bool Board<DIM, RAND_GEN>::canShift(const ShiftDirection dir) const {
+      switch(dir) {
+      case DIRECTION_UP:    return canShiftDir<DIRECTION_UP>();
+      case DIRECTION_DOWN:  return canShiftDir<DIRECTION_DOWN>();
+      case DIRECTION_LEFT:  return canShiftDir<DIRECTION_LEFT>();
+      case DIRECTION_RIGHT: return canShiftDir<DIRECTION_RIGHT>();
+      default: break;
+      }
+      ASSERT(false, "invalid shift direction");
       return false;
     }
+
+    template<unsigned DIM, class RAND_GEN>
+    template<ShiftDirection DIR>
+    bool Board<DIM, RAND_GEN>::canShiftDir() const {
+      bool result = false;
+      Unroll<DIM>::apply([this, &result](auto slice) {
+	  result = result || this->template canShiftSlice<DIR, decltype(slice)::value>();
+	});
+      return result;
+    }
+
+    // Works on the rank masks, a bit per tile: for each tile, can the tile
+    // after it (to the right, or below) slide or merge on to it, and the
+    // same the other way. Merges go both ways, slides only in to an empty
+    // tile, and a slice moves in a direction if any of its pairs do.
+    template<unsigned DIM, class RAND_GEN>
+    MoveSet Board<DIM, RAND_GEN>::moves() const {
+      using Masks = TileMasks<DIM>;
+      const tile_mask_t empty = m_rankMasks[0];
+      const tile_mask_t occupied = occupiedMask();
+      // the right neighbour of the last column is the next row's first tile
+      const tile_mask_t hasRight = Masks::all() & ~Masks::col(DIM-1);
+
+      tile_mask_t mergeH = (m_rankMasks[1] & (m_rankMasks[2] >> 1)) | (m_rankMasks[2] & (m_rankMasks[1] >> 1));
+      tile_mask_t mergeV = (m_rankMasks[1] & (m_rankMasks[2] >> DIM)) | (m_rankMasks[2] & (m_rankMasks[1] >> DIM));
+      // up to the largest rank on the board, m_max isn't always set. The
+      // largest rank doesn't merge, see Card::canCombine
+      tile_mask_t unseen = occupied & ~(m_rankMasks[1] | m_rankMasks[2]);
+      for(unsigned rank = 3; unseen && rank < S_MAX_CARD_RANK; ++rank) {
+	mergeH |= m_rankMasks[rank] & (m_rankMasks[rank] >> 1);
+	mergeV |= m_rankMasks[rank] & (m_rankMasks[rank] >> DIM);
+	unseen &= ~m_rankMasks[rank];
+      }
+
+      // bit t set <=> the pair (t, t+1) or (t, t+DIM) moves that way
+      std::array<tile_mask_t, NUM_DIRECTIONS> pairs;
+      pairs[DIRECTION_LEFT]  = (mergeH | (empty & (occupied >> 1))) & hasRight;
+      pairs[DIRECTION_RIGHT] = (mergeH | (occupied & (empty >> 1))) & hasRight;
+      pairs[DIRECTION_UP]    = mergeV | (empty & (occupied >> DIM));
+      pairs[DIRECTION_DOWN]  = mergeV | (occupied & (empty >> DIM));
+
+      MoveSet result;
+      for(unsigned i = 0; i < DIM; ++i) {
+	result.moved[DIRECTION_LEFT]  |= (pairs[DIRECTION_LEFT]  & Masks::row(i) ? 1u : 0u) << i;
+	result.moved[DIRECTION_RIGHT] |= (pairs[DIRECTION_RIGHT] & Masks::row(i) ? 1u : 0u) << i;
+	result.moved[DIRECTION_UP]    |= (pairs[DIRECTION_UP]    & Masks::col(i) ? 1u : 0u) << i;
+	result.moved[DIRECTION_DOWN]  |= (pairs[DIRECTION_DOWN]  & Masks::col(i) ? 1u : 0u) << i;
+      }
+      for(unsigned dir = 0; dir < NUM_DIRECTIONS; ++dir) {
+	result.legal |= (result.moved[dir] ? 1u : 0u) << dir;
+      }
+      return result;
+    }
+
     /////////////////////
 
     template<unsigned DIM, class RAND_GEN>
-    void Board<DIM, RAND_GEN>::shiftBoard(const ShiftDirection dir, const Card insertVal) {
-      static std::random_device rd;
-      static std::mt19937 gen(rd());
+    void Board<DIM, RAND_GEN>::shiftBoard(const ShiftDirection dir, const Card insertVal,
+					  RngContext& rng) {
+      const unsigned movedMask = shiftTiles(dir);
+      ASSERT( movedMask != 0,
+		  "requested a shift but board can't shift that way" );
+      insertCard(dir, pickInsertSlice(insertCandidates(dir, movedMask), rng), insertVal);
+    }
 
-      const bool isVertical = (dir == DIRECTION_UP || dir == DIRECTION_DOWN);
-      
-      ASSERT( canShift(dir),
-		  "requested a vertical shift but board can't shift that way" );
+    template<unsigned DIM, class RAND_GEN>
+    void Board<DIM, RAND_GEN>::shiftBoard(const MoveSet& moves, const ShiftDirection dir,
+					  const Card insertVal, RngContext& rng) {
+      ASSERT( moves.canShift(dir),
+		  "requested a shift but board can't shift that way" );
+      shiftTiles(dir, moves.moved[dir]);
+      insertCard(dir, pickInsertSlice(insertCandidates(dir, moves.moved[dir]), rng), insertVal);
+    }
 
-      std::vector<int> validShiftIdx;
-      // push all the direction conditional stuff here so the loop is clean //
-      
-      // shifting across rows shifts by DIM at a time
-      const int shiftStrideMultiplier = (isVertical ? DIM : 1);
-      const int shiftStartMultiplier  = (isVertical ? 1 : DIM);
-      // shifting down or right has a negative stride b/c shift starts at end of row/column
-      const int shiftDirection = (dir == DIRECTION_DOWN || dir == DIRECTION_RIGHT) ? -1 : 1;
-      // shifting from left of bottom, we don't start our shift from 0 index
-      int shiftStartConst = 0;
-      if     (dir == DIRECTION_RIGHT) {shiftStartConst = DIM-1;}
-      else if(dir == DIRECTION_DOWN ) {shiftStartConst = DIM*(DIM-1);}
-      
+    template<unsigned DIM, class RAND_GEN>
+    unsigned Board<DIM, RAND_GEN>::pickInsertSlice(const unsigned candidates, RngContext& rng) const {
+      // pick an available slice according to the RAND_GEN, no draw needed
+      // when there's only one
+      unsigned numCandidates = 0;
       for(unsigned i=0; i<DIM; ++i) {
-	const int shiftStartIdx = shiftStartConst + shiftStartMultiplier*i;
-	const int shiftStride = shiftDirection*shiftStrideMultiplier;
-	if(canShiftSlice(shiftStartIdx, shiftStride)) {
-	  validShiftIdx.push_back(i);
-	  shiftSlice(shiftStartIdx, shiftStride);
-	}
+	if(candidates & (1u << i)) { ++numCandidates; }
+      }
+      unsigned remaining = 0;
+      if(numCandidates > 1) {
+	RAND_GEN insertSliceGen = RAND_GEN(0, numCandidates-1);
+	remaining = insertSliceGen(rng);
+      }
+      unsigned insertIdx = 0;
+      for(; insertIdx<DIM; ++insertIdx) {
+	if( (candidates & (1u << insertIdx)) && remaining-- == 0 ) { break; }
+      }
+      return insertIdx;
+    }
+
+    /////////////////////
+
+    template<unsigned DIM, class RAND_GEN>
+    unsigned Board<DIM, RAND_GEN>::shiftTiles(const ShiftDirection dir) {
+      switch(dir) {
+      case DIRECTION_UP:    return shiftTilesDir<DIRECTION_UP>();
+      case DIRECTION_DOWN:  return shiftTilesDir<DIRECTION_DOWN>();
+      case DIRECTION_LEFT:  return shiftTilesDir<DIRECTION_LEFT>();
+      case DIRECTION_RIGHT: return shiftTilesDir<DIRECTION_RIGHT>();
+      default: break;
+      }
+      ASSERT(false, "invalid shift direction");
+      return 0;
+    }
+
+    template<unsigned DIM, class RAND_GEN>
+    template<ShiftDirection DIR>
+    unsigned Board<DIM, RAND_GEN>::shiftTilesDir() {
+      unsigned movedMask = 0;
+      Unroll<DIM>::apply([this, &movedMask](auto slice) {
+	  constexpr unsigned Slice = decltype(slice)::value;
+	  if(this->template canShiftSlice<DIR, Slice>()) {
+	    movedMask |= (1u << Slice);
+	    this->template shiftSlice<DIR, Slice>();
+	  }
+	});
+      return movedMask;
+    }
+
+    template<unsigned DIM, class RAND_GEN>
+    void Board<DIM, RAND_GEN>::shiftTiles(const ShiftDirection dir, const unsigned movedMask) {
+      switch(dir) {
+      case DIRECTION_UP:    shiftTilesDir<DIRECTION_UP>(movedMask);    return;
+      case DIRECTION_DOWN:  shiftTilesDir<DIRECTION_DOWN>(movedMask);  return;
+      case DIRECTION_LEFT:  shiftTilesDir<DIRECTION_LEFT>(movedMask);  return;
+      case DIRECTION_RIGHT: shiftTilesDir<DIRECTION_RIGHT>(movedMask); return;
+      default: break;
       }
+      ASSERT(false, "invalid shift direction");
+    }
 
+    template<unsigned DIM, class RAND_GEN>
+    template<ShiftDirection DIR>
+    void Board<DIM, RAND_GEN>::shiftTilesDir(const unsigned movedMask) {
+      Unroll<DIM>::apply([this, movedMask](auto slice) {
+	  constexpr unsigned Slice = decltype(slice)::value;
+	  if(movedMask & (1u << Slice)) {
+	    this->template shiftSlice<DIR, Slice>();
+	  }
+	});
+    }
+    /////////////////////
+
+    template<unsigned DIM, class RAND_GEN>
+    unsigned Board<DIM, RAND_GEN>::insertCandidates(const ShiftDirection dir,
+						    const unsigned movedMask) const {
       // custom threes logic to repeatedly insert in to the same row/col
       // if it is still possible
-      int insertIdx = 0;
-      if( dir == m_prevDir &&
-	  std::find( std::begin(validShiftIdx),
-		     std::end(validShiftIdx),
-		     m_prevInsertIdx) != std::end(validShiftIdx) ){
-	insertIdx = m_prevInsertIdx;
+      if( dir == m_prevDir && (movedMask & (1u << m_prevInsertIdx)) ) {
+	return (1u << m_prevInsertIdx);
       }
-      else {
-	// pick an available index according to the RAND_GEN
-	RAND_GEN insertSliceGen = RAND_GEN(0,validShiftIdx.size()-1);
-	const int insertSlice = insertSliceGen(gen);
-	insertIdx = validShiftIdx[insertSlice];
-      }
-      
-      // figure out where on the board array that index lies
-      int arrayIdxInsert(-1);
-      if(dir == DIRECTION_UP) {
-	// pick something on the bottom row, which is the end of our array
-	arrayIdxInsert = DIM*DIM - DIM + insertIdx;
-      } else if (dir == DIRECTION_DOWN) {
-	// easy case, insert in the top row which is the beginning of the array
-	arrayIdxInsert = insertIdx;
-      } else if (dir == DIRECTION_RIGHT) {
-	// pick something in the first column
-	arrayIdxInsert = DIM*insertIdx;
-      } else if (dir == DIRECTION_LEFT) {
-	// insert in the the last column
-	arrayIdxInsert = (DIM-1)+DIM*insertIdx;
+      return movedMask;
+    }
+
+    /////////////////////
+
+    template<unsigned DIM, class RAND_GEN>
+    void Board<DIM, RAND_GEN>::insertCard(const ShiftDirection dir, const unsigned slice,
+					  const Card insertVal) {
+      // the new card goes in the far end of the slice, away from the wall
+      unsigned arrayIdxInsert = DIM*DIM;
+      switch(dir) {
+      case DIRECTION_UP:    arrayIdxInsert = ShiftGeometry<DIM, DIRECTION_UP   >::tile(slice, DIM-1); break;
+      case DIRECTION_DOWN:  arrayIdxInsert = ShiftGeometry<DIM, DIRECTION_DOWN >::tile(slice, DIM-1); break;
+      case DIRECTION_LEFT:  arrayIdxInsert = ShiftGeometry<DIM, DIRECTION_LEFT >::tile(slice, DIM-1); break;
+      case DIRECTION_RIGHT: arrayIdxInsert = ShiftGeometry<DIM, DIRECTION_RIGHT>::tile(slice, DIM-1); break;
+      default: break;
       }
-      const bool validIdxFound(arrayIdxInsert >= 0);
+      const bool validIdxFound(arrayIdxInsert < DIM*DIM);
       ASSERT(validIdxFound, "invalid insertion dir");
+      (void)validIdxFound; // only read by ASSERT
 
       ASSERT(m_data[arrayIdxInsert] == 0, "trying to insert at already occupied slot");
-      m_data[arrayIdxInsert] = insertVal;
+      setTile(arrayIdxInsert, insertVal);
       if(insertVal > m_max.value) { m_max = insertVal; }
     }
       
     ////////////////////
     
     template<unsigned DIM, class RAND_GEN>
-    void Board<DIM, RAND_GEN>::shiftSlice(const int startIdx, const int stride) {
-      // todo: if( startIdx + stride*DIM > DIM*DIM ) { raise error };
+    template<ShiftDirection DIR, unsigned SLICE>
+    void Board<DIM, RAND_GEN>::shiftSlice(std::false_type) {
+      using Geometry = ShiftGeometry<DIM, DIR>;
 
-      if(DIM < 2) { return; }
-      
       // two parts here - part 1 is to find the first combinable pair of cards if any
       //                - part 2 is to shift all remaining cards by 1 stride
 
@@ -266,69 +582,101 @@ namespace threes {
       // position where we will shift the remaining cards.
       // If that position is DIM, there was no valid card combination
       unsigned shiftDestination = DIM;
-      for(unsigned i = 0; (i < (DIM-1)) && (shiftDestination==DIM); ++i) {
-	const unsigned currIdx = startIdx + i*stride;
-	const unsigned nextIdx = startIdx + (i+1)*stride;
-
-	Card& curr = m_data[currIdx];
-	const Card& next = m_data[nextIdx];
-	if( curr.canCombine(next) ) {
-	  curr.value += next.value;
-	  // update max state
-	  if( curr.value > m_max.value ) {
-	    m_max.value = curr.value;
+      Unroll<DIM-1>::apply([this, &shiftDestination](auto i) {
+	  constexpr unsigned currIdx = Geometry::tile(SLICE, decltype(i)::value);
+	  constexpr unsigned nextIdx = Geometry::tile(SLICE, decltype(i)::value + 1);
+	  if(shiftDestination != DIM) { return; }
+
+	  const Card& curr = m_data[currIdx];
+	  const Card& next = m_data[nextIdx];
+	  if( curr.canCombine(next) ) {
+	    this->setTile(currIdx, Card(curr.value + next.value));
+	    // update max state
+	    if( curr.value > m_max.value ) {
+	      m_max.value = curr.value;
+	    }
+	    shiftDestination = decltype(i)::value + 1;
 	  }
-	  
-	  shiftDestination = i+1;
-	}
-      }
+	});
 
       // shift all remaining cards by 1 stride
       // if no combo found, (shiftDestination == DIM) and
-      // this loop does not execute.
-      for(; shiftDestination < (DIM-1); ++shiftDestination) {
-	const unsigned destinationIdx = startIdx + shiftDestination*stride;
-	const unsigned originIdx      = startIdx + (shiftDestination+1)*stride;
-
-	m_data[destinationIdx] = m_data[originIdx];
-      }
+      // nothing moves.
+      Unroll<DIM-1>::apply([this, shiftDestination](auto i) {
+	  constexpr unsigned destinationIdx = Geometry::tile(SLICE, decltype(i)::value);
+	  constexpr unsigned originIdx      = Geometry::tile(SLICE, decltype(i)::value + 1);
+	  if(decltype(i)::value >= shiftDestination) {
+	    this->setTile(destinationIdx, m_data[originIdx]);
+	  }
+	});
 
-      // We didn't copy anything in to the shiftDestination == (DIM-1) case
-      // because there is no data to copy from. We need to copy an empty
-      // (zero value) card from off the board in to that spot
-      if( shiftDestination == (DIM-1) ) {
-	m_data[ startIdx + shiftDestination*stride ] = Card(0);
+      // We didn't copy anything in to the last tile because there is no
+      // data to copy from. We need to copy an empty (zero value) card from
+      // off the board in to that spot
+      if( shiftDestination < DIM ) {
+	setTile(Geometry::tile(SLICE, DIM-1), Card(0));
       }
-      
-      
     }
 
     /////////////////////
 
-    
     template<unsigned DIM, class RAND_GEN>
-    bool Board<DIM, RAND_GEN>::canShiftSlice(const int startIdx, const int stride) const {
-      ASSERT(startIdx + stride*(DIM-1) <= DIM*DIM, "shifting off the end of the board");
-      ASSERT(startIdx + stride*(DIM-1) >=0, "shifting off the beginning of the board");
-      // todo: if(  ) { raise error };
-
-      if(DIM < 2) { return false; }
+    template<ShiftDirection DIR, unsigned SLICE>
+    bool Board<DIM, RAND_GEN>::canShiftSlice(std::false_type) const {
+      using Geometry = ShiftGeometry<DIM, DIR>;
+      static_assert(SLICE < DIM, "slice off the board");
 
       // check if any two adjacent cards are combinable
-      for(unsigned i=0; i<(DIM-1); ++i) {
-	const unsigned currDataIdx = startIdx + i*stride;
-	const unsigned nextDataIdx = startIdx + (i+1)*stride;
-	const Card& curr = m_data[currDataIdx];
-	const Card& next = m_data[nextDataIdx];
-
-	if( curr.canCombine(next) ) {
-	  return(true);
-	}
+      bool result = false;
+      Unroll<DIM-1>::apply([this, &result](auto i) {
+	  constexpr unsigned currDataIdx = Geometry::tile(SLICE, decltype(i)::value);
+	  constexpr unsigned nextDataIdx = Geometry::tile(SLICE, decltype(i)::value + 1);
+	  result = result || m_data[currDataIdx].canCombine(m_data[nextDataIdx]);
+	});
+      return result;
+    }
+    
+    /////////////////////
+
+    template<unsigned DIM, class RAND_GEN>
+    template<ShiftDirection DIR, unsigned SLICE>
+    unsigned Board<DIM, RAND_GEN>::sliceLine() const {
+      using Geometry = ShiftGeometry<DIM, DIR>;
+      unsigned line = 0;
+      Unroll<DIM>::apply([this, &line](auto i) {
+	  constexpr unsigned idx = Geometry::tile(SLICE, decltype(i)::value);
+	  line |= static_cast<unsigned>((m_ranks >> (4*idx)) & 0xFu) << (4*decltype(i)::value);
+	});
+      return line;
+    }
+
+    template<unsigned DIM, class RAND_GEN>
+    template<ShiftDirection DIR, unsigned SLICE>
+    void Board<DIM, RAND_GEN>::shiftSlice(std::true_type) {
+      using Geometry = ShiftGeometry<DIM, DIR>;
+      const unsigned line = sliceLine<DIR, SLICE>();
+      const RowShiftEntry& entry = rowTables().towardLow[line];
+
+      // only the tiles whose rank changed get written
+      Unroll<DIM>::apply([this, line, &entry](auto i) {
+	  constexpr unsigned idx = Geometry::tile(SLICE, decltype(i)::value);
+	  const unsigned rank = (entry.shifted >> (4*decltype(i)::value)) & 0xFu;
+	  if(rank != ((line >> (4*decltype(i)::value)) & 0xFu)) {
+	    this->setTileRank(idx, rank);
+	  }
+	});
+      m_score += entry.scoreDelta;
+      const Card lineMax = cardFromRank(entry.maxRank);
+      if( lineMax.value > m_max.value ) {
+	m_max = lineMax;
       }
+    }
 
-      return(false);
-      
+    template<unsigned DIM, class RAND_GEN>
+    template<ShiftDirection DIR, unsigned SLICE>
+    bool Board<DIM, RAND_GEN>::canShiftSlice(std::true_type) const {
+      return rowTables().towardLow[sliceLine<DIR, SLICE>()].moved;
     }
-    
+
   } // namespace game
 } // namespace threes
@@ -0,0 +1,107 @@
+#pragma once
+
+/*
+ * The parts of the ExpectiMaxTree value function that depend only on one
+ * row or column, or on which tiles hold a given card rank. Board<DIM> keeps
+ * these up to date as it shifts, so a leaf evaluation only rescans the
+ * lines that changed since the last one.
+ *
+ * Tile masks have bit i set for tile i (i = col + row*DIM), same as the
+ * storage order.
+ */
+
+#include <array>
+#include <cstdint>
+
+#include "Card.h"
+
+namespace threes {
+  namespace game {
+
+    using tile_mask_t = uint32_t;
+
+    inline unsigned countTiles(const tile_mask_t mask) {
+      return static_cast<unsigned>(__builtin_popcount(mask));
+    }
+
+    // a card next to a matching card, or to one twice or half its value,
+    // is worth 2
+    inline int adjacencyPairScore(const unsigned card1Val, const unsigned card2Val) {
+      if( card1Val == card2Val ||
+	  card1Val == 2*card2Val ||
+	  card2Val == 2*card1Val ) {
+	return 2;
+      }
+      return 0;
+    }
+
+    // Adjacency and trapped scores along one row or column, the tiles at
+    // data[start + i*stride]. Each pair is scored from its first card (if
+    // more than 2), and a card with a wall or bigger card on both sides
+    // along the line is -5. Summing this over every row and column gives
+    // those two terms of the value function, each counted once.
+    template<unsigned DIM, class STORAGE>
+    int lineFeatureScore(const STORAGE& data, const unsigned start, const unsigned stride) {
+      int score = 0;
+      for(unsigned i = 0; i < DIM; ++i) {
+	const unsigned curr = data[start + i*stride].value;
+	if(curr == 0) { continue; }
+	const bool trappedLow ( i == 0     || data[start + (i-1)*stride].value > curr );
+	const bool trappedHigh( i == DIM-1 || data[start + (i+1)*stride].value > curr );
+	if( curr > 2 && i < DIM-1 ) {
+	  score += adjacencyPairScore(curr, data[start + (i+1)*stride].value);
+	}
+	if( trappedLow && trappedHigh ) { score -= 5; }
+      }
+      return score;
+    }
+
+    // fixed masks for a DIM x DIM board
+    template<unsigned DIM>
+    struct TileMasks {
+      static_assert(DIM*DIM <= 8*sizeof(tile_mask_t), "board too big for a tile mask");
+
+      static constexpr tile_mask_t all() {
+	return (DIM*DIM == 8*sizeof(tile_mask_t)) ? ~tile_mask_t(0) :
+	  ((tile_mask_t(1) << (DIM*DIM)) - 1);
+      }
+      static constexpr tile_mask_t row(const unsigned r) {
+	return ((tile_mask_t(1) << DIM) - 1) << (DIM*r);
+      }
+      static constexpr tile_mask_t col(const unsigned c, const unsigned r = 0) {
+	return (r == DIM) ? 0 : ((tile_mask_t(1) << (c + DIM*r)) | col(c, r+1));
+      }
+      static constexpr tile_mask_t wall() {
+	return row(0) | row(DIM-1) | col(0) | col(DIM-1);
+      }
+      static constexpr tile_mask_t corner() {
+	return (tile_mask_t(1) << 0) | (tile_mask_t(1) << (DIM-1)) |
+	  (tile_mask_t(1) << (DIM*(DIM-1))) | (tile_mask_t(1) << (DIM*DIM-1));
+      }
+
+      // tiles sharing an edge with any tile in mask
+      static tile_mask_t neighbours(const tile_mask_t mask) {
+	return ( ((mask << 1) & ~col(0)) |
+		 ((mask >> 1) & ~col(DIM-1)) |
+		 (mask << DIM) |
+		 (mask >> DIM) ) & all();
+      }
+    };
+
+    // Same result as ExpectiMaxTree::getTopThreeValues: the three largest
+    // distinct values among the cards and 0/1/2, smallest first. rankPresent
+    // has bit r set if a card of rank r is on the board.
+    inline std::array<unsigned, 3> topThreeFromRanks(const unsigned rankPresent) {
+      std::array<unsigned, 3> topThree{ 0, 0, 0 };
+      unsigned found = 0;
+      for(int rank = S_MAX_CARD_RANK; rank >= 0 && found < 3; --rank) {
+	if( rank <= 2 || (rankPresent & (1u << rank)) ) {
+	  topThree[2 - found] = cardFromRank(rank).value;
+	  ++found;
+	}
+      }
+      return topThree;
+    }
+
+  } // namespace game
+} // namespace threes
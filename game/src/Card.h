@@ -4,6 +4,7 @@
  *
  */
 
+#include <cstdint>
 
 namespace threes {
   namespace game {
@@ -30,8 +31,10 @@ namespace threes {
 	bool isEmpty = (value == 0 && other.value > 0);
 	// 1 and 2 combine 
 	bool isBaseCombo = ( (value + other.value) == 3 );
-	// otherwise, can only combine if value agrees
-	bool isMatch = (value > 2 && value == other.value);
+	// otherwise, can only combine if value agrees. 12288 is the largest
+	// card cardRank holds in 4 bits, so those don't combine, the same as
+	// rankCanCombine in RowTable.h
+	bool isMatch = (value > 2 && value == other.value && value < 12288);
 
 	return (isEmpty || isBaseCombo || isMatch);
       }
@@ -45,6 +48,30 @@ namespace threes {
     };
 
     double standardCardScore(const Card cardData);
-    
+
+    // Compact encoding of a card value, useful for packed boards and tables.
+    // 0/1/2 keep their value, 3*2^n maps to n+3. Ranks fit in 4 bits up to 12288.
+    static constexpr unsigned S_MAX_CARD_RANK(15);
+
+    inline unsigned cardRank(const Card card) {
+      if(card.value < 3) { return card.value; }
+      unsigned rank = 3;
+      for(unsigned v = card.value / 3; v > 1; v >>= 1) { ++rank; }
+      return rank;
+    }
+
+    inline Card cardFromRank(const unsigned rank) {
+      if(rank < 3) { return Card(rank); }
+      return Card(3u << (rank - 3));
+    }
+
+    // standardCardScore of each rank as an integer, 3^(rank-2) from the 3 up
+    static constexpr uint32_t S_RANK_SCORES[S_MAX_CARD_RANK+1] = {
+      0, 0, 0, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049, 177147, 531441, 1594323 };
+
+    inline uint32_t cardScore(const Card card) {
+      return S_RANK_SCORES[cardRank(card)];
+    }
+
   } //namespace game
 } //namespace threes
@@ -1,17 +1,28 @@
 #include <CardSequence.h>
 
 // no randomization
-unsigned threes::game::alwaysReturnNextIndex(const unsigned lower, const unsigned upper) {
+unsigned threes::game::alwaysReturnNextIndex(const unsigned lower, const unsigned upper,
+					     RngContext& rng) {
   (void)upper; // unused, this is to preserve interface 
+  (void)rng;
   return lower;
 }
 
 // a standard default impl that does uniform shuffle 
-unsigned threes::game::uniformRandomIndex(const unsigned lower, const unsigned upper) {
-  std::random_device rd;
-  std::mt19937 g(rd());
-  std::uniform_int_distribution<unsigned> dist(lower, upper);
-  return( dist(g) );
+unsigned threes::game::uniformRandomIndex(const unsigned lower, const unsigned upper,
+					  RngContext& rng) {
+  return( rng.uniformInt(lower, upper) );
+}
+
+double threes::game::nextIndexOdds(const unsigned idx, const unsigned lower,
+				   const unsigned upper) {
+  (void)upper; // unused, this is to preserve interface
+  return (idx == lower) ? 1.0 : 0.0;
+}
+
+double threes::game::uniformIndexOdds(const unsigned idx, const unsigned lower,
+				      const unsigned upper) {
+  return (idx >= lower && idx <= upper) ? 1.0 / (upper - lower + 1) : 0.0;
 }
 
 threes::game::ShuffleDeckContents threes::game::threesDefaultShuffleDeck() {
@@ -3,7 +3,12 @@
 #include "Card.h"
 #include "Board.h"
 #include "Utils.h"
+#include "Hashing.h"
+#include "Rng.h"
 
+#include <array>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <random>
 #include <functional>
@@ -18,6 +23,15 @@ namespace threes {
     static constexpr Card S_BONUS_CARD_THRESHOLD(48);
     static constexpr int S_BONUS_CARD_RATIO(8);
     
+    // One possible result of ICardSequence::draw(), for search that enumerates
+    // chance nodes instead of sampling them. The card draw() returns is always
+    // the current top card, the randomness is in which card replaces it.
+    struct DrawOutcome {
+      Card next;          // the new top card
+      bool bonus;         // next comes from outside the deck
+      double probability;
+    };
+
     // abstract base to generate a sequence of Card values
     template<class BOARD_TYPE>
     class ICardSequence {
@@ -28,15 +42,55 @@ namespace threes {
       using ICardSeqPtr = typename CardSeqFactory::ObjectPtr;
 
     public:
-      ICardSequence() {}
+      // drivers reseed their sequences straight away, so starting from the
+      // thread's default context saves a std::random_device per creation
+      ICardSequence()
+	: m_rng(defaultRngContext()())
+	{}
       virtual ~ICardSequence() {}
       virtual Card draw(const BoardPtrType& b) = 0; // remove top card
-      virtual Card peek(const BoardPtrType& b) = 0; // peek at the top card
+      virtual Card peek(const BoardPtrType& b) const = 0; // peek at the top card
 
       virtual ICardSeqPtr clone() const = 0;
+
+      // overwrite this sequence's state with other's without allocating,
+      // other must be the same kind of sequence (e.g. both clones of one game's)
+      virtual void assignFrom(const ICardSequence& other) = 0;
+
+      // hash of everything that affects future draws, for transposition tables
+      virtual uint64_t hash() const = 0;
+
+      // every distinct outcome of draw(b) and its probability, they sum to 1
+      virtual void drawOutcomes(const BoardPtrType& b, std::vector<DrawOutcome>& outcomes) const = 0;
+
+      // draw(b) with the random choice fixed to one of drawOutcomes(b)
+      virtual Card drawOutcome(const BoardPtrType& b, const DrawOutcome& outcome) = 0;
       
     public:
       virtual unsigned write_binary(std::ostream& out) const = 0;
+
+      // every random choice the sequence makes comes from this context,
+      // a clone carries on with a copy of it
+    public:
+      // restart the sequence as if freshly constructed, drawing from seed
+      virtual void seed(const uint64_t seed) { m_rng = RngContext(seed); }
+
+      // keep the current position in the sequence but draw from seed from now on
+      void reseed(const uint64_t seed) { m_rng = RngContext(seed); }
+
+      // Common random numbers (see GameDriver::setCommonRandom): called
+      // right before the game's draw number drawIdx, so that draw's random
+      // choices follow from seed and the sequence's own progress rather
+      // than from whatever the game did before. By default every draw gets
+      // a fresh stream keyed by drawIdx.
+      virtual void reseedCommon(const uint64_t seed, const uint64_t drawIdx) {
+	reseed(hashCombine(seed, drawIdx));
+      }
+
+      RngContext& rng() { return m_rng; }
+
+    protected:
+      RngContext m_rng;
     };
 
     /*
@@ -50,14 +104,18 @@ namespace threes {
     template<class BOARD_TYPE>
     class BonusCardGenerator {
     public:
-      BonusCardGenerator()
-	: m_bonusCards()
-      {}
+      Card operator()(const std::unique_ptr<BOARD_TYPE>& boardPtr, RngContext& rng);
+      Card operator()(const std::unique_ptr<BOARD_TYPE>& boardPtr) {
+	return (*this)(boardPtr, defaultRngContext());
+      }
 
-      Card operator()(const std::unique_ptr<BOARD_TYPE>& boardPtr);
-      
-    private:
-      std::vector<Card> m_bonusCards;
+      // how many cards operator() picks between, they're consecutive ranks
+      // so this is all it needs to know
+      static unsigned numCandidates(const BOARD_TYPE& board);
+
+      // all the cards operator() picks between, smallest first, appended
+      // to outcomes as bonus draws with no probability filled in
+      static void candidates(const BOARD_TYPE& board, std::vector<DrawOutcome>& outcomes);
     };
 
 
@@ -73,122 +131,200 @@ namespace threes {
     // ALGORITHMS TO RANDOMLY SHUFFLE DECKS
     
     // shuffle algorithm that does nothing
-    unsigned alwaysReturnNextIndex(const unsigned lower, const unsigned upper);
+    unsigned alwaysReturnNextIndex(const unsigned lower, const unsigned upper, RngContext& rng);
 
     // a standard default impl that does uniform shuffle 
-    unsigned uniformRandomIndex(const unsigned lower, const unsigned upper);
+    unsigned uniformRandomIndex(const unsigned lower, const unsigned upper, RngContext& rng);
+
+    // probability of the above picking idx from [lower, upper], for exact search
+    double nextIndexOdds(const unsigned idx, const unsigned lower, const unsigned upper);
+    double uniformIndexOdds(const unsigned idx, const unsigned lower, const unsigned upper);
 
     
     // BINARY PREDICATES TO DECIDE WHETHER OR NOT TO DRAW A BONUS CARD
     
     // never any bonus cards
     template<class T>
-    bool alwaysFalse(const T&) { return false; }
+    bool alwaysFalse(const T&, RngContext&) { return false; }
+
+    template<class T>
+    double neverBonusOdds(const T&) { return 0.0; }
 
     // internet's best guess
     template<typename BoardPtrType>
-    bool defaultBonusDraw(const BoardPtrType& boardPtr) {
-      if(!boardPtr) { return(false); }
+    double defaultBonusOdds(const BoardPtrType& boardPtr) {
+      if(!boardPtr) { return(0.0); }
       
       static const double s_randomOdds(1.0/21.0);
       
-      if(boardPtr->maxCard() < S_BONUS_CARD_THRESHOLD) { return false;}
-      std::random_device rd;
-      std::mt19937 g(rd());
-      
-      std::uniform_real_distribution<> dist(0, 1.0);
-      const double randZeroOne = dist(g);
-      return(randZeroOne < s_randomOdds);
+      if(boardPtr->maxCard() < S_BONUS_CARD_THRESHOLD) { return 0.0;}
+      return(s_randomOdds);
+    }
+
+    template<typename BoardPtrType>
+    bool defaultBonusDraw(const BoardPtrType& boardPtr, RngContext& rng) {
+      const double odds = defaultBonusOdds(boardPtr);
+      return(odds > 0.0 && rng.uniform01() < odds);
     }
 
     ///////////////////////////////
     
+    // Everything about a Kamikaze28Sequence that drawing changes, in 8 bytes
+    // of plain data, so a search node copies it as cheaply as its board.
+    // Deck cards are only ever 1, 2 or 3, and how many of each are left is
+    // all a draw depends on, not the order they'd been shuffled in to.
+    struct K28SequenceState {
+      static constexpr unsigned NumDeckRanks = 3;
+
+      std::array<uint8_t, NumDeckRanks> remaining; // 1s, 2s and 3s left in the current deck
+      uint8_t next;    // rank of the next card (see cardRank)
+      uint32_t dealt;  // deck cards dealt since seeding, for reseedCommon
+
+      unsigned numRemaining() const { return remaining[0] + remaining[1] + remaining[2]; }
+
+      // of what's left to draw, dealt doesn't change that
+      uint64_t hash() const {
+	return mixHash(next | (static_cast<uint64_t>(remaining[0]) << 8) |
+		       (static_cast<uint64_t>(remaining[1]) << 16) | (static_cast<uint64_t>(remaining[2]) << 24));
+      }
+    };
+    static_assert(std::is_trivially_copyable<K28SequenceState>::value, "sequence state is copied as raw bytes");
+    static_assert(sizeof(K28SequenceState) == 8, "sequence state should pack in to 8 bytes");
+
+    // final, so a caller holding one by its own type (e.g. StaticGameDriver)
+    // gets its draws bound statically
     template<class BOARD_TYPE>
-    class Kamikaze28Sequence : public ICardSequence<BOARD_TYPE> {
+    class Kamikaze28Sequence final : public ICardSequence<BOARD_TYPE> {
       // public types to make deck contents and randomness generic 
     public:
       using typename ICardSequence<BOARD_TYPE>::BoardPtrType;
       using typename ICardSequence<BOARD_TYPE>::ICardSeqPtr;
       
       // function that permutes a ShuffleDeckContents in place
-      using IndexSelectFunction = std::function<unsigned(const unsigned, const unsigned)>;
+      using IndexSelectFunction = std::function<unsigned(const unsigned, const unsigned, RngContext&)>;
 
       // function that decides whether or not to draw a bonus card
-      using BonusCardDraw = std::function<bool(const BoardPtrType&)>;
+      using BonusCardDraw = std::function<bool(const BoardPtrType&, RngContext&)>;
+
+      // the exact odds behind the two functions above, only used by
+      // drawOutcomes() so they must describe the same distributions
+      using IndexOddsFunction = std::function<double(const unsigned, const unsigned, const unsigned)>;
+      using BonusCardOdds = std::function<double(const BoardPtrType&)>;
+
+      using State = K28SequenceState;
 
       static typename ICardSequence<BOARD_TYPE>::ICardSeqPtr create(const std::string& cfg);
       
     public:
+      // Only which cards are in deck counts, not their order: the index
+      // functions pick from the cards left sorted by value, so an in-order
+      // "shuffle" deals the smallest left each time.
       Kamikaze28Sequence(const ShuffleDeckContents& deck,
 			 IndexSelectFunction idxSelect = uniformRandomIndex,
-			 BonusCardDraw bonusDraw = defaultBonusDraw<BoardPtrType>);
+			 BonusCardDraw bonusDraw = defaultBonusDraw<BoardPtrType>,
+			 IndexOddsFunction idxOdds = uniformIndexOdds,
+			 BonusCardOdds bonusOdds = defaultBonusOdds<BoardPtrType>);
 
       // ICardSequence interface
     public:
       virtual Card draw(const BoardPtrType& b) override;
-      virtual Card peek(const BoardPtrType& b) override;
+      virtual Card peek(const BoardPtrType& b) const override;
 
       virtual ICardSeqPtr clone() const override;
+
+      // copies the state and rng, the shuffle/bonus functions are assumed
+      // to match already
+      virtual void assignFrom(const ICardSequence<BOARD_TYPE>& other) override;
+
+      const State& state() const { return m_state; }
+      // carry on from a state taken from this sequence or one with the same deck
+      void setState(const State& state) { m_state = state; }
+
+      virtual uint64_t hash() const override;
+
+      // deck outcomes are merged by card value, which is exact as long as
+      // every pickable card of a given value leaves an equivalent deck
+      // behind (true for uniform and in-order shuffles)
+      virtual void drawOutcomes(const BoardPtrType& b,
+				std::vector<DrawOutcome>& outcomes) const override;
+      virtual Card drawOutcome(const BoardPtrType& b, const DrawOutcome& outcome) override;
+
+      // restarts from a full deck, dealt in sorted order, so the first
+      // card drawn in the constructor doesn't leak in to the seeded sequence
+      virtual void seed(const uint64_t seed) override;
+
+      // The deck's stream is keyed by how many cards it has dealt and the
+      // bonus draw's by drawIdx, so games with the same seed deal the same
+      // shuffles however their bonus cards fell, and face the same bonus
+      // odds roll at each move. Applies to the next draw only, clones
+      // taken afterwards (e.g. by a search) draw as usual.
+      virtual void reseedCommon(const uint64_t seed, const uint64_t drawIdx) override;
       
     public:
       // todo:: could optionally expose more state, e.g. what cards are still in the deck
       // prior to next shuffle
       virtual unsigned write_binary(std::ostream& out) const override {
 	if(!out.good()) { return 0; }
-	out << m_next.value;
-	return(sizeof( decltype(m_next.value) ));
+	const Card next = cardFromRank(m_state.next);
+	out.write( reinterpret_cast<const char*>(&next.value), sizeof(next.value) );
+	return(sizeof( decltype(next.value) ));
       }
 
     private:
       void setupNextCard();
+      // deals the offset'th card left, counting up from the 1s, as the next card
+      void takeDeckCard(unsigned offset);
+      // deals a card of rank from the deck as the next card
+      void takeDeckRank(const unsigned rank);
       
     private:
-      ShuffleDeckContents m_deck;
-      unsigned m_deckIdx; 
-      Card m_next;
-      BonusCardGenerator<BOARD_TYPE> m_bonusGen;
+      std::array<uint8_t, State::NumDeckRanks> m_fullDeck; // what a fresh deck holds
+      unsigned m_deckSize;
+      State m_state;
+      bool m_commonDraw = false;    // next draw's bonus choice uses m_bonusRng
+      RngContext m_bonusRng{0};
       
+      // the default shuffle and bonus draw are called directly instead of
+      // through the std::functions, so they can be inlined
+      bool m_defaultDraws;
       IndexSelectFunction m_indexSelect;
       BonusCardDraw m_bonusDraw;
+      IndexOddsFunction m_indexOdds;
+      BonusCardOdds m_bonusOdds;
     };
 
     ////////////////////////////////////////////////////////////////
     // template impls
     ////////////////////////////////////////////////////////////////
 
-    // todo: make this generic but also performant
     template<class BOARD_TYPE>
-    Card BonusCardGenerator<BOARD_TYPE>::operator()(const std::unique_ptr<BOARD_TYPE>& bPtr) {
+    unsigned BonusCardGenerator<BOARD_TYPE>::numCandidates(const BOARD_TYPE& board) {
       // todo: make this generic for non-3 based values
-      ASSERT( !(S_BONUS_CARD_THRESHOLD > bPtr->maxCard().value),
+      ASSERT( !(S_BONUS_CARD_THRESHOLD > board.maxCard().value),
 		 "board does not meet special card threshold");
-	
-      const Card maxBonusCard = bPtr->maxCard().value / S_BONUS_CARD_RATIO;
-      if(m_bonusCards.empty()) {
-	m_bonusCards.push_back(Card(S_BONUS_CARD_THRESHOLD.value/S_BONUS_CARD_RATIO));
-      }
-
-      Card currMaxCard = m_bonusCards.back();
-      
-      while( currMaxCard < maxBonusCard ) {
-	currMaxCard = Card( currMaxCard.value * 2 );
-	m_bonusCards.push_back(currMaxCard);
-      }
+      return cardRank(Card(board.maxCard().value / S_BONUS_CARD_RATIO)) -
+	cardRank(Card(S_BONUS_CARD_THRESHOLD.value / S_BONUS_CARD_RATIO)) + 1;
+    }
 
-      if( currMaxCard != maxBonusCard ) {
-	std::cerr << "max bonus card not an exact power of two "
-		  << "times 6: " << maxBonusCard.value 
-		  << "(currMaxCard " << currMaxCard.value << ")"<< std::endl;
-	ASSERT( false, "max bonus card not an exact match!" );
-      }
+    template<class BOARD_TYPE>
+    Card BonusCardGenerator<BOARD_TYPE>::operator()(const std::unique_ptr<BOARD_TYPE>& bPtr,
+						    RngContext& rng) {
+      const unsigned smallest = cardRank(Card(S_BONUS_CARD_THRESHOLD.value / S_BONUS_CARD_RATIO));
+      return cardFromRank(smallest + rng.uniformInt(0, numCandidates(*bPtr)-1));
+    }
 
-      std::random_device rd;
-      std::mt19937 g(rd());
+    template<class BOARD_TYPE>
+    void BonusCardGenerator<BOARD_TYPE>::candidates(const BOARD_TYPE& board,
+						    std::vector<DrawOutcome>& outcomes) {
+      ASSERT( !(S_BONUS_CARD_THRESHOLD > board.maxCard().value),
+		 "board does not meet special card threshold");
 
-      ASSERT( m_bonusCards.size() > 0, "no bonus cards to draw");
-      
-      std::uniform_int_distribution<> dist(0, m_bonusCards.size()-1);
-      return(m_bonusCards[dist(g)]);
+      const Card maxBonusCard = board.maxCard().value / S_BONUS_CARD_RATIO;
+      Card card(S_BONUS_CARD_THRESHOLD.value/S_BONUS_CARD_RATIO);
+      for(; !(maxBonusCard < card); card = Card(card.value * 2)) {
+	outcomes.push_back( DrawOutcome{card, true, 0.0} );
+      }
+      ASSERT( Card(card.value / 2) == maxBonusCard, "max bonus card not an exact match!" );
     }
 
     /////////////////////////////////////////
@@ -207,7 +343,9 @@ namespace threes {
 	return typename ICardSequence<BOARD_TYPE>::ICardSeqPtr(
 	  new Kamikaze28Sequence<BOARD_TYPE>(oneTwoThreeDeck(),
 					     alwaysReturnNextIndex,
-					     alwaysFalse<BoardPtrType>));
+					     alwaysFalse<BoardPtrType>,
+					     nextIndexOdds,
+					     neverBonusOdds<BoardPtrType>));
 	
       }
       else {
@@ -222,13 +360,34 @@ namespace threes {
     template<class BOARD_TYPE>
     Kamikaze28Sequence<BOARD_TYPE>::Kamikaze28Sequence(const ShuffleDeckContents& deck,
 						       IndexSelectFunction idxSelect,
-						       BonusCardDraw bonusDraw)
+						       BonusCardDraw bonusDraw,
+						       IndexOddsFunction idxOdds,
+						       BonusCardOdds bonusOdds)
       : ICardSequence<BOARD_TYPE>()
-      , m_deck(deck)
-      , m_deckIdx(0)
+      , m_fullDeck()
+      , m_deckSize(deck.size())
+      , m_defaultDraws(false)
       , m_indexSelect(idxSelect)
       , m_bonusDraw(bonusDraw)
+      , m_indexOdds(idxOdds)
+      , m_bonusOdds(bonusOdds)
       {
+	using IndexSelectPtr = unsigned(*)(unsigned, unsigned, RngContext&);
+	using BonusDrawPtr = bool(*)(const BoardPtrType&, RngContext&);
+	const IndexSelectPtr* select = m_indexSelect.template target<IndexSelectPtr>();
+	const BonusDrawPtr* bonus = m_bonusDraw.template target<BonusDrawPtr>();
+	m_defaultDraws = select && *select == &uniformRandomIndex &&
+	  bonus && *bonus == &defaultBonusDraw<BoardPtrType>;
+
+	ASSERT(!deck.empty() && deck.size() < 256, "deck needs between 1 and 255 cards");
+	for(const Card card : deck) {
+	  const unsigned rank = cardRank(card);
+	  ASSERT(rank >= 1 && rank <= State::NumDeckRanks, "Kamikaze28Sequence decks only hold 1s, 2s and 3s");
+	  ++m_fullDeck[rank-1];
+	}
+	m_state.remaining = m_fullDeck;
+	m_state.next = 0;
+	m_state.dealt = 0;
 	setupNextCard();
       }
 
@@ -242,6 +401,47 @@ namespace threes {
       return Kamikaze28Sequence<BOARD_TYPE>::ICardSeqPtr(new Kamikaze28Sequence<BOARD_TYPE>(*this) );
     }
 
+    ////////////////////////////////////////
+
+    template<class BOARD_TYPE>
+    void Kamikaze28Sequence<BOARD_TYPE>::assignFrom(const ICardSequence<BOARD_TYPE>& other) {
+      ASSERT( dynamic_cast<const Kamikaze28Sequence<BOARD_TYPE>*>(&other) != nullptr,
+	      "can only assign from another Kamikaze28Sequence" );
+      const auto& otherK28 = static_cast<const Kamikaze28Sequence<BOARD_TYPE>&>(other);
+
+      m_state = otherK28.m_state;
+      m_commonDraw = false;
+      this->m_rng = otherK28.m_rng;
+    }
+
+    ////////////////////////////////////////
+
+    template<class BOARD_TYPE>
+    void Kamikaze28Sequence<BOARD_TYPE>::seed(const uint64_t seed) {
+      ICardSequence<BOARD_TYPE>::seed(seed);
+      m_state.remaining = m_fullDeck;
+      m_state.dealt = 0;
+      m_commonDraw = false;
+      setupNextCard();
+    }
+
+    template<class BOARD_TYPE>
+    void Kamikaze28Sequence<BOARD_TYPE>::reseedCommon(const uint64_t seed, const uint64_t drawIdx) {
+      this->reseed(hashCombine(seed, 2*static_cast<uint64_t>(m_state.dealt)));
+      m_bonusRng = RngContext(hashCombine(seed, 2*drawIdx + 1));
+      m_commonDraw = true;
+    }
+
+    ////////////////////////////////////////
+
+    // Only the multiset of cards left in the deck matters for uniform shuffles,
+    // and for the in-order deck the position in the deck is implied by the
+    // number of cards left, which is exactly what the state holds.
+    template<class BOARD_TYPE>
+    uint64_t Kamikaze28Sequence<BOARD_TYPE>::hash() const {
+      return m_state.hash();
+    }
+
     ////////////////////////////////////////
     
     // All the work happens here - we already know
@@ -249,11 +449,14 @@ namespace threes {
     // but updating "next" is the challenge
     template<class BOARD_TYPE>
     Card Kamikaze28Sequence<BOARD_TYPE>::draw(const BoardPtrType& b) {
-      Card result = m_next;
+      Card result = cardFromRank(m_state.next);
+
+      RngContext& bonusRng = m_commonDraw ? m_bonusRng : this->m_rng;
+      m_commonDraw = false;
 
       // draw bonus or from deck?
-      if( m_bonusDraw(b) ) {
-	m_next = m_bonusGen(b);
+      if( m_defaultDraws ? defaultBonusDraw(b, bonusRng) : m_bonusDraw(b, bonusRng) ) {
+	m_state.next = cardRank(BonusCardGenerator<BOARD_TYPE>()(b, bonusRng));
       }
       else {
 	// pick a remaining card at random
@@ -266,32 +469,96 @@ namespace threes {
     /////////////////////////////////////////
 
     template<class BOARD_TYPE>
-    Card Kamikaze28Sequence<BOARD_TYPE>::peek(const BoardPtrType& b) {
+    Card Kamikaze28Sequence<BOARD_TYPE>::peek(const BoardPtrType& b) const {
       (void)b; // don't need this for this particular impl, here for interface only
-      return(m_next);
+      return(cardFromRank(m_state.next));
     }
 
 
     template<class BOARD_TYPE>
-    void Kamikaze28Sequence<BOARD_TYPE>::setupNextCard() {
-      const unsigned nextSelectedIdx =
-	m_indexSelect(m_deckIdx, m_deck.size()-1);
+    void Kamikaze28Sequence<BOARD_TYPE>::drawOutcomes(const BoardPtrType& b,
+						      std::vector<DrawOutcome>& outcomes) const {
+      outcomes.clear();
+
+      const double bonusOdds = m_bonusOdds(b);
+      if(bonusOdds > 0.0) {
+	// list the bonus cards straight in to outcomes, then split the odds
+	BonusCardGenerator<BOARD_TYPE>::candidates(*b, outcomes);
+	for(auto& outcome : outcomes) {
+	  outcome.probability = bonusOdds / outcomes.size();
+	}
+      }
 
-      // move the selected card to the top of the deck
-      std::swap( m_deck[m_deckIdx], m_deck[nextSelectedIdx] );
+      if(bonusOdds < 1.0) {
+	// the cards left sorted by value take indices lower..upper, see setupNextCard
+	const unsigned lower = m_deckSize - m_state.numRemaining();
+	const unsigned upper = m_deckSize - 1;
+	unsigned idx = lower;
+	for(unsigned rank = 1; rank <= State::NumDeckRanks; ++rank) {
+	  double odds = 0.0;
+	  for(unsigned copy = 0; copy < m_state.remaining[rank-1]; ++copy, ++idx) {
+	    odds += (1.0 - bonusOdds) * m_indexOdds(idx, lower, upper);
+	  }
+	  if(odds > 0.0) {
+	    outcomes.push_back( DrawOutcome{cardFromRank(rank), false, odds} );
+	  }
+	}
+      }
+    }
 
-      // pick the selected card off the top of the deck
-      m_next = m_deck[m_deckIdx];
-      ++m_deckIdx;
+    /////////////////////////////////////////
 
-      // if at the end of the deck, start over
-      if(m_deckIdx == m_deck.size()) {
-	m_deckIdx = 0;
+    template<class BOARD_TYPE>
+    Card Kamikaze28Sequence<BOARD_TYPE>::drawOutcome(const BoardPtrType& b,
+						     const DrawOutcome& outcome) {
+      (void)b; // the outcome already accounts for the board
+      Card result = cardFromRank(m_state.next);
+
+      if(outcome.bonus) {
+	m_state.next = cardRank(outcome.next);
+	return(result);
       }
 
-      
+      takeDeckRank(cardRank(outcome.next));
+      return(result);
     }
 
+    /////////////////////////////////////////
+
+    template<class BOARD_TYPE>
+    void Kamikaze28Sequence<BOARD_TYPE>::setupNextCard() {
+      // the index functions pick from [lower, upper], as if the cards
+      // already dealt sat at the front of a deck of m_deckSize
+      const unsigned lower = m_deckSize - m_state.numRemaining();
+      const unsigned upper = m_deckSize - 1;
+      // uniformRandomIndex, written out
+      const unsigned idx = m_defaultDraws ? this->m_rng.uniformInt(lower, upper)
+					  : m_indexSelect(lower, upper, this->m_rng);
+      takeDeckCard(idx - lower);
+    }
+
+    template<class BOARD_TYPE>
+    void Kamikaze28Sequence<BOARD_TYPE>::takeDeckCard(unsigned offset) {
+      unsigned rank = 1;
+      for(; rank < State::NumDeckRanks && offset >= m_state.remaining[rank-1]; ++rank) {
+	offset -= m_state.remaining[rank-1];
+      }
+      takeDeckRank(rank);
+    }
+
+    template<class BOARD_TYPE>
+    void Kamikaze28Sequence<BOARD_TYPE>::takeDeckRank(const unsigned rank) {
+      ASSERT(rank >= 1 && rank <= State::NumDeckRanks && m_state.remaining[rank-1] > 0,
+	     "card not left in the deck");
+      --m_state.remaining[rank-1];
+      m_state.next = rank;
+      ++m_state.dealt;
+
+      // if at the end of the deck, start over
+      if(m_state.numRemaining() == 0) {
+	m_state.remaining = m_fullDeck;
+      }
+    }
     
   } // ns game
 } // ns threes
@@ -3,7 +3,9 @@
 #include "Board.h"
 #include "Card.h"
 #include "CardSequence.h"
+#include "Hashing.h"
 #include "Utils.h"
+#include "Rng.h"
 
 #include <iostream>
 #include <iomanip>
@@ -38,25 +40,61 @@ namespace threes {
       using CardSequencePtr =  typename ICardSequence<BOARD>::ICardSeqPtr;
       
     public:
+      // Every random choice in the game (sequence shuffles and bonus draws,
+      // initial card placement, insertion slots) derives from seed, so the
+      // same seed and the same moves replay the same game.
       GameDriver(const std::string& sequencerType,
 		 const std::string& sequencerArgs,
-		 const unsigned numStartCards);
+		 const unsigned numStartCards,
+		 const uint64_t seed = RngContext::randomSeed());
+
+      // same, with the card sequence already made (e.g. without the factory)
+      GameDriver(CardSequencePtr cardSeqPtr,
+		 const unsigned numStartCards,
+		 const uint64_t seed);
 
       virtual uint64_t play() = 0; // returns the final score
 
+      const BOARD& board() const { return *m_boardPtr; }
+
+      // the current board's moves, kept up to date by move() so strategies
+      // and the driver share one scan of the board per move
+      const MoveSet& legalMoves() const { return m_legalMoves; }
+
+      // the seed the game was constructed with, replays it with the same moves
+      uint64_t seed() const { return m_seed; }
+
+      // Common random numbers, for comparing strategies on the same games:
+      // move k's insertion slot comes from a stream made fresh from
+      // (seed, k), and the card sequence keys its draws the same way (see
+      // ICardSequence::reseedCommon), instead of both carrying on from move
+      // k-1. Two games with the same seed then see the same random numbers
+      // at every move, whatever moves came before. Off by default; set it
+      // before the first move.
+      void setCommonRandom(const bool on) { m_commonRandom = on; }
+      bool commonRandom() const { return m_commonRandom; }
+
     public:
       static constexpr unsigned StateSize = BOARD::StateSize; 
       
     protected:
       virtual void render() const = 0;
 
+      // SEQ is the card sequence's real type when the caller knows it and
+      // it's final, so the draws bind statically (see StaticGameDriver.h)
+      template<class SEQ = ICardSequence<BOARD>>
       MoveResult move(const ShiftDirection dir); 
 
       uint64_t gameScore() const;
 
       
     protected:
+      const uint64_t m_seed;
+      RngContext m_rng; // board placement/insertion stream
+      bool m_commonRandom = false;
+      uint32_t m_numMoves = 0; // valid moves so far
       BoardPtr m_boardPtr;
+      MoveSet m_legalMoves; // of *m_boardPtr
       CardSequencePtr m_cardSeqPtr;
       
     }; // class GameDriver
@@ -93,14 +131,30 @@ namespace threes {
     template<class BOARD>
     GameDriver<BOARD>::GameDriver(const std::string& sequencerType,
 				  const std::string& sequencerArgs,
-				  const unsigned numStartCards)
-      : m_cardSeqPtr(ICardSequence<BOARD>::s_factory.create(sequencerType, sequencerArgs))
+				  const unsigned numStartCards,
+				  const uint64_t seed)
+      : GameDriver(ICardSequence<BOARD>::s_factory.create(sequencerType, sequencerArgs),
+		   numStartCards, seed)
+      {}
+
+    template<class BOARD>
+    GameDriver<BOARD>::GameDriver(CardSequencePtr cardSeqPtr,
+				  const unsigned numStartCards,
+				  const uint64_t seed)
+      : m_seed(seed)
+      , m_rng(seed)
+      , m_cardSeqPtr(std::move(cardSeqPtr))
       {
+	// the sequence gets its own stream so board and deck stay independent
+	m_cardSeqPtr->seed(m_rng.split()());
+
 	std::vector<Card> initialCards(numStartCards);
 	for(auto itr = initialCards.begin(); itr != initialCards.end(); ++itr) {
 	  *itr = m_cardSeqPtr->draw(nullptr); // null board is okay, means we never get bonus cards
 	}
-	m_boardPtr = std::make_unique<BOARD>( initialCards );
+	m_boardPtr = std::make_unique<BOARD>( initialCards,
+					      pickNRandomIndicies(numStartCards, BOARD::dim, m_rng) );
+	m_legalMoves = m_boardPtr->moves();
       }
 
     
@@ -114,40 +168,34 @@ namespace threes {
     }
     
     template<class BOARD>
+    template<class SEQ>
     MoveResult GameDriver<BOARD>::move(const ShiftDirection dir) {
       // if shift is valid, then apply it
-      if( m_boardPtr->canShift(dir) ) {
-	Card toInsert = m_cardSeqPtr->draw(m_boardPtr);
-	m_boardPtr->shiftBoard(dir, toInsert);
-      } else {
+      if( !m_legalMoves.canShift(dir) ) {
 	return MOVE_INVALID;
       }
-
-      // check to see if any new move can happen
-      for( auto dir : {DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT} ) {
-	if( m_boardPtr->canShift(dir) ) {
-	  return MOVE_VALID;
-	}
+      SEQ& cardSeq = static_cast<SEQ&>(*m_cardSeqPtr);
+      if( m_commonRandom ) {
+	cardSeq.reseedCommon(mixHash(m_seed), m_numMoves);
+	Card toInsert = cardSeq.draw(m_boardPtr);
+	RngContext insertRng(hashCombine(m_seed, m_numMoves));
+	m_boardPtr->shiftBoard(m_legalMoves, dir, toInsert, insertRng);
+      } else {
+	Card toInsert = cardSeq.draw(m_boardPtr);
+	m_boardPtr->shiftBoard(m_legalMoves, dir, toInsert, m_rng);
       }
-      // if no further moves were possible, game should end
-      return END_GAME;
+      ++m_numMoves;
+
+      // if no further moves are possible, game should end
+      m_legalMoves = m_boardPtr->moves();
+      return m_legalMoves.any() ? MOVE_VALID : END_GAME;
     }
 
 
     template<class BOARD>
     uint64_t GameDriver<BOARD>::gameScore() const {
-      static constexpr double EPSILON = 1e-2;
-      // todo: should score counting logic be in the Card class or the
-      // GameDriver class? For now, put it here so other GameDriver impls
-      // can choose their own method.
-
-      auto boardData = m_boardPtr->underlyingDataRef();
-      uint64_t result=0;
-      for( auto cardData : boardData ) {
-	const double currCardScoreDbl = standardCardScore(cardData);
-	result += static_cast<uint64_t>(currCardScoreDbl + EPSILON);
-      }
-      return result;
+      // the board keeps its score current as the game goes
+      return m_boardPtr->score();
     }
     
 
@@ -3,6 +3,10 @@
 #include "Utils.h"
 #include "Board.h"
 #include "GameDriver.h"
+#include "GameRecord.h"
+#include "ReplayArchive.h"
+#include "SearchStats.h"
+#include <chrono>
 #include <string>
 #include <random>
 #include <memory>
@@ -14,6 +18,13 @@ namespace threes {
     template<class BOARD>
     class IThreesStgy {
     public:
+      // seeded from the thread's default context like ICardSequence, the
+      // drivers reseed it for every game anyway
+      IThreesStgy()
+	: m_rng(defaultRngContext()())
+	{}
+      virtual ~IThreesStgy() {}
+
       virtual ShiftDirection move(const typename GameDriver<BOARD>::BoardPtr& boardPtr,
 			      const typename ICardSequence<BOARD>::ICardSeqPtr& seqPtr) = 0;
 
@@ -21,6 +32,20 @@ namespace threes {
 
       using StgyFactory = ro::ObjectFromStrFactory< IThreesStgy<BOARD> >;
       static StgyFactory s_factory;
+
+      // source of all the strategy's own randomness (tie breaks, search samples).
+      // Reseeding starts a fresh, reproducible run, so overrides should also
+      // drop any state carried over from earlier games.
+      virtual void seed(const uint64_t seed) { m_rng = RngContext(seed); }
+
+      // cost of every move made since construction, the game driver fills
+      // in the latencies and searching strategies their own counters
+      SearchStats& stats() { return m_stats; }
+      const SearchStats& stats() const { return m_stats; }
+
+    protected:
+      RngContext m_rng;
+      SearchStats m_stats;
       
     };
 
@@ -34,12 +59,8 @@ namespace threes {
 
 	(void)boardPtr; // here to preserve interface only, random stgy ignores it
 	(void)seqPtr; // here to preserve interface only, random stgy ignores it
-	std::random_device rd;
-	std::mt19937 g(rd());
 	//todo: this assumes contiguous direction ENUM starting at 0
-	std::uniform_int_distribution<> dist(0, NUM_DIRECTIONS-1);
-	
-	return ShiftDirection( dist(g) );
+	return ShiftDirection( this->m_rng.uniformInt(0, NUM_DIRECTIONS-1) );
       }
 
       static typename IThreesStgy<BOARD>::ThreesStgyPtr create(const std::string& args) {
@@ -57,13 +78,27 @@ namespace threes {
       GameDriverStgy(const std::string& sequencerType,
 		     const std::string& sequencerArgs,
 		     const unsigned numStartCards,
-		     typename IThreesStgy<BOARD>::ThreesStgyPtr& stgyPtr)
-	: GameDriver<BOARD>(sequencerType, sequencerArgs, numStartCards)
+		     typename IThreesStgy<BOARD>::ThreesStgyPtr& stgyPtr,
+		     const bool verbose = true,
+		     const uint64_t seed = RngContext::randomSeed())
+	: GameDriver<BOARD>(sequencerType, sequencerArgs, numStartCards, seed)
 	, m_stgyPtr(std::move(stgyPtr))
-	{}
+	, m_verbose(verbose)
+	{
+	  m_stgyPtr->seed(this->m_rng.split()());
+	}
 	  
       virtual uint64_t play() override; // GameDriver interface
 
+      // hand the strategy back, e.g. to reuse it (and its caches) for the next game
+      typename IThreesStgy<BOARD>::ThreesStgyPtr releaseStgy() { return std::move(m_stgyPtr); }
+
+      // log every move and the final score to recorder (not owned, may be
+      // shared between games), null turns recording off
+      void setRecorder(GameRecordWriter* recorder) { m_recorder = recorder; }
+      // same for the seed + moves archive
+      void setArchive(ReplayArchiveWriter* archive) { m_archive = archive; }
+
     protected:
       virtual void render() const override {} // no render for automated play
 
@@ -72,6 +107,11 @@ namespace threes {
       using GameDriver<BOARD>::m_cardSeqPtr;
       
       typename IThreesStgy<BOARD>::ThreesStgyPtr m_stgyPtr;
+      const bool m_verbose;
+      GameRecordWriter* m_recorder = nullptr;
+      std::vector<GameRecordEntry> m_record; // this game's entries so far
+      ReplayArchiveWriter* m_archive = nullptr;
+      std::vector<ShiftDirection> m_moves;    // this game's valid moves so far
       
     }; // class GameDriverStgy
 
@@ -80,16 +120,23 @@ namespace threes {
     uint64_t GameDriverStgy<BOARD>::play() {
 
       static constexpr unsigned MAX_CONSEC_INVALID = 1000u;
+      (void)MAX_CONSEC_INVALID; // only read by ASSERT
       
       unsigned numConsecInvalid=0;
       MoveResult lastMove=MOVE_INVALID;
       while( lastMove != END_GAME ) {
 
+	const auto moveStart = std::chrono::steady_clock::now();
 	ShiftDirection moveDir = m_stgyPtr->move(m_boardPtr, m_cardSeqPtr);
+	m_stgyPtr->stats().moveLatency.add(std::chrono::steady_clock::now() - moveStart);
 
+	if(m_recorder && this->legalMoves().canShift(moveDir)) {
+	  m_record.push_back(GameRecordEntry::moveEntry(*m_boardPtr, m_cardSeqPtr->peek(m_boardPtr), moveDir));
+	}
 	lastMove = this->move(moveDir);
 	if(lastMove != MOVE_INVALID) {
 	  numConsecInvalid = 0;
+	  if(m_archive) { m_moves.push_back(moveDir); }
 	} else {
 	  ++numConsecInvalid;
 	  ASSERT(numConsecInvalid < MAX_CONSEC_INVALID,
@@ -100,13 +147,23 @@ namespace threes {
 
       uint64_t score = this->gameScore();
 
-      defaultTerminalRender(m_boardPtr, m_cardSeqPtr);
-      
-      std::cout << "No more valid moves! Game over, your score is "
-		<< score << std::endl;
-      std::cout << std::endl << std::endl;
+      if(m_recorder) {
+	m_record.push_back(GameRecordEntry::endEntry(*m_boardPtr, static_cast<uint32_t>(score)));
+	m_recorder->appendGame(m_record);
+	m_record.clear();
+      }
+      if(m_archive) {
+	m_archive->appendGame(this->seed(), m_moves);
+	m_moves.clear();
+      }
 
-      
+      if(m_verbose) {
+	defaultTerminalRender(m_boardPtr, m_cardSeqPtr);
+
+	std::cout << "No more valid moves! Game over, your score is "
+		  << score << std::endl;
+	std::cout << std::endl << std::endl;
+      }
       
       return score;
     }
@@ -0,0 +1,163 @@
+#include "GameRecord.h"
+
+#include "Utils.h"
+
+#include <cstring>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define THREES_RECORD_HAS_MMAP 1
+#endif
+
+namespace {
+
+  void writeU32(std::ostream& out, const uint32_t value) {
+    const char bytes[4] = { static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF),
+			    static_cast<char>((value >> 16) & 0xFF), static_cast<char>((value >> 24) & 0xFF) };
+    out.write(bytes, 4);
+  }
+
+  uint32_t readU32(const unsigned char* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+      (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+  // dim of the file, or 0 if the header isn't one we can read
+  unsigned checkHeader(const unsigned char* header) {
+    using threes::game::GameRecordHeader;
+    if(std::memcmp(header, GameRecordHeader::Magic, sizeof(GameRecordHeader::Magic)) != 0) { return 0; }
+    if(readU32(header + 4) != GameRecordHeader::FormatVersion) { return 0; }
+    if(readU32(header + 12) != sizeof(threes::game::GameRecordEntry)) { return 0; }
+    const uint32_t dim = readU32(header + 8);
+    return (dim > 0 && dim*dim <= 32) ? dim : 0;
+  }
+
+} // anon ns
+
+namespace threes {
+  namespace game {
+
+    constexpr char GameRecordHeader::Magic[4];
+    constexpr uint32_t GameRecordHeader::FormatVersion;
+    constexpr unsigned GameRecordHeader::Size;
+    constexpr size_t GameRecordWriter::BufferEntries;
+
+    GameRecordWriter::GameRecordWriter(const std::string& path, const unsigned dim)
+      : m_out(path, std::ios::binary | std::ios::trunc)
+      , m_dim(dim)
+      , m_numEntries(0)
+      , m_numGames(0)
+    {
+      ASSERT(dim > 0 && dim*dim <= 32, "board too big for a game record");
+      m_buffer.reserve(BufferEntries);
+      m_out.write(GameRecordHeader::Magic, sizeof(GameRecordHeader::Magic));
+      writeU32(m_out, GameRecordHeader::FormatVersion);
+      writeU32(m_out, dim);
+      writeU32(m_out, sizeof(GameRecordEntry));
+    }
+
+    GameRecordWriter::~GameRecordWriter() {
+      flush();
+    }
+
+    void GameRecordWriter::appendGame(const std::vector<GameRecordEntry>& entries) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_buffer.size() + entries.size() > BufferEntries) {
+	flushLocked();
+      }
+      if(entries.size() > BufferEntries) {
+	// longer than the buffer, nothing to gain from copying it
+	m_out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(GameRecordEntry));
+      } else {
+	m_buffer.insert(m_buffer.end(), entries.begin(), entries.end());
+      }
+      m_numEntries += entries.size();
+      ++m_numGames;
+    }
+
+    void GameRecordWriter::flush() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      flushLocked();
+    }
+
+    void GameRecordWriter::flushLocked() {
+      if(!m_buffer.empty()) {
+	m_out.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size() * sizeof(GameRecordEntry));
+	m_buffer.clear();
+      }
+      m_out.flush();
+    }
+
+    ////////////////////
+
+    MappedFile::MappedFilePtr MappedFile::open(const std::string& path) {
+      MappedFilePtr result(new MappedFile());
+
+#ifdef THREES_RECORD_HAS_MMAP
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if(fd < 0) { return nullptr; }
+      struct stat info;
+      if(fstat(fd, &info) != 0) {
+	::close(fd);
+	return nullptr;
+      }
+      result->m_size = info.st_size;
+      if(result->m_size == 0) {
+	::close(fd);
+	return result; // can't map nothing, but it's a valid empty file
+      }
+      void* mem = mmap(nullptr, result->m_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd); // the mapping keeps the file open
+      if(mem == MAP_FAILED) { return nullptr; }
+      result->m_data = static_cast<const unsigned char*>(mem);
+      result->m_mapped = true;
+#else
+      std::ifstream in(path, std::ios::binary);
+      if(!in.good()) { return nullptr; }
+      result->m_copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+      result->m_data = result->m_copy.data();
+      result->m_size = result->m_copy.size();
+#endif
+      return result;
+    }
+
+    MappedFile::~MappedFile() {
+#ifdef THREES_RECORD_HAS_MMAP
+      if(m_mapped) {
+	munmap(const_cast<unsigned char*>(m_data), m_size);
+      }
+#endif
+    }
+
+    ////////////////////
+
+    GameRecordReader::GameRecordReaderPtr GameRecordReader::open(const std::string& path) {
+      GameRecordReaderPtr result(new GameRecordReader());
+      result->m_file = MappedFile::open(path);
+      if(!result->m_file || result->m_file->size() < GameRecordHeader::Size) { return nullptr; }
+
+      const unsigned char* data = result->m_file->data();
+      result->m_dim = checkHeader(data);
+      const size_t entryBytes = result->m_file->size() - GameRecordHeader::Size;
+      if(result->m_dim == 0 || entryBytes % sizeof(GameRecordEntry) != 0) { return nullptr; }
+      result->m_entries = reinterpret_cast<const GameRecordEntry*>(data + GameRecordHeader::Size);
+      result->m_numEntries = entryBytes / sizeof(GameRecordEntry);
+      return result;
+    }
+
+    std::vector<size_t> GameRecordReader::gameStarts() const {
+      std::vector<size_t> result;
+      bool atStart = true;
+      for(size_t i = 0; i < m_numEntries; ++i) {
+	if(atStart) { result.push_back(i); }
+	atStart = m_entries[i].gameEnd();
+      }
+      return result;
+    }
+
+  } // namespace game
+} // namespace threes
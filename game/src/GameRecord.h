@@ -0,0 +1,206 @@
+#pragma once
+
+/*
+ * Binary log of whole games for offline analysis.
+ *
+ * A file is a 16 byte header ("THGR", format version, board dim, entry
+ * size, each a little endian uint32) followed by fixed width 24 byte
+ * entries. Each game is its move entries in play order, then one end
+ * entry. A move entry holds the board before the move, the next card as
+ * shown to the player and the move made. The end entry holds the final
+ * board and score.
+ *
+ * Entries are plain bytes with no padding or host byte order, so a reader
+ * can use a memory mapped file directly.
+ */
+
+#include "Card.h"
+#include "Board.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    struct GameRecordEntry {
+      enum Kind : uint8_t {
+	KIND_MOVE = 0,
+	KIND_GAME_END = 1
+      };
+
+      // board as 4 bit card ranks, tile i in byte i/2, low nibble first.
+      // Fits boards up to 5x5; ranks stop at S_MAX_CARD_RANK as the largest
+      // cards don't combine.
+      std::array<uint8_t, 16> tiles;
+      uint8_t nextRank;    // rank of the next card, move entries only
+      uint8_t move;        // ShiftDirection, move entries only
+      uint8_t kind;
+      uint8_t reserved;
+      std::array<uint8_t, 4> scoreBytes; // final score, end entries only
+
+      unsigned rankAt(const unsigned tile) const {
+	return (tiles[tile/2] >> (4*(tile % 2))) & 0xF;
+      }
+      Card cardAt(const unsigned tile) const { return cardFromRank(rankAt(tile)); }
+      Card nextCard() const { return cardFromRank(nextRank); }
+      ShiftDirection direction() const { return static_cast<ShiftDirection>(move); }
+      bool gameEnd() const { return kind == KIND_GAME_END; }
+      uint32_t score() const {
+	return static_cast<uint32_t>(scoreBytes[0]) | (static_cast<uint32_t>(scoreBytes[1]) << 8) |
+	  (static_cast<uint32_t>(scoreBytes[2]) << 16) | (static_cast<uint32_t>(scoreBytes[3]) << 24);
+      }
+
+      template<class BOARD>
+      static GameRecordEntry fromBoard(const BOARD& board);
+      template<class BOARD>
+      static GameRecordEntry moveEntry(const BOARD& board, const Card next, const ShiftDirection dir);
+      template<class BOARD>
+      static GameRecordEntry endEntry(const BOARD& board, const uint32_t score);
+    };
+    static_assert(sizeof(GameRecordEntry) == 24, "game record entries must have no padding");
+
+    struct GameRecordHeader {
+      static constexpr char Magic[4] = { 'T', 'H', 'G', 'R' };
+      static constexpr uint32_t FormatVersion = 1;
+      static constexpr unsigned Size = 16;
+    };
+
+    // Appends games to a record file, buffering entries and writing them
+    // out in large blocks. appendGame is safe to call from several threads,
+    // each game's entries stay together.
+    class GameRecordWriter {
+    public:
+      // truncates path and writes the header, check good() afterwards
+      GameRecordWriter(const std::string& path, const unsigned dim);
+      ~GameRecordWriter(); // flushes
+
+      GameRecordWriter(const GameRecordWriter&) = delete;
+      GameRecordWriter& operator=(const GameRecordWriter&) = delete;
+
+      void appendGame(const std::vector<GameRecordEntry>& entries);
+      void flush();
+
+      bool good() const { return m_out.good(); }
+      unsigned dim() const { return m_dim; }
+      uint64_t numEntries() const { return m_numEntries; }
+      uint64_t numGames() const { return m_numGames; }
+
+    private:
+      static constexpr size_t BufferEntries = 1 << 14; // 384KB
+
+      void flushLocked();
+
+    private:
+      std::ofstream m_out;
+      const unsigned m_dim;
+      std::vector<GameRecordEntry> m_buffer;
+      uint64_t m_numEntries;
+      uint64_t m_numGames;
+      std::mutex m_mutex;
+    };
+
+    // A whole file, read only, memory mapped where available and read in
+    // to memory otherwise
+    class MappedFile {
+    public:
+      using MappedFilePtr = std::unique_ptr<MappedFile>;
+
+      // nullptr if the file can't be opened
+      static MappedFilePtr open(const std::string& path);
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      const unsigned char* data() const { return m_data; }
+      size_t size() const { return m_size; }
+
+    private:
+      MappedFile() = default;
+
+    private:
+      const unsigned char* m_data = nullptr;
+      size_t m_size = 0;
+      bool m_mapped = false;
+      std::vector<unsigned char> m_copy; // fallback without mmap
+    };
+
+    // Read only view of a record file, entries are used in place
+    class GameRecordReader {
+    public:
+      using GameRecordReaderPtr = std::unique_ptr<GameRecordReader>;
+
+      // nullptr if the file is missing, not a record file or truncated
+      static GameRecordReaderPtr open(const std::string& path);
+
+      GameRecordReader(const GameRecordReader&) = delete;
+      GameRecordReader& operator=(const GameRecordReader&) = delete;
+
+      unsigned dim() const { return m_dim; }
+      size_t size() const { return m_numEntries; }
+      const GameRecordEntry& operator[](const size_t i) const { return m_entries[i]; }
+      const GameRecordEntry* begin() const { return m_entries; }
+      const GameRecordEntry* end() const { return m_entries + m_numEntries; }
+
+      // index of the first entry of every game, in file order
+      std::vector<size_t> gameStarts() const;
+
+    private:
+      GameRecordReader() = default;
+
+    private:
+      MappedFile::MappedFilePtr m_file;
+      unsigned m_dim = 0;
+      const GameRecordEntry* m_entries = nullptr;
+      size_t m_numEntries = 0;
+    };
+
+
+    //////////////////////////////////////////////////////////
+    // implementations
+    //////////////////////////////////////////////////////////
+
+    template<class BOARD>
+    GameRecordEntry GameRecordEntry::fromBoard(const BOARD& board) {
+      static_assert(BOARD::dim*BOARD::dim <= 32, "board too big for a game record");
+      GameRecordEntry result;
+      result.tiles.fill(0);
+      const auto data = board.underlyingDataRef();
+      for(unsigned i = 0; i < BOARD::dim*BOARD::dim; ++i) {
+	result.tiles[i/2] |= static_cast<uint8_t>(cardRank(data[i]) << (4*(i % 2)));
+      }
+      result.nextRank = 0;
+      result.move = 0;
+      result.kind = KIND_MOVE;
+      result.reserved = 0;
+      result.scoreBytes.fill(0);
+      return result;
+    }
+
+    template<class BOARD>
+    GameRecordEntry GameRecordEntry::moveEntry(const BOARD& board, const Card next,
+					       const ShiftDirection dir) {
+      GameRecordEntry result(fromBoard(board));
+      result.nextRank = static_cast<uint8_t>(cardRank(next));
+      result.move = static_cast<uint8_t>(dir);
+      return result;
+    }
+
+    template<class BOARD>
+    GameRecordEntry GameRecordEntry::endEntry(const BOARD& board, const uint32_t score) {
+      GameRecordEntry result(fromBoard(board));
+      result.kind = KIND_GAME_END;
+      for(unsigned i = 0; i < 4; ++i) {
+	result.scoreBytes[i] = static_cast<uint8_t>((score >> (8*i)) & 0xFF);
+      }
+      return result;
+    }
+
+  } // namespace game
+} // namespace threes
@@ -0,0 +1,28 @@
+#include "Hashing.h"
+
+#include <memory>
+
+namespace {
+
+  uint64_t nextKey(uint64_t& state) {
+    state += 0x9E3779B97F4A7C15ULL;
+    return threes::game::mixHash(state);
+  }
+
+  threes::game::ZobristKeys* buildZobristKeys() {
+    uint64_t state = 0x7468726565734B59ULL; // any fixed seed works
+    threes::game::ZobristKeys* keys = new threes::game::ZobristKeys();
+    for(auto& tileKeys : keys->tile) {
+      for(auto& key : tileKeys) { key = nextKey(state); }
+    }
+    for(auto& key : keys->depth) { key = nextKey(state); }
+    for(auto& key : keys->move) { key = nextKey(state); }
+    return keys;
+  }
+
+} // anon ns
+
+const threes::game::ZobristKeys& threes::game::zobristKeys() {
+  static const std::unique_ptr<const ZobristKeys> s_keys(buildZobristKeys());
+  return *s_keys;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * Zobrist style hashing of boards and search nodes, for transposition tables
+ */
+
+#include <array>
+#include <cstdint>
+
+#include "Card.h"
+#include "Board.h"
+#include "PackedBoard.h"
+
+namespace threes {
+  namespace game {
+
+    // splitmix64 finalizer, decent avalanche for cheap
+    inline uint64_t mixHash(uint64_t x) {
+      x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+      x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+      x ^= x >> 31;
+      return x;
+    }
+
+    inline uint64_t hashCombine(const uint64_t seed, const uint64_t value) {
+      return mixHash(seed ^ (value + 0x9E3779B97F4A7C15ULL + (seed << 6) + (seed >> 2)));
+    }
+
+    // fixed random keys, identical in every process so hashes are reproducible
+    struct ZobristKeys {
+      static constexpr unsigned MaxTiles = 64;
+      static constexpr unsigned MaxDepth = 64;
+
+      std::array<std::array<uint64_t, S_MAX_CARD_RANK+1>, MaxTiles> tile;
+      std::array<uint64_t, MaxDepth> depth;
+      std::array<uint64_t, NUM_DIRECTIONS> move;
+    };
+
+    const ZobristKeys& zobristKeys();
+
+    // generic board, xor of one key per occupied tile
+    template<class BOARD>
+    uint64_t hashBoard(const BOARD& board) {
+      static_assert(BOARD::dim*BOARD::dim <= ZobristKeys::MaxTiles, "board too big to hash");
+      const ZobristKeys& keys = zobristKeys();
+      const auto& data = board.underlyingDataRef();
+      uint64_t result = 0;
+      for(unsigned i=0; i < data.size(); ++i) {
+	if(data[i].value == 0) { continue; }
+	const unsigned rank = cardRank(data[i]);
+	result ^= (rank <= S_MAX_CARD_RANK) ? keys.tile[i][rank]
+	                                    : mixHash((static_cast<uint64_t>(i) << 32) | data[i].value);
+      }
+      return result;
+    }
+
+    // the packed board already is a perfect key, just spread its bits
+    template<class RAND_GEN>
+    uint64_t hashBoard(const PackedBoard4<RAND_GEN>& board) {
+      return mixHash(board.packed());
+    }
+
+  } // namespace game
+} // namespace threes
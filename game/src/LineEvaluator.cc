@@ -0,0 +1,107 @@
+#include "LineEvaluator.h"
+
+#include <memory>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define THREES_LINE_EVAL_HAS_AVX2 1
+#endif
+
+namespace {
+
+  using threes::game::LineEvalTables;
+
+  LineEvalTables* buildLineEvalTables() {
+    LineEvalTables* tables = new LineEvalTables();
+    std::array<threes::game::Card, 4> tiles;
+    for(unsigned line = 0; line < LineEvalTables::NumLines; ++line) {
+      unsigned empties = 0;
+      for(unsigned i = 0; i < 4; ++i) {
+	tiles[i] = threes::game::cardFromRank((line >> (4*i)) & 0xF);
+	if(tiles[i].value == 0) { ++empties; }
+      }
+      const int32_t features = threes::game::lineFeatureScore<4>(tiles, 0, 1);
+      tables->row[line] = (3*empties + features) * threes::game::LineEvalScale;
+      tables->col[line] = features * threes::game::LineEvalScale;
+    }
+    return tables;
+  }
+
+  void lineLookupValuesScalar(const uint64_t* packed, const uint32_t* maxCards,
+			      const size_t begin, const size_t end, double* out) {
+    for(size_t i = begin; i < end; ++i) {
+      const int32_t total = static_cast<int32_t>(maxCards[i]) * threes::game::LineEvalScale +
+	threes::game::packedLineScore(packed[i]);
+      out[i] = static_cast<double>(total) / threes::game::LineEvalScale;
+    }
+  }
+
+#ifdef THREES_LINE_EVAL_HAS_AVX2
+  // transposePacked on four boards
+  __attribute__((target("avx2")))
+  __m256i transposePacked4(const __m256i x) {
+    const __m256i a1 = _mm256_and_si256(x, _mm256_set1_epi64x(0xF0F00F0FF0F00F0FLL));
+    const __m256i a2 = _mm256_and_si256(x, _mm256_set1_epi64x(0x0000F0F00000F0F0LL));
+    const __m256i a3 = _mm256_and_si256(x, _mm256_set1_epi64x(0x0F0F00000F0F0000LL));
+    const __m256i a = _mm256_or_si256(a1, _mm256_or_si256(_mm256_slli_epi64(a2, 12), _mm256_srli_epi64(a3, 12)));
+    const __m256i b1 = _mm256_and_si256(a, _mm256_set1_epi64x(static_cast<long long>(0xFF00FF0000FF00FFULL)));
+    const __m256i b2 = _mm256_and_si256(a, _mm256_set1_epi64x(0x00FF00FF00000000LL));
+    const __m256i b3 = _mm256_and_si256(a, _mm256_set1_epi64x(0x00000000FF00FF00LL));
+    return _mm256_or_si256(b1, _mm256_or_si256(_mm256_srli_epi64(b2, 24), _mm256_slli_epi64(b3, 24)));
+  }
+
+  // the four 16 bit lines of each of four boards looked up in table and summed
+  __attribute__((target("avx2")))
+  __m128i lineSums4(const __m256i lines, const int32_t* table) {
+    const __m256i lineMask = _mm256_set1_epi64x(0xFFFF);
+    __m128i sum = _mm_setzero_si128();
+    for(int shift = 0; shift < 64; shift += 16) {
+      const __m256i idx = _mm256_and_si256(_mm256_srli_epi64(lines, shift), lineMask);
+      sum = _mm_add_epi32(sum, _mm256_i64gather_epi32(table, idx, 4));
+    }
+    return sum;
+  }
+
+  // handles the multiple of four boards, returns how many that was
+  __attribute__((target("avx2")))
+  size_t lineLookupValuesAvx2(const uint64_t* packed, const uint32_t* maxCards,
+			      const size_t n, double* out) {
+    const LineEvalTables& tables = threes::game::lineEvalTables();
+    const __m128i scale = _mm_set1_epi32(threes::game::LineEvalScale);
+    const __m256d invScale = _mm256_set1_pd(1.0 / threes::game::LineEvalScale);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+      const __m256i rows = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + i));
+      const __m128i maxCard = _mm_loadu_si128(reinterpret_cast<const __m128i*>(maxCards + i));
+      __m128i total = _mm_mullo_epi32(maxCard, scale);
+      total = _mm_add_epi32(total, lineSums4(rows, tables.row.data()));
+      total = _mm_add_epi32(total, lineSums4(transposePacked4(rows), tables.col.data()));
+      // the sum is exact in int32, and so is its conversion, same as the scalar path
+      _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_cvtepi32_pd(total), invScale));
+    }
+    return i;
+  }
+
+  bool cpuHasAvx2() {
+    static const bool s_hasAvx2 = __builtin_cpu_supports("avx2");
+    return s_hasAvx2;
+  }
+#endif
+
+} // anon ns
+
+const threes::game::LineEvalTables& threes::game::lineEvalTables() {
+  static const std::unique_ptr<const LineEvalTables> s_tables(buildLineEvalTables());
+  return *s_tables;
+}
+
+void threes::game::lineLookupValues(const uint64_t* packed, const uint32_t* maxCards,
+				    const size_t n, double* out) {
+  size_t done = 0;
+#ifdef THREES_LINE_EVAL_HAS_AVX2
+  if(cpuHasAvx2()) {
+    done = lineLookupValuesAvx2(packed, maxCards, n, out);
+  }
+#endif
+  lineLookupValuesScalar(packed, maxCards, done, n, out);
+}
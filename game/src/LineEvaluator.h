@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+ * Table driven alternative to ExpectiMaxTree::valueFunction for 4x4 boards.
+ * Every one of the 65536 packed lines (see RowTable.h) is scored once up
+ * front, and a board's value is then its max card plus eight lookups: the
+ * four rows and the four columns (the rows of the transposed board).
+ *
+ * A line scores lineFeatureScore (adjacent pairs and trapped cards), and
+ * rows also score 3 per empty tile, so both are counted once per board.
+ * This is valueFunction without the top-three placement bonuses, which
+ * need the whole board and can't be split in to lines.
+ *
+ * Table entries are fixed point integers in 1/LineEvalScale units, so the
+ * sum stays in integer arithmetic and weights needn't be whole numbers.
+ *
+ * lineLookupValues scores a whole block of boards, kept as one array of
+ * packed tiles and one of max cards, several boards per instruction.
+ */
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#include "Board.h"
+#include "BoardFeatures.h"
+#include "PackedBoard.h"
+#include "RowTable.h"
+#include "Utils.h"
+
+namespace threes {
+  namespace game {
+
+    static constexpr int32_t LineEvalScale = 16;
+
+    struct LineEvalTables {
+      static constexpr unsigned NumLines = 1u << 16;
+
+      std::array<int32_t, NumLines> row;
+      std::array<int32_t, NumLines> col;
+    };
+
+    // built on first use, shared and read only afterwards
+    const LineEvalTables& lineEvalTables();
+
+    // sum of the eight line lookups for a packed board, in LineEvalScale units
+    inline int32_t packedLineScore(const uint64_t packed) {
+      const LineEvalTables& tables = lineEvalTables();
+      const uint64_t transposed = transposePacked(packed);
+      return tables.row[ packed             & 0xFFFF] +
+	     tables.row[(packed     >> 16) & 0xFFFF] +
+	     tables.row[(packed     >> 32) & 0xFFFF] +
+	     tables.row[(packed     >> 48) & 0xFFFF] +
+	     tables.col[ transposed         & 0xFFFF] +
+	     tables.col[(transposed >> 16) & 0xFFFF] +
+	     tables.col[(transposed >> 32) & 0xFFFF] +
+	     tables.col[(transposed >> 48) & 0xFFFF];
+    }
+
+    // lineLookupValue of n boards, board i given by packed[i] and
+    // maxCards[i]. Four boards at a time with AVX2 gathers if the CPU has
+    // them, one at a time otherwise; the results are the same either way.
+    void lineLookupValues(const uint64_t* packed, const uint32_t* maxCards,
+			  const size_t n, double* out);
+
+    // 4x4 tiles in the PackedBoard4 layout, from the per rank tile masks
+    template<class BOARD>
+    uint64_t packedTiles(const BOARD& board) {
+      ASSERT(BOARD::dim == 4, "only 4x4 boards pack in to 64 bits");
+      uint64_t packed = 0;
+      for(unsigned rank = 1; rank <= S_MAX_CARD_RANK; ++rank) {
+	for(tile_mask_t tiles = board.rankMask(rank); tiles; tiles &= tiles - 1) {
+	  packed |= static_cast<uint64_t>(rank) << (4*__builtin_ctz(tiles));
+	}
+      }
+      return packed;
+    }
+
+    template<class RAND_GEN>
+    uint64_t packedTiles(const PackedBoard4<RAND_GEN>& board) {
+      return board.packed();
+    }
+
+    template<class BOARD>
+    double lineLookupValue(const BOARD& board, std::true_type) {
+      const int32_t total = static_cast<int32_t>(board.maxCard().value) * LineEvalScale +
+	packedLineScore(packedTiles(board));
+      return static_cast<double>(total) / LineEvalScale;
+    }
+
+    template<class BOARD>
+    double lineLookupValue(const BOARD& board, std::false_type) {
+      (void)board;
+      ASSERT(false, "line lookup evaluation needs a 4x4 board");
+      return 0.0;
+    }
+
+    // the table evaluator's value of board
+    template<class BOARD>
+    double lineLookupValue(const BOARD& board) {
+      return lineLookupValue(board, std::integral_constant<bool, BOARD::dim == 4>());
+    }
+
+  } // namespace game
+} // namespace threes
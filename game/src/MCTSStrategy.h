@@ -0,0 +1,457 @@
+#pragma once
+
+/*
+ * Monte Carlo tree search strategy. The tree alternates player nodes (pick
+ * a move) and chance nodes (the card drawn and the slot it lands in).
+ * Player nodes choose between their moves by UCT over the moves' mean
+ * rollout values, normalized to the range of values seen so far. Chance
+ * nodes sample an outcome from the game's own sequence and board rng, and
+ * follow (or add) the player node for the board that comes out, so
+ * outcomes are visited in proportion to their odds.
+ *
+ * Several threads can search one move: with root parallelism each builds
+ * its own tree and the root visit counts are summed at the end, with tree
+ * parallelism they share one tree behind a lock, running rollouts outside
+ * it, and virtual loss steers threads away from the paths others are on.
+ */
+
+#include "Board.h"
+#include "BoardFeatures.h"
+#include "CardSequence.h"
+#include "GameDriverStrategy.h"
+#include "Hashing.h"
+#include "LineEvaluator.h"
+#include "Rng.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    enum RolloutPolicy {
+      ROLLOUT_RANDOM,  // uniform over the valid moves
+      ROLLOUT_GREEDY,  // most points merged this move
+      ROLLOUT_LUT      // best line lookup value after the move (4x4 only)
+    };
+
+    // Settings for MCTSStrategy, ';' delimited key=value pairs, all optional:
+    //   iters=<N>               playouts per move, summed over threads (default 1000)
+    //   timems=<ms>             time budget per move instead, or as well: stop at
+    //                           whichever comes first
+    //   c=<x>                   UCT exploration constant (default 1.0)
+    //   rollout=random|greedy|lut
+    //                           rollout move policy (default random)
+    //   rolloutdepth=<N>        moves per rollout, 0 (default) plays to the end
+    //   threads=<N>             search threads per move (default 1)
+    //   parallel=root|tree      root (default): a tree per thread; tree: one
+    //                           shared tree with virtual loss
+    //   vloss=<N>               virtual loss per thread on a path (default 1)
+    struct MCTSConfig {
+      unsigned iterations = 1000;
+      double timeBudgetMs = 0.0;
+      double exploration = 1.0;
+      RolloutPolicy rollout = ROLLOUT_RANDOM;
+      unsigned rolloutDepth = 0;
+      unsigned numThreads = 1;
+      bool treeParallel = false;
+      unsigned virtualLoss = 1;
+
+      static MCTSConfig fromStr(const std::string& args) {
+	MCTSConfig config;
+	for(const auto& opt : ro::parseKeyValues( ro::strsplit(args, ";") )) {
+	  if     (opt.first == "iters"       ) { config.iterations = std::stoul(opt.second); }
+	  else if(opt.first == "timems"      ) { config.timeBudgetMs = std::stod(opt.second); }
+	  else if(opt.first == "c"           ) { config.exploration = std::stod(opt.second); }
+	  else if(opt.first == "rolloutdepth") { config.rolloutDepth = std::stoul(opt.second); }
+	  else if(opt.first == "threads"     ) { config.numThreads = std::stoul(opt.second); }
+	  else if(opt.first == "vloss"       ) { config.virtualLoss = std::stoul(opt.second); }
+	  else if(opt.first == "rollout") {
+	    if     (opt.second == "random") { config.rollout = ROLLOUT_RANDOM; }
+	    else if(opt.second == "greedy") { config.rollout = ROLLOUT_GREEDY; }
+	    else if(opt.second == "lut"   ) { config.rollout = ROLLOUT_LUT; }
+	    else { ASSERT(false, std::string("unknown MCTS rollout policy ") + opt.second); }
+	  }
+	  else if(opt.first == "parallel") {
+	    ASSERT(opt.second == "root" || opt.second == "tree",
+		   std::string("unknown MCTS parallelism ") + opt.second);
+	    config.treeParallel = (opt.second == "tree");
+	  }
+	  else { ASSERT(false, std::string("unknown MCTS setting ") + opt.first); }
+	}
+	ASSERT(config.numThreads > 0, "MCTS needs at least one thread");
+	ASSERT(config.iterations > 0 || config.timeBudgetMs > 0.0, "MCTS needs an iteration or time budget");
+	return config;
+      }
+    };
+
+    template<class BOARD>
+    class MCTSStrategy : public IThreesStgy<BOARD> {
+    public:
+      explicit MCTSStrategy(const MCTSConfig& config)
+	: m_config(config)
+	, m_trees(config.treeParallel ? 1 : config.numThreads)
+	, m_lastIterations(0)
+	{
+	  ASSERT(config.rollout != ROLLOUT_LUT || BOARD::dim == 4, "rollout=lut needs a 4x4 board");
+	}
+
+      static typename IThreesStgy<BOARD>::ThreesStgyPtr create(const std::string& args) {
+	return typename IThreesStgy<BOARD>::ThreesStgyPtr(
+	  new MCTSStrategy(MCTSConfig::fromStr(args)) );
+      }
+
+      virtual ShiftDirection move(const typename GameDriver<BOARD>::BoardPtr& boardPtr,
+				  const typename ICardSequence<BOARD>::ICardSeqPtr& seqPtr) override;
+
+      // playouts run for the last move, over every thread
+      uint64_t lastSearchIterations() const { return m_lastIterations; }
+
+    private:
+      static constexpr uint32_t NoNode = std::numeric_limits<uint32_t>::max();
+
+      // Player nodes have up to one chance child per move. Chance nodes
+      // keep their player children as a list through nextSibling, told
+      // apart by board hash.
+      struct Node {
+	uint64_t key;          // player nodes: board hash
+	double totalValue;
+	uint32_t visits;
+	uint32_t inFlight;     // threads on a path through here (tree parallel)
+	uint32_t nextSibling;
+	uint32_t firstOutcome; // chance nodes: first player child
+	std::array<uint32_t, NUM_DIRECTIONS> moves; // player nodes: chance children
+      };
+
+      struct Tree {
+	std::vector<Node> nodes; // nodes[0] is the root player node
+	double minValue;
+	double maxValue;
+      };
+
+      // per thread scratch, so a playout doesn't allocate
+      struct Worker {
+	Worker(const BOARD& board, const ICardSequence<BOARD>& seq, const uint64_t seed)
+	  : boardPtr(new BOARD(board))
+	  , seq(seq.clone())
+	  , rng(seed)
+	  {}
+	typename GameDriver<BOARD>::BoardPtr boardPtr;
+	typename ICardSequence<BOARD>::ICardSeqPtr seq;
+	RngContext rng;
+	std::vector<uint32_t> path;
+      };
+
+      static uint32_t newNode(Tree& tree, const uint64_t key) {
+	Node node;
+	node.key = key;
+	node.totalValue = 0.0;
+	node.visits = 0;
+	node.inFlight = 0;
+	node.nextSibling = NoNode;
+	node.firstOutcome = NoNode;
+	node.moves.fill(NoNode);
+	tree.nodes.push_back(node);
+	return tree.nodes.size() - 1;
+      }
+
+      static void resetTree(Tree& tree, const BOARD& board) {
+	tree.nodes.clear();
+	tree.minValue = std::numeric_limits<double>::infinity();
+	tree.maxValue = -std::numeric_limits<double>::infinity();
+	newNode(tree, hashBoard(board));
+      }
+
+      // game score of board, as a double for the value sums
+      static double boardScore(const BOARD& board) { return static_cast<double>(board.score()); }
+
+      // UCT pick among the moves of a player node whose moves are all expanded
+      ShiftDirection selectMove(const Tree& tree, const Node& node) const;
+
+      // walk down from the root, adding up to two nodes, and leave the path
+      // in worker.path and the leaf board in worker.boardPtr. Returns true
+      // if the leaf is a finished game (no rollout needed).
+      bool descend(Tree& tree, Worker& worker, const BOARD& rootBoard,
+		   const ICardSequence<BOARD>& rootSeq);
+
+      // play the rollout policy from worker's board, returns its value
+      double rollout(Worker& worker) const;
+      // moves are board's, NUM_DIRECTIONS if it has none
+      ShiftDirection rolloutMove(const BOARD& board, const MoveSet& moves, RngContext& rng) const;
+
+      void backup(Tree& tree, const std::vector<uint32_t>& path, const double value);
+
+    private:
+      const MCTSConfig m_config;
+      std::vector<Tree> m_trees;
+      std::mutex m_treeMutex; // tree parallel only
+      uint64_t m_lastIterations;
+    };
+
+
+    //////////////////////////////////////
+    // implementations
+    //////////////////////////////////////
+
+    template<class BOARD>
+    constexpr uint32_t MCTSStrategy<BOARD>::NoNode;
+
+    template<class BOARD>
+    ShiftDirection MCTSStrategy<BOARD>::selectMove(const Tree& tree, const Node& node) const {
+      const double range = tree.maxValue > tree.minValue ? tree.maxValue - tree.minValue : 1.0;
+      const double logVisits = std::log(static_cast<double>(node.visits + node.inFlight) + 1.0);
+
+      ShiftDirection best = NUM_DIRECTIONS;
+      double bestScore = -std::numeric_limits<double>::infinity();
+      for(unsigned dir = 0; dir < NUM_DIRECTIONS; ++dir) {
+	if(node.moves[dir] == NoNode) { continue; }
+	const Node& child = tree.nodes[node.moves[dir]];
+	// a thread in flight counts as a visit worth the worst value seen
+	const double visits = child.visits + child.inFlight;
+	const double mean = visits > 0 ?
+	  (child.totalValue - tree.minValue * child.visits) / (range * visits) : 0.0;
+	const double score = mean + m_config.exploration * std::sqrt(logVisits / std::max(visits, 1.0));
+	if(score > bestScore) {
+	  bestScore = score;
+	  best = static_cast<ShiftDirection>(dir);
+	}
+      }
+      return best;
+    }
+
+    template<class BOARD>
+    bool MCTSStrategy<BOARD>::descend(Tree& tree, Worker& worker, const BOARD& rootBoard,
+				      const ICardSequence<BOARD>& rootSeq) {
+      BOARD& board = *worker.boardPtr;
+      board = rootBoard;
+      worker.seq->assignFrom(rootSeq);
+      // the next card and the cards already dealt are known, only the draws
+      // after them are random, give each playout its own
+      worker.seq->reseed(worker.rng());
+      worker.path.clear();
+
+      uint32_t current = 0;
+      worker.path.push_back(current);
+      while(true) {
+	// player node: expand a move not tried yet, else UCT
+	ShiftDirection dir = NUM_DIRECTIONS;
+	const MoveSet moves = board.moves();
+	if(!moves.any()) { return true; }
+	for(auto candidate : {DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT}) {
+	  if( !moves.canShift(candidate) ) { continue; }
+	  if( tree.nodes[current].moves[candidate] == NoNode ) {
+	    dir = candidate;
+	    break;
+	  }
+	}
+
+	bool expanded = false;
+	if(dir != NUM_DIRECTIONS) {
+	  const uint32_t chance = newNode(tree, 0);
+	  tree.nodes[current].moves[dir] = chance;
+	  expanded = true;
+	} else {
+	  dir = selectMove(tree, tree.nodes[current]);
+	}
+	const uint32_t chance = tree.nodes[current].moves[dir];
+	worker.path.push_back(chance);
+
+	// chance node: play the move for real and find the board it gave
+	const Card card = worker.seq->draw(worker.boardPtr);
+	board.shiftBoard(moves, dir, card, worker.rng);
+	const uint64_t key = hashBoard(board);
+	uint32_t outcome = tree.nodes[chance].firstOutcome;
+	while(outcome != NoNode && tree.nodes[outcome].key != key) {
+	  outcome = tree.nodes[outcome].nextSibling;
+	}
+	if(outcome == NoNode) {
+	  outcome = newNode(tree, key);
+	  tree.nodes[outcome].nextSibling = tree.nodes[chance].firstOutcome;
+	  tree.nodes[chance].firstOutcome = outcome;
+	  expanded = true;
+	}
+	worker.path.push_back(outcome);
+	current = outcome;
+
+	if(expanded) { return false; }
+      }
+    }
+
+    template<class BOARD>
+    ShiftDirection MCTSStrategy<BOARD>::rolloutMove(const BOARD& board, const MoveSet& moves,
+						     RngContext& rng) const {
+      std::array<ShiftDirection, NUM_DIRECTIONS> valid;
+      unsigned numValid = 0;
+      for(auto dir : {DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT}) {
+	if(moves.canShift(dir)) { valid[numValid++] = dir; }
+      }
+      if(numValid == 0) { return NUM_DIRECTIONS; }
+      if(m_config.rollout == ROLLOUT_RANDOM || numValid == 1) {
+	return valid[rng.uniformInt(0, numValid-1)];
+      }
+
+      ShiftDirection best = valid[0];
+      double bestValue = -std::numeric_limits<double>::infinity();
+      for(unsigned i = 0; i < numValid; ++i) {
+	BOARD after(board);
+	after.shiftTiles(valid[i], moves.moved[valid[i]]);
+	const double value = (m_config.rollout == ROLLOUT_GREEDY) ?
+	  boardScore(after) : lineLookupValue(after);
+	if(value > bestValue) {
+	  bestValue = value;
+	  best = valid[i];
+	}
+      }
+      return best;
+    }
+
+    template<class BOARD>
+    double MCTSStrategy<BOARD>::rollout(Worker& worker) const {
+      BOARD& board = *worker.boardPtr;
+      for(unsigned moves = 0; m_config.rolloutDepth == 0 || moves < m_config.rolloutDepth; ++moves) {
+	const MoveSet legal = board.moves();
+	const ShiftDirection dir = rolloutMove(board, legal, worker.rng);
+	if(dir == NUM_DIRECTIONS) { break; }
+	const Card card = worker.seq->draw(worker.boardPtr);
+	board.shiftBoard(legal, dir, card, worker.rng);
+      }
+      return boardScore(board);
+    }
+
+    template<class BOARD>
+    void MCTSStrategy<BOARD>::backup(Tree& tree, const std::vector<uint32_t>& path, const double value) {
+      tree.minValue = std::min(tree.minValue, value);
+      tree.maxValue = std::max(tree.maxValue, value);
+      for(const uint32_t idx : path) {
+	Node& node = tree.nodes[idx];
+	++node.visits;
+	node.totalValue += value;
+      }
+    }
+
+    template<class BOARD>
+    ShiftDirection MCTSStrategy<BOARD>::move(const typename GameDriver<BOARD>::BoardPtr& boardPtr,
+					     const typename ICardSequence<BOARD>::ICardSeqPtr& seqPtr) {
+      const BOARD& rootBoard = *boardPtr;
+      m_lastIterations = 0;
+
+      // nothing to search with one move (or none, the game is over)
+      unsigned numValid = 0;
+      ShiftDirection onlyMove = DIRECTION_UP;
+      const MoveSet rootMoves = rootBoard.moves();
+      for(auto dir : {DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT}) {
+	if(rootMoves.canShift(dir)) {
+	  ++numValid;
+	  onlyMove = dir;
+	}
+      }
+      if(numValid <= 1) { return onlyMove; }
+
+      for(auto& tree : m_trees) {
+	resetTree(tree, rootBoard);
+      }
+
+      const auto deadline = std::chrono::steady_clock::now() +
+	std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	  std::chrono::duration<double, std::milli>(m_config.timeBudgetMs));
+      const uint64_t maxIterations = m_config.iterations > 0 ?
+	m_config.iterations : std::numeric_limits<uint64_t>::max();
+      auto outOfTime = [this, &deadline]() {
+	return m_config.timeBudgetMs > 0.0 && std::chrono::steady_clock::now() >= deadline;
+      };
+
+      // every thread's rng comes from the strategy's, so a single threaded
+      // or root parallel search with an iteration budget replays exactly
+      std::vector<uint64_t> seeds(m_config.numThreads);
+      for(auto& seed : seeds) { seed = this->m_rng(); }
+
+      std::vector<uint64_t> iterations(m_config.numThreads, 0);
+      auto rootWorker = [&](const unsigned t) {
+	Worker worker(rootBoard, *seqPtr, seeds[t]);
+	Tree& tree = m_trees[t];
+	// each root tree gets an even share of the iterations
+	const uint64_t share = maxIterations / m_config.numThreads +
+	  (t < maxIterations % m_config.numThreads ? 1 : 0);
+	while(iterations[t] < share && !outOfTime()) {
+	  const bool finished = descend(tree, worker, rootBoard, *seqPtr);
+	  backup(tree, worker.path, finished ? boardScore(*worker.boardPtr) : rollout(worker));
+	  ++iterations[t];
+	}
+      };
+
+      std::atomic<uint64_t> started(0);
+      auto treeWorker = [&](const unsigned t) {
+	Worker worker(rootBoard, *seqPtr, seeds[t]);
+	Tree& tree = m_trees[0];
+	while(started++ < maxIterations && !outOfTime()) {
+	  bool finished;
+	  {
+	    std::lock_guard<std::mutex> lock(m_treeMutex);
+	    finished = descend(tree, worker, rootBoard, *seqPtr);
+	    for(const uint32_t idx : worker.path) {
+	      tree.nodes[idx].inFlight += m_config.virtualLoss;
+	    }
+	  }
+	  const double value = finished ? boardScore(*worker.boardPtr) : rollout(worker);
+	  {
+	    std::lock_guard<std::mutex> lock(m_treeMutex);
+	    for(const uint32_t idx : worker.path) {
+	      tree.nodes[idx].inFlight -= m_config.virtualLoss;
+	    }
+	    backup(tree, worker.path, value);
+	  }
+	  ++iterations[t];
+	}
+      };
+
+      std::vector<std::thread> threads;
+      for(unsigned t = 1; t < m_config.numThreads; ++t) {
+	if(m_config.treeParallel) { threads.emplace_back(treeWorker, t); }
+	else                      { threads.emplace_back(rootWorker, t); }
+      }
+      if(m_config.treeParallel) { treeWorker(0); }
+      else                      { rootWorker(0); }
+      for(auto& thread : threads) {
+	thread.join();
+      }
+
+      for(const auto count : iterations) { m_lastIterations += count; }
+
+      // most visited move over every tree, ties to the better mean
+      std::array<double, NUM_DIRECTIONS> visits{};
+      std::array<double, NUM_DIRECTIONS> totals{};
+      for(const auto& tree : m_trees) {
+	const Node& root = tree.nodes[0];
+	for(unsigned dir = 0; dir < NUM_DIRECTIONS; ++dir) {
+	  if(root.moves[dir] == NoNode) { continue; }
+	  visits[dir] += tree.nodes[root.moves[dir]].visits;
+	  totals[dir] += tree.nodes[root.moves[dir]].totalValue;
+	}
+      }
+      ShiftDirection best = DIRECTION_UP;
+      bool found = false;
+      for(auto dir : {DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT}) {
+	if( !rootMoves.canShift(dir) ) { continue; }
+	const bool better = !found || visits[dir] > visits[best] ||
+	  (visits[dir] == visits[best] && totals[dir] > totals[best]);
+	if(better) {
+	  best = dir;
+	  found = true;
+	}
+      }
+      return best;
+    }
+
+  } // ns game
+} // ns threes
@@ -0,0 +1,132 @@
+#include "NTupleNetwork.h"
+
+#include "Card.h"
+#include "Utils.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+  static constexpr char NTupleMagic[4] = { 'T', 'H', 'N', 'T' };
+  static constexpr uint32_t NTupleFormatVersion = 1;
+
+  // tile (row, col) under each of the eight symmetries of the square
+  unsigned symmetricTile(const unsigned tile, const unsigned symmetry) {
+    const unsigned r = tile / 4, c = tile % 4;
+    unsigned row = r, col = c;
+    switch(symmetry) {
+    case 0: row = r;   col = c;   break;
+    case 1: row = c;   col = r;   break;
+    case 2: row = r;   col = 3-c; break;
+    case 3: row = 3-r; col = c;   break;
+    case 4: row = 3-r; col = 3-c; break;
+    case 5: row = c;   col = 3-r; break;
+    case 6: row = 3-c; col = r;   break;
+    case 7: row = 3-c; col = 3-r; break;
+    }
+    return col + 4*row;
+  }
+
+  void writeU32(std::ostream& out, const uint32_t value) {
+    const char bytes[4] = { static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF),
+			    static_cast<char>((value >> 16) & 0xFF), static_cast<char>((value >> 24) & 0xFF) };
+    out.write(bytes, 4);
+  }
+
+  uint32_t readU32(std::istream& in) {
+    unsigned char bytes[4] = { 0, 0, 0, 0 };
+    in.read(reinterpret_cast<char*>(bytes), 4);
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+      (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+} // anon ns
+
+threes::game::NTupleNetwork::NTupleNetwork(const std::vector<Pattern>& patterns)
+  : m_patterns(patterns)
+{
+  size_t offset = 0;
+  for(const auto& pattern : m_patterns) {
+    ASSERT( !pattern.empty() && pattern.size() <= MaxPatternSize, "bad n-tuple pattern size" );
+    for(unsigned symmetry = 0; symmetry < NumSymmetries; ++symmetry) {
+      Tuple tuple;
+      tuple.size = pattern.size();
+      tuple.offset = offset;
+      for(unsigned i = 0; i < pattern.size(); ++i) {
+	ASSERT( pattern[i] < 16, "n-tuple pattern tile off the board" );
+	tuple.tiles[i] = symmetricTile(pattern[i], symmetry);
+      }
+      m_tuples.push_back(tuple);
+    }
+    offset += size_t(1) << (4*pattern.size());
+  }
+  m_weights.assign(offset, 0.0f);
+}
+
+std::vector<threes::game::NTupleNetwork::Pattern> threes::game::NTupleNetwork::defaultPatterns() {
+  return std::vector<Pattern>{
+    { 0, 1, 2, 3 },
+    { 4, 5, 6, 7 },
+    { 0, 1, 4, 5 },
+    { 1, 2, 5, 6 },
+    { 5, 6, 9, 10 } };
+}
+
+bool threes::game::NTupleNetwork::save(const std::string& path) const {
+  std::ofstream out(path, std::ios::binary);
+  if(!out.good()) { return false; }
+
+  out.write(NTupleMagic, sizeof(NTupleMagic));
+  writeU32(out, NTupleFormatVersion);
+  writeU32(out, m_patterns.size());
+  for(const auto& pattern : m_patterns) {
+    writeU32(out, pattern.size());
+    out.write(reinterpret_cast<const char*>(pattern.data()), pattern.size());
+  }
+  for(const float weight : m_weights) {
+    uint32_t bits;
+    std::memcpy(&bits, &weight, sizeof(bits));
+    writeU32(out, bits);
+  }
+  return out.good();
+}
+
+threes::game::NTupleNetwork::NTupleNetworkPtr
+threes::game::NTupleNetwork::load(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(NTupleMagic)];
+  in.read(magic, sizeof(magic));
+  if(!in.good() || std::memcmp(magic, NTupleMagic, sizeof(magic)) != 0) { return nullptr; }
+  if(readU32(in) != NTupleFormatVersion) { return nullptr; }
+
+  const uint32_t numPatterns = readU32(in);
+  std::vector<Pattern> patterns;
+  for(uint32_t i = 0; i < numPatterns && in.good(); ++i) {
+    const uint32_t size = readU32(in);
+    if(size == 0 || size > MaxPatternSize) { return nullptr; }
+    Pattern pattern(size);
+    in.read(reinterpret_cast<char*>(pattern.data()), size);
+    for(const auto tile : pattern) {
+      if(tile >= 16) { return nullptr; }
+    }
+    patterns.push_back(pattern);
+  }
+  if(!in.good()) { return nullptr; }
+
+  NTupleNetworkPtr result(new NTupleNetwork(patterns));
+  for(float& weight : result->m_weights) {
+    const uint32_t bits = readU32(in);
+    std::memcpy(&weight, &bits, sizeof(weight));
+  }
+  if(!in.good()) { return nullptr; }
+  return result;
+}
+
+uint64_t threes::game::packedScore(const uint64_t packed) {
+  uint64_t result = 0;
+  for(unsigned i = 0; i < 16; ++i) {
+    result += S_RANK_SCORES[(packed >> (4*i)) & 0xF];
+  }
+  return result;
+}
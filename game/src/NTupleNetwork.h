@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+ * N-tuple network value function for 4x4 boards. Each pattern is a few
+ * tile positions; the card ranks on those tiles index a table of weights,
+ * and a board's value is the sum of the looked up weights. Every pattern is
+ * applied under all eight rotations/reflections of the board, sharing one
+ * table, so the value is the same for symmetric boards.
+ *
+ * Boards are read as packed 4 bit ranks (PackedBoard4 layout, see
+ * packedTiles in LineEvaluator.h).
+ *
+ * Saved networks are a small binary file: "THNT", a format version, the
+ * patterns, then every table's weights as 32 bit floats, all little endian.
+ */
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    class NTupleNetwork {
+    public:
+      using Pattern = std::vector<uint8_t>; // tile indices, col + 4*row
+      using NTupleNetworkPtr = std::unique_ptr<NTupleNetwork>;
+
+      static constexpr unsigned NumSymmetries = 8;
+      // 16^6 weights per table is 64MB, beyond that is impractical
+      static constexpr unsigned MaxPatternSize = 6;
+
+      explicit NTupleNetwork(const std::vector<Pattern>& patterns = defaultPatterns());
+
+      // the two outer/inner rows and three 2x2 squares, which with the
+      // symmetries cover every row, column and square of the board
+      static std::vector<Pattern> defaultPatterns();
+
+      // value of a packed 4x4 board
+      float value(const uint64_t packed) const {
+	float result = 0.0f;
+	for(const auto& tuple : m_tuples) {
+	  result += m_weights[tuple.offset + tupleIndex(packed, tuple)];
+	}
+	return result;
+      }
+
+      // add delta to every weight value(packed) reads
+      void update(const uint64_t packed, const float delta) {
+	for(const auto& tuple : m_tuples) {
+	  m_weights[tuple.offset + tupleIndex(packed, tuple)] += delta;
+	}
+      }
+
+      // weights read per value(), i.e. patterns times symmetries
+      unsigned numLookups() const { return m_tuples.size(); }
+
+      const std::vector<Pattern>& patterns() const { return m_patterns; }
+
+      // every table back to back, in pattern order
+      std::vector<float>& weights() { return m_weights; }
+      const std::vector<float>& weights() const { return m_weights; }
+
+      // returns false if the file couldn't be written
+      bool save(const std::string& path) const;
+      // nullptr if the file is missing or not a network
+      static NTupleNetworkPtr load(const std::string& path);
+
+    private:
+      struct Tuple {
+	std::array<uint8_t, MaxPatternSize> tiles; // pattern under one symmetry
+	uint8_t size;
+	size_t offset; // start of the pattern's table in m_weights
+      };
+
+      static size_t tupleIndex(const uint64_t packed, const Tuple& tuple) {
+	size_t index = 0;
+	for(unsigned i = 0; i < tuple.size; ++i) {
+	  index |= static_cast<size_t>((packed >> (4*tuple.tiles[i])) & 0xF) << (4*i);
+	}
+	return index;
+      }
+
+    private:
+      std::vector<Pattern> m_patterns;
+      std::vector<Tuple> m_tuples;
+      std::vector<float> m_weights;
+    };
+
+    // game score (sum of standardCardScore) of a packed 4x4 board
+    uint64_t packedScore(const uint64_t packed);
+
+  } // namespace game
+} // namespace threes
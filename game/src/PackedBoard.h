@@ -0,0 +1,372 @@
+#pragma once
+
+/*
+ * 4x4 board state packed in to a single 64 bit word.
+ * Each tile is stored as a 4 bit card rank (see cardRank), tile (row,col)
+ * lives in bits [4*(col + 4*row), 4*(col + 4*row) + 4).
+ *
+ * Exposes the same playing interface as Board<4> so it can be dropped in to
+ * GameDriver/GameDriverStgy/ExpectiMaxTree, and converts to and from Board<4>.
+ * Shifts are driven by the precomputed line transitions in RowTable.h.
+ */
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <iostream>
+#include <iomanip>
+
+#include "Utils.h"
+#include "Card.h"
+#include "Board.h"
+#include "RowTable.h"
+
+namespace threes {
+  namespace game {
+
+    template<class RAND_GEN=std::uniform_int_distribution<> >
+    class PackedBoard4 {
+
+    public:
+      using packed_t = uint64_t;
+      using storage_t = std::array<Card,16>;
+      static constexpr unsigned dim = 4;
+      static constexpr unsigned StateSize = sizeof(packed_t);
+
+    public:
+      // same semantics as the Board<DIM> constructor
+      PackedBoard4(const std::vector<Card>& initialCards,
+		   const std::vector<unsigned>& insertLocations = std::vector<unsigned>(0) );
+
+      explicit PackedBoard4(const packed_t packed)
+	: m_packed(packed)
+	{}
+
+      // conversions to/from the unpacked board
+      template<class OTHER_RAND_GEN>
+      static PackedBoard4 fromBoard(const Board<4, OTHER_RAND_GEN>& board);
+
+      template<class OTHER_RAND_GEN=RAND_GEN>
+      Board<4, OTHER_RAND_GEN> toBoard() const {
+	return Board<4, OTHER_RAND_GEN>(underlyingDataRef());
+      }
+
+      // const access to underlying data
+    public:
+      packed_t packed() const { return m_packed; }
+
+      // unpacked copy, the name matches Board so generic code works on both
+      storage_t underlyingDataRef() const {
+	storage_t result;
+	for(unsigned i=0; i < dim*dim; ++i) {
+	  result[i] = cardFromRank(rankAtIndex(i));
+	}
+	return result;
+      }
+
+      // writes PackedBoard4::StateSize bytes, returns num bytes written
+      unsigned write_binary(std::ostream& out) const {
+	if(!out.good()) { return 0; }
+	out.write( reinterpret_cast<const char*>(&m_packed), sizeof(m_packed) );
+	return StateSize;
+      }
+
+      Card cardAtIndex(const unsigned row, const unsigned col) const {
+	return cardFromRank(rankAtIndex(col + row*dim));
+      }
+
+      bool operator==(const PackedBoard4& other) const { return m_packed == other.m_packed; }
+      bool operator!=(const PackedBoard4& other) const { return m_packed != other.m_packed; }
+
+    public:
+      void print() const {
+	static constexpr unsigned CardValuePrintWidth = 6;
+
+	for(unsigned row = 0; row < dim; ++row) {
+	  for(unsigned col = 0; col < dim; ++col) {
+	    std::cout << std::setw(CardValuePrintWidth) <<
+	      this->cardAtIndex( row, col ).value;
+	  }
+	  std::cout << std::endl << std::endl;
+	}
+      }
+
+      // utilites for actually playing the game
+    public:
+      bool canShift(const ShiftDirection dir) const;
+      // every direction at once, see Board<DIM>::moves
+      MoveSet moves() const;
+
+      // derived from the tiles, there is no room to cache it
+      Card maxCard() const;
+
+      // same value function features as Board<DIM>, also derived from the
+      // tiles on every call
+      unsigned numEmpty() const { return dim*dim - countTiles(occupiedMask()); }
+      tile_mask_t occupiedMask() const;
+      tile_mask_t rankMask(const unsigned rank) const;
+      std::array<unsigned, 3> topThreeValues() const;
+      int lineScores() const;
+
+      // the game score, also derived from the tiles
+      uint64_t score() const {
+	uint64_t result = 0;
+	for(unsigned i=0; i < dim*dim; ++i) { result += S_RANK_SCORES[rankAtIndex(i)]; }
+	return result;
+      }
+
+      void shiftBoard(const ShiftDirection dir, const Card insertVal, RngContext& rng);
+      void shiftBoard(const ShiftDirection dir, const Card insertVal) {
+	shiftBoard(dir, insertVal, defaultRngContext());
+      }
+      // the table shift is the same work whichever lines move, so moves
+      // only saves the legality check here
+      void shiftBoard(const MoveSet& moves, const ShiftDirection dir, const Card insertVal,
+		      RngContext& rng) {
+	(void)moves; // only read by ASSERT
+	ASSERT( moves.canShift(dir), "requested a shift but board can't shift that way" );
+	shiftBoard(dir, insertVal, rng);
+      }
+
+      // same deterministic steps as Board<DIM>, see there
+      unsigned shiftTiles(const ShiftDirection dir);
+      void shiftTiles(const ShiftDirection dir, const unsigned movedMask) {
+	(void)movedMask;
+	shiftTiles(dir);
+      }
+      unsigned insertCandidates(const ShiftDirection dir, const unsigned movedMask) const;
+      void insertCard(const ShiftDirection dir, const unsigned slice, const Card insertVal);
+
+    private:
+      unsigned rankAtIndex(const unsigned idx) const {
+	return static_cast<unsigned>( (m_packed >> (4*idx)) & 0xFull );
+      }
+
+      void setRankAtIndex(const unsigned idx, const unsigned rank) {
+	const packed_t mask = 0xFull << (4*idx);
+	m_packed = (m_packed & ~mask) | (static_cast<packed_t>(rank) << (4*idx));
+      }
+
+      // bitmask of the lines (slice i <=> bit i, same slice numbering as
+      // Board<DIM>) that move when shifting in dir, plus the shifted board
+      // without any card inserted
+      unsigned shiftLines(const ShiftDirection dir, packed_t& shifted) const;
+
+    private:
+      packed_t m_packed;
+
+    }; // class PackedBoard4
+
+
+    ///////////////////////////////////////////////
+    // Template Implementations
+    ///////////////////////////////////////////////
+
+    template<class RAND_GEN>
+    PackedBoard4<RAND_GEN>::PackedBoard4(const std::vector<Card>& initialCards,
+					 const std::vector<unsigned>& insertLocations)
+      : m_packed(0)
+    {
+      const unsigned numStartCards = initialCards.size();
+      ASSERT( numStartCards < (dim*dim),
+	      "can't start with more cards than spaces on the board" );
+
+      std::vector<unsigned> insertIndices(insertLocations);
+      if( insertIndices.size() == 0) {
+	insertIndices = pickNRandomIndicies(numStartCards, dim);
+      }
+      ASSERT( insertIndices.size() == initialCards.size(),
+	      "num insert locations != num insert cards!" );
+
+      for(unsigned i=0; i < numStartCards; ++i) {
+	setRankAtIndex(insertIndices[i], cardRank(initialCards[i]));
+      }
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    template<class OTHER_RAND_GEN>
+    PackedBoard4<RAND_GEN> PackedBoard4<RAND_GEN>::fromBoard(const Board<4, OTHER_RAND_GEN>& board) {
+      PackedBoard4 result(0);
+      const auto& data = board.underlyingDataRef();
+      for(unsigned i=0; i < dim*dim; ++i) {
+	const unsigned rank = cardRank(data[i]);
+	ASSERT(rank <= S_MAX_CARD_RANK, "card too large to pack in to 4 bits");
+	result.setRankAtIndex(i, rank);
+      }
+      return result;
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    Card PackedBoard4<RAND_GEN>::maxCard() const {
+      const RowTables& tables = rowTables();
+      unsigned maxRank = 0;
+      for(unsigned i=0; i < dim; ++i) {
+	maxRank = std::max<unsigned>(maxRank, tables.maxRank[(m_packed >> (16*i)) & 0xFFFF]);
+      }
+      return cardFromRank(maxRank);
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    tile_mask_t PackedBoard4<RAND_GEN>::occupiedMask() const {
+      tile_mask_t result = 0;
+      for(unsigned i=0; i < dim*dim; ++i) {
+	if(rankAtIndex(i)) { result |= tile_mask_t(1) << i; }
+      }
+      return result;
+    }
+
+    template<class RAND_GEN>
+    tile_mask_t PackedBoard4<RAND_GEN>::rankMask(const unsigned rank) const {
+      tile_mask_t result = 0;
+      for(unsigned i=0; i < dim*dim; ++i) {
+	if(rankAtIndex(i) == rank) { result |= tile_mask_t(1) << i; }
+      }
+      return result;
+    }
+
+    template<class RAND_GEN>
+    std::array<unsigned, 3> PackedBoard4<RAND_GEN>::topThreeValues() const {
+      unsigned rankPresent = 0;
+      for(unsigned i=0; i < dim*dim; ++i) {
+	rankPresent |= 1u << rankAtIndex(i);
+      }
+      return topThreeFromRanks(rankPresent);
+    }
+
+    template<class RAND_GEN>
+    int PackedBoard4<RAND_GEN>::lineScores() const {
+      const storage_t data(underlyingDataRef());
+      int score = 0;
+      for(unsigned i=0; i < dim; ++i) {
+	score += lineFeatureScore<dim>(data, dim*i, 1);
+	score += lineFeatureScore<dim>(data, i, dim);
+      }
+      return score;
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    unsigned PackedBoard4<RAND_GEN>::shiftLines(const ShiftDirection dir, packed_t& shifted) const {
+      // columns are handled as the rows of the transposed board
+      const bool isVertical = (dir == DIRECTION_UP || dir == DIRECTION_DOWN);
+      const bool towardLow  = (dir == DIRECTION_UP || dir == DIRECTION_LEFT);
+      const packed_t lines = isVertical ? transposePacked(m_packed) : m_packed;
+      const RowTables& tables = rowTables();
+      const auto& table = towardLow ? tables.towardLow : tables.towardHigh;
+
+      unsigned movedMask = 0;
+      packed_t result = 0;
+      for(unsigned i=0; i < dim; ++i) {
+	const RowShiftEntry& entry = table[(lines >> (16*i)) & 0xFFFF];
+	result |= static_cast<packed_t>(entry.shifted) << (16*i);
+	movedMask |= (entry.moved ? 1u : 0u) << i;
+      }
+
+      shifted = isVertical ? transposePacked(result) : result;
+      return movedMask;
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    bool PackedBoard4<RAND_GEN>::canShift(const ShiftDirection dir) const {
+      packed_t unused;
+      return shiftLines(dir, unused) != 0;
+    }
+
+    // both tables for each row and each row of the transpose, without
+    // building the shifted boards
+    template<class RAND_GEN>
+    MoveSet PackedBoard4<RAND_GEN>::moves() const {
+      const RowTables& tables = rowTables();
+      const packed_t transposed = transposePacked(m_packed);
+
+      MoveSet result;
+      for(unsigned i=0; i < dim; ++i) {
+	const unsigned row = (m_packed >> (16*i)) & 0xFFFF;
+	const unsigned col = (transposed >> (16*i)) & 0xFFFF;
+	result.moved[DIRECTION_LEFT]  |= (tables.towardLow[row].moved  ? 1u : 0u) << i;
+	result.moved[DIRECTION_RIGHT] |= (tables.towardHigh[row].moved ? 1u : 0u) << i;
+	result.moved[DIRECTION_UP]    |= (tables.towardLow[col].moved  ? 1u : 0u) << i;
+	result.moved[DIRECTION_DOWN]  |= (tables.towardHigh[col].moved ? 1u : 0u) << i;
+      }
+      for(unsigned dir = 0; dir < NUM_DIRECTIONS; ++dir) {
+	result.legal |= (result.moved[dir] ? 1u : 0u) << dir;
+      }
+      return result;
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    void PackedBoard4<RAND_GEN>::shiftBoard(const ShiftDirection dir, const Card insertVal,
+					    RngContext& rng) {
+      const unsigned candidates = insertCandidates(dir, shiftTiles(dir));
+
+      std::array<unsigned, dim> validShiftIdx;
+      unsigned numValid = 0;
+      for(unsigned i=0; i<dim; ++i) {
+	if( candidates & (1u << i) ) { validShiftIdx[numValid++] = i; }
+      }
+
+      unsigned insertSlice = 0;
+      if(numValid > 1) {
+	RAND_GEN insertSliceGen = RAND_GEN(0, numValid-1);
+	insertSlice = insertSliceGen(rng);
+      }
+      insertCard(dir, validShiftIdx[insertSlice], insertVal);
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    unsigned PackedBoard4<RAND_GEN>::shiftTiles(const ShiftDirection dir) {
+      packed_t shifted;
+      const unsigned movedMask = shiftLines(dir, shifted);
+      ASSERT( movedMask != 0, "requested a shift but board can't shift that way" );
+      m_packed = shifted;
+      return movedMask;
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    unsigned PackedBoard4<RAND_GEN>::insertCandidates(const ShiftDirection dir,
+						      const unsigned movedMask) const {
+      // Board<DIM> never updates its previous insert direction/index from
+      // their initial UP/0, so its "insert in the same slice again" rule only
+      // ever fires for DIRECTION_UP in to slice 0. Mirror that exactly so both
+      // boards play identical games.
+      if( dir == DIRECTION_UP && (movedMask & 1u) ) {
+	return 1u;
+      }
+      return movedMask;
+    }
+
+    /////////////////////
+
+    template<class RAND_GEN>
+    void PackedBoard4<RAND_GEN>::insertCard(const ShiftDirection dir, const unsigned slice,
+					    const Card insertVal) {
+      unsigned arrayIdxInsert = 0;
+      switch(dir) {
+      case DIRECTION_UP:    arrayIdxInsert = dim*dim - dim + slice; break;
+      case DIRECTION_DOWN:  arrayIdxInsert = slice;                 break;
+      case DIRECTION_RIGHT: arrayIdxInsert = dim*slice;             break;
+      case DIRECTION_LEFT:  arrayIdxInsert = (dim-1) + dim*slice;   break;
+      default: ASSERT(false, "invalid insertion dir");
+      }
+
+      ASSERT(rankAtIndex(arrayIdxInsert) == 0, "trying to insert at already occupied slot");
+      setRankAtIndex(arrayIdxInsert, cardRank(insertVal));
+    }
+
+  } // namespace game
+} // namespace threes
@@ -0,0 +1,179 @@
+#include "ReplayArchive.h"
+
+#include <cstring>
+
+namespace {
+
+  void writeU32(std::ostream& out, const uint32_t value) {
+    const char bytes[4] = { static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF),
+			    static_cast<char>((value >> 16) & 0xFF), static_cast<char>((value >> 24) & 0xFF) };
+    out.write(bytes, 4);
+  }
+
+  void writeU64(std::ostream& out, const uint64_t value) {
+    writeU32(out, static_cast<uint32_t>(value));
+    writeU32(out, static_cast<uint32_t>(value >> 32));
+  }
+
+  uint32_t readU32(const unsigned char* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+      (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  }
+
+  uint64_t readU64(const unsigned char* bytes) {
+    return static_cast<uint64_t>(readU32(bytes)) | (static_cast<uint64_t>(readU32(bytes + 4)) << 32);
+  }
+
+  // seed and move count ahead of every game's moves
+  static constexpr size_t GameHeaderSize = 12;
+
+} // anon ns
+
+namespace threes {
+  namespace game {
+
+    constexpr char ReplayArchiveHeader::Magic[4];
+    constexpr uint32_t ReplayArchiveHeader::FormatVersion;
+    constexpr unsigned ReplayArchiveHeader::TrailerSize;
+
+    ReplayArchiveWriter::ReplayArchiveWriter(const std::string& path, const unsigned dim,
+					     const std::string& seqName, const std::string& seqArgs,
+					     const unsigned numStartCards)
+      : m_out(path, std::ios::binary | std::ios::trunc)
+      , m_offset(0)
+      , m_closed(false)
+    {
+      m_out.write(ReplayArchiveHeader::Magic, sizeof(ReplayArchiveHeader::Magic));
+      writeU32(m_out, ReplayArchiveHeader::FormatVersion);
+      writeU32(m_out, dim);
+      writeU32(m_out, numStartCards);
+      writeU32(m_out, seqName.size());
+      m_out.write(seqName.data(), seqName.size());
+      writeU32(m_out, seqArgs.size());
+      m_out.write(seqArgs.data(), seqArgs.size());
+      m_offset = sizeof(ReplayArchiveHeader::Magic) + 5*sizeof(uint32_t) + seqName.size() + seqArgs.size();
+    }
+
+    ReplayArchiveWriter::~ReplayArchiveWriter() {
+      close();
+    }
+
+    void ReplayArchiveWriter::appendGame(const uint64_t seed, const std::vector<ShiftDirection>& moves) {
+      // encode outside the lock, only the write is serialized
+      std::vector<char> encoded(GameHeaderSize + (moves.size() + 3) / 4, 0);
+      for(unsigned i = 0; i < 8; ++i) {
+	encoded[i] = static_cast<char>((seed >> (8*i)) & 0xFF);
+      }
+      const uint32_t numMoves = moves.size();
+      for(unsigned i = 0; i < 4; ++i) {
+	encoded[8 + i] = static_cast<char>((numMoves >> (8*i)) & 0xFF);
+      }
+      for(size_t i = 0; i < moves.size(); ++i) {
+	ASSERT(moves[i] < NUM_DIRECTIONS, "only real moves can be archived");
+	encoded[GameHeaderSize + i/4] |= static_cast<char>(moves[i] << (2*(i % 4)));
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ASSERT(!m_closed, "archive already closed");
+      m_offsets.push_back(m_offset);
+      m_out.write(encoded.data(), encoded.size());
+      m_offset += encoded.size();
+    }
+
+    void ReplayArchiveWriter::close() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_closed) { return; }
+      const uint64_t indexOffset = m_offset;
+      for(const uint64_t offset : m_offsets) {
+	writeU64(m_out, offset);
+      }
+      writeU64(m_out, indexOffset);
+      writeU64(m_out, m_offsets.size());
+      m_out.flush();
+      m_closed = true;
+    }
+
+    ////////////////////
+
+    ReplayArchiveReader::ReplayArchiveReaderPtr ReplayArchiveReader::open(const std::string& path) {
+      ReplayArchiveReaderPtr result(new ReplayArchiveReader());
+      result->m_file = MappedFile::open(path);
+      if(!result->m_file) { return nullptr; }
+      const unsigned char* data = result->m_file->data();
+      const size_t size = result->m_file->size();
+
+      // fixed part of the header, then the two strings
+      size_t pos = sizeof(ReplayArchiveHeader::Magic) + 3*sizeof(uint32_t);
+      if(size < pos + ReplayArchiveHeader::TrailerSize) { return nullptr; }
+      if(std::memcmp(data, ReplayArchiveHeader::Magic, sizeof(ReplayArchiveHeader::Magic)) != 0) { return nullptr; }
+      if(readU32(data + 4) != ReplayArchiveHeader::FormatVersion) { return nullptr; }
+      result->m_dim = readU32(data + 8);
+      result->m_numStartCards = readU32(data + 12);
+      for(std::string* str : { &result->m_seqName, &result->m_seqArgs }) {
+	if(pos + sizeof(uint32_t) > size) { return nullptr; }
+	const uint32_t length = readU32(data + pos);
+	pos += sizeof(uint32_t);
+	if(pos + length > size) { return nullptr; }
+	str->assign(reinterpret_cast<const char*>(data + pos), length);
+	pos += length;
+      }
+      const size_t gamesStart = pos;
+      if(size < gamesStart + ReplayArchiveHeader::TrailerSize) { return nullptr; }
+
+      const unsigned char* trailer = data + size - ReplayArchiveHeader::TrailerSize;
+      result->m_indexOffset = readU64(trailer);
+      result->m_numGames = readU64(trailer + 8);
+      // both come from the file, so check them without sums that could wrap
+      const size_t indexEnd = size - ReplayArchiveHeader::TrailerSize;
+      if(result->m_indexOffset < gamesStart || result->m_indexOffset > indexEnd ||
+	 result->m_numGames != (indexEnd - result->m_indexOffset) / 8 ||
+	 (indexEnd - result->m_indexOffset) % 8 != 0) {
+	return nullptr;
+      }
+      result->m_index = data + result->m_indexOffset;
+
+      // every game's header and moves lie between the header and the
+      // index, so the accessors can trust the offsets and move counts
+      for(size_t game = 0; game < result->m_numGames; ++game) {
+	const uint64_t offset = readU64(result->m_index + 8*game);
+	if(offset < gamesStart || offset > result->m_indexOffset - GameHeaderSize) { return nullptr; }
+	const uint64_t movesSize = (uint64_t(readU32(data + offset + 8)) + 3) / 4;
+	if(movesSize > result->m_indexOffset - GameHeaderSize - offset) { return nullptr; }
+      }
+      return result;
+    }
+
+    const unsigned char* ReplayArchiveReader::gameData(const size_t game) const {
+      ASSERT(game < m_numGames, "no such game in the archive");
+      const uint64_t offset = readU64(m_index + 8*game);
+      ASSERT(offset + GameHeaderSize + (uint64_t(readU32(m_file->data() + offset + 8)) + 3) / 4 <= m_indexOffset,
+	     "corrupt archive index");
+      return m_file->data() + offset;
+    }
+
+    uint64_t ReplayArchiveReader::gameSeed(const size_t game) const {
+      return readU64(gameData(game));
+    }
+
+    uint32_t ReplayArchiveReader::numMoves(const size_t game) const {
+      return readU32(gameData(game) + 8);
+    }
+
+    ShiftDirection ReplayArchiveReader::move(const size_t game, const uint32_t moveIdx) const {
+      ASSERT(moveIdx < numMoves(game), "no such move in the game");
+      const unsigned char* moves = gameData(game) + GameHeaderSize;
+      return static_cast<ShiftDirection>((moves[moveIdx/4] >> (2*(moveIdx % 4))) & 0x3);
+    }
+
+    std::vector<ShiftDirection> ReplayArchiveReader::moves(const size_t game) const {
+      const unsigned char* data = gameData(game);
+      const uint32_t numMoves = readU32(data + 8);
+      std::vector<ShiftDirection> result(numMoves);
+      for(uint32_t i = 0; i < numMoves; ++i) {
+	result[i] = static_cast<ShiftDirection>((data[GameHeaderSize + i/4] >> (2*(i % 4))) & 0x3);
+      }
+      return result;
+    }
+
+  } // namespace game
+} // namespace threes
@@ -0,0 +1,165 @@
+#pragma once
+
+/*
+ * Compact archive of whole games, each stored as the seed it was played
+ * with and its moves at 2 bits apiece. Everything else about a game
+ * (cards drawn, insertion slots, every position) follows from replaying
+ * those moves through a GameDriver built with the same seed, card
+ * sequence and number of start cards, which the archive header records.
+ *
+ * Layout, all little endian:
+ *   header:  "THRA", format version (u32), board dim (u32),
+ *            start cards (u32), sequence name and args (u32 length + bytes each)
+ *   games:   seed (u64), number of moves (u32), moves four to a byte,
+ *            first move in the low bits
+ *   index:   byte offset of every game (u64 each)
+ *   trailer: index offset (u64), number of games (u64)
+ *
+ * Archives are written by GameDriverStgy (see setArchive) and replay
+ * its games. Only moves that changed the board are stored; invalid moves don't touch
+ * the game's random streams, so they don't affect the replay.
+ */
+
+#include "Board.h"
+#include "GameDriver.h"
+#include "GameRecord.h"
+#include "Utils.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    struct ReplayArchiveHeader {
+      static constexpr char Magic[4] = { 'T', 'H', 'R', 'A' };
+      static constexpr uint32_t FormatVersion = 1;
+      static constexpr unsigned TrailerSize = 16;
+    };
+
+    // Appends games to an archive. appendGame is safe to call from several
+    // threads, the index and trailer are written by close() (or the
+    // destructor).
+    class ReplayArchiveWriter {
+    public:
+      // truncates path and writes the header, check good() afterwards
+      ReplayArchiveWriter(const std::string& path, const unsigned dim,
+			  const std::string& seqName, const std::string& seqArgs,
+			  const unsigned numStartCards);
+      ~ReplayArchiveWriter();
+
+      ReplayArchiveWriter(const ReplayArchiveWriter&) = delete;
+      ReplayArchiveWriter& operator=(const ReplayArchiveWriter&) = delete;
+
+      void appendGame(const uint64_t seed, const std::vector<ShiftDirection>& moves);
+      void close();
+
+      bool good() const { return m_out.good(); }
+      uint64_t numGames() const { return m_offsets.size(); }
+
+    private:
+      std::ofstream m_out;
+      uint64_t m_offset; // bytes written so far
+      std::vector<uint64_t> m_offsets;
+      bool m_closed;
+      std::mutex m_mutex;
+    };
+
+    // Random access to the games in an archive, read in place from a
+    // memory mapped file
+    class ReplayArchiveReader {
+    public:
+      using ReplayArchiveReaderPtr = std::unique_ptr<ReplayArchiveReader>;
+
+      // nullptr if the file is missing, not an archive or wasn't closed
+      static ReplayArchiveReaderPtr open(const std::string& path);
+
+      unsigned dim() const { return m_dim; }
+      unsigned numStartCards() const { return m_numStartCards; }
+      const std::string& seqName() const { return m_seqName; }
+      const std::string& seqArgs() const { return m_seqArgs; }
+
+      size_t numGames() const { return m_numGames; }
+      uint64_t gameSeed(const size_t game) const;
+      uint32_t numMoves(const size_t game) const;
+      ShiftDirection move(const size_t game, const uint32_t moveIdx) const;
+      std::vector<ShiftDirection> moves(const size_t game) const;
+
+    private:
+      ReplayArchiveReader() = default;
+
+      const unsigned char* gameData(const size_t game) const;
+
+    private:
+      MappedFile::MappedFilePtr m_file;
+      unsigned m_dim = 0;
+      unsigned m_numStartCards = 0;
+      std::string m_seqName;
+      std::string m_seqArgs;
+      const unsigned char* m_index = nullptr;
+      size_t m_numGames = 0;
+      uint64_t m_indexOffset = 0;
+    };
+
+    // Replays one archived game. Needs the archive's card sequence
+    // registered with ICardSequence<BOARD>::s_factory.
+    template<class BOARD>
+    class GameDriverReplay : public GameDriver<BOARD> {
+    public:
+      GameDriverReplay(const ReplayArchiveReader& archive, const size_t game)
+	: GameDriver<BOARD>(archive.seqName(), archive.seqArgs(), archive.numStartCards(),
+			    archive.gameSeed(game))
+	, m_archive(archive)
+	, m_game(game)
+	, m_numMoves(archive.numMoves(game))
+	, m_nextMove(0)
+	{
+	  ASSERT(archive.dim() == BOARD::dim, "archive was recorded on a different board size");
+	  // GameDriverStgy seeds its strategy from the game stream, skip that
+	  // draw too so insertions line up
+	  this->m_rng.split();
+	}
+
+      // plays the rest of the game, returns the final score
+      virtual uint64_t play() override {
+	seek(m_numMoves);
+	return this->gameScore();
+      }
+
+      // plays forward until numMoves moves have been made
+      void seek(const uint32_t numMoves) {
+	ASSERT(numMoves >= m_nextMove && numMoves <= m_numMoves, "can only replay forward, within the game");
+	for(; m_nextMove < numMoves; ++m_nextMove) {
+	  const MoveResult result = this->move(m_archive.move(m_game, m_nextMove));
+	  ASSERT(result != MOVE_INVALID, "archived move doesn't replay, wrong sequence or seed?");
+	  (void)result;
+	}
+      }
+
+      uint32_t movesMade() const { return m_nextMove; }
+      uint32_t numMoves() const { return m_numMoves; }
+
+    protected:
+      virtual void render() const override {}
+
+    private:
+      const ReplayArchiveReader& m_archive;
+      const size_t m_game;
+      const uint32_t m_numMoves;
+      uint32_t m_nextMove;
+    };
+
+    // the board of archived game after its first numMoves moves
+    template<class BOARD>
+    BOARD replayPosition(const ReplayArchiveReader& archive, const size_t game, const uint32_t numMoves) {
+      GameDriverReplay<BOARD> replay(archive, game);
+      replay.seek(numMoves);
+      return replay.board();
+    }
+
+  } // namespace game
+} // namespace threes
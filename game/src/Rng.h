@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * Small, fast, seedable random number generator (xoshiro256**).
+ * Satisfies UniformRandomBitGenerator, so it plugs in to the std::
+ * distributions as well as the cheaper helpers below.
+ */
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+namespace threes {
+  namespace game {
+
+    class RngContext {
+    public:
+      using result_type = uint64_t;
+      static constexpr result_type min() { return 0; }
+      static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+      // expands the seed with splitmix64, any seed (including 0) is fine
+      explicit RngContext(const uint64_t seed) {
+	uint64_t x = seed;
+	for(auto& word : m_state) {
+	  x += 0x9E3779B97F4A7C15ULL;
+	  uint64_t z = x;
+	  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	  word = z ^ (z >> 31);
+	}
+      }
+
+      // nondeterministic seed, the only place std::random_device gets used
+      static uint64_t randomSeed() {
+	std::random_device rd;
+	return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+      }
+
+      result_type operator()() {
+	const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+	const uint64_t t = m_state[1] << 17;
+	m_state[2] ^= m_state[0];
+	m_state[3] ^= m_state[1];
+	m_state[1] ^= m_state[2];
+	m_state[0] ^= m_state[3];
+	m_state[2] ^= t;
+	m_state[3] = rotl(m_state[3], 45);
+	return result;
+      }
+
+      // uniform in [lower, upper], Lemire's multiply-shift with rejection
+      unsigned uniformInt(const unsigned lower, const unsigned upper) {
+	const uint64_t range = static_cast<uint64_t>(upper) - lower + 1;
+	uint64_t x = (*this)() >> 32;
+	uint64_t m = x * range;
+	uint32_t low = static_cast<uint32_t>(m);
+	if(low < range) {
+	  const uint32_t threshold = static_cast<uint32_t>((0x100000000ULL - range) % range);
+	  while(low < threshold) {
+	    x = (*this)() >> 32;
+	    m = x * range;
+	    low = static_cast<uint32_t>(m);
+	  }
+	}
+	return lower + static_cast<unsigned>(m >> 32);
+      }
+
+      // uniform in [0, 1)
+      double uniform01() {
+	return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+      // Returns a context for an independent stream: the child carries on
+      // from the current state and this context jumps 2^128 draws ahead, so
+      // the two never overlap.
+      RngContext split() {
+	RngContext child(*this);
+	jump();
+	return child;
+      }
+
+      bool operator==(const RngContext& other) const { return m_state == other.m_state; }
+      bool operator!=(const RngContext& other) const { return m_state != other.m_state; }
+
+    private:
+      static uint64_t rotl(const uint64_t x, const int k) {
+	return (x << k) | (x >> (64 - k));
+      }
+
+      void jump() {
+	static constexpr uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+					     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+	std::array<uint64_t, 4> s{ {0, 0, 0, 0} };
+	for(uint64_t jumpWord : JUMP) {
+	  for(int b = 0; b < 64; ++b) {
+	    if(jumpWord & (1ULL << b)) {
+	      for(unsigned i = 0; i < 4; ++i) { s[i] ^= m_state[i]; }
+	    }
+	    (*this)();
+	  }
+	}
+	m_state = s;
+      }
+
+    private:
+      std::array<uint64_t, 4> m_state;
+    };
+
+    // per-thread context for callers that don't supply their own,
+    // seeded nondeterministically once per thread
+    inline RngContext& defaultRngContext() {
+      static thread_local RngContext s_rng(RngContext::randomSeed());
+      return s_rng;
+    }
+
+  } // namespace game
+} // namespace threes
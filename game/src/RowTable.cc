@@ -0,0 +1,77 @@
+#include "RowTable.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+  using threes::game::RowShiftEntry;
+  using threes::game::RowTables;
+
+  int32_t rankScore(const unsigned rank) {
+    return static_cast<int32_t>(threes::game::S_RANK_SCORES[rank]);
+  }
+
+  // same combine-first-pair-then-shift logic as Board<DIM>::shiftSlice,
+  // walking the four tiles in the given order
+  RowShiftEntry shiftLine(const unsigned line, const std::array<unsigned, 4>& order) {
+    std::array<unsigned, 4> ranks;
+    for(unsigned i = 0; i < 4; ++i) {
+      ranks[i] = (line >> (4*order[i])) & 0xF;
+    }
+
+    int32_t scoreDelta = 0;
+    unsigned shiftDestination = 4;
+    for(unsigned i = 0; (i < 3) && (shiftDestination == 4); ++i) {
+      if( threes::game::rankCanCombine(ranks[i], ranks[i+1]) ) {
+	const unsigned combined = threes::game::rankCombine(ranks[i], ranks[i+1]);
+	scoreDelta = rankScore(combined) - rankScore(ranks[i]) - rankScore(ranks[i+1]);
+	ranks[i] = combined;
+	shiftDestination = i+1;
+      }
+    }
+    for(; shiftDestination < 3; ++shiftDestination) {
+      ranks[shiftDestination] = ranks[shiftDestination+1];
+    }
+    if( shiftDestination == 3 ) {
+      ranks[3] = 0;
+    }
+
+    RowShiftEntry result;
+    unsigned shifted = 0;
+    unsigned maxRank = 0;
+    for(unsigned i = 0; i < 4; ++i) {
+      shifted |= ranks[i] << (4*order[i]);
+      maxRank = std::max(maxRank, ranks[i]);
+    }
+    result.shifted = static_cast<uint16_t>(shifted);
+    result.moved = (shifted != line);
+    result.maxRank = static_cast<uint8_t>(maxRank);
+    result.scoreDelta = scoreDelta;
+    return result;
+  }
+
+  RowTables* buildRowTables() {
+    static constexpr std::array<unsigned, 4> lowFirst{ 0, 1, 2, 3 };
+    static constexpr std::array<unsigned, 4> highFirst{ 3, 2, 1, 0 };
+
+    RowTables* tables = new RowTables();
+    for(unsigned line = 0; line < RowTables::NumLines; ++line) {
+      tables->towardLow[line]  = shiftLine(line, lowFirst);
+      tables->towardHigh[line] = shiftLine(line, highFirst);
+
+      unsigned maxRank = 0;
+      for(unsigned i = 0; i < 4; ++i) {
+	maxRank = std::max(maxRank, (line >> (4*i)) & 0xF);
+      }
+      tables->maxRank[line] = static_cast<uint8_t>(maxRank);
+    }
+    return tables;
+  }
+
+} // anon ns
+
+const threes::game::RowTables& threes::game::rowTables() {
+  static const std::unique_ptr<const RowTables> s_tables(buildRowTables());
+  return *s_tables;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+ * Precomputed transitions for a single packed line of four 4 bit card ranks
+ * (the first tile of the line in the low nibble). Every one of the 65536
+ * possible lines is shifted once up front, so shifting a PackedBoard4 (or a
+ * Board<4>) is four table lookups per direction.
+ */
+
+#include <array>
+#include <cstdint>
+
+#include "Card.h"
+
+namespace threes {
+  namespace game {
+
+    // rank space equivalent of Card::canCombine. Rank 15 cards are not allowed
+    // to combine, the result would not fit in 4 bits.
+    inline bool rankCanCombine(const unsigned currRank, const unsigned nextRank) {
+      if(nextRank == 0) { return false; }
+      const bool isEmpty = (currRank == 0);
+      const bool isBaseCombo = ( (currRank + nextRank) == 3 );
+      const bool isMatch = (currRank > 2 && currRank == nextRank && currRank < S_MAX_CARD_RANK);
+      return (isEmpty || isBaseCombo || isMatch);
+    }
+
+    // rank resulting from combining next on to curr, assumes rankCanCombine
+    inline unsigned rankCombine(const unsigned currRank, const unsigned nextRank) {
+      if(currRank == 0) { return nextRank; }
+      if(currRank < 3) { return 3; }
+      return currRank + 1;
+    }
+
+    struct RowShiftEntry {
+      uint16_t shifted;    // line after the shift, no card inserted
+      uint8_t moved;       // non-zero if the shift changed the line
+      uint8_t maxRank;     // largest rank in the shifted line
+      int32_t scoreDelta;  // change in standardCardScore total from the merge
+    };
+
+    struct RowTables {
+      static constexpr unsigned NumLines = 1u << 16;
+
+      // shift toward the first tile (LEFT for rows, UP for columns)
+      std::array<RowShiftEntry, NumLines> towardLow;
+      // shift toward the last tile (RIGHT for rows, DOWN for columns)
+      std::array<RowShiftEntry, NumLines> towardHigh;
+      // largest rank in the unshifted line
+      std::array<uint8_t, NumLines> maxRank;
+    };
+
+    // built on first use, shared and read only afterwards
+    const RowTables& rowTables();
+
+    // transpose a packed 4x4 board so columns become rows
+    inline uint64_t transposePacked(const uint64_t x) {
+      const uint64_t a1 = x & 0xF0F00F0FF0F00F0FULL;
+      const uint64_t a2 = x & 0x0000F0F00000F0F0ULL;
+      const uint64_t a3 = x & 0x0F0F00000F0F0000ULL;
+      const uint64_t a  = a1 | (a2 << 12) | (a3 >> 12);
+      const uint64_t b1 = a & 0xFF00FF0000FF00FFULL;
+      const uint64_t b2 = a & 0x00FF00FF00000000ULL;
+      const uint64_t b3 = a & 0x00000000FF00FF00ULL;
+      return b1 | (b2 >> 24) | (b3 << 24);
+    }
+
+  } // namespace game
+} // namespace threes
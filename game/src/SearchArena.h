@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+ * Preallocated scratch space for tree search, one frame per remaining
+ * search depth. A node at depth d only ever works in frame d, and its
+ * children only in frames below it, so a frame is never needed by two
+ * nodes at once.
+ *
+ * The first search fills the frames in; after that, setting a frame up is
+ * a copy in to the existing board and sequence, with no allocation.
+ */
+
+#include "Board.h"
+#include "CardSequence.h"
+#include "GameDriver.h"
+#include "Utils.h"
+
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    // what a pruned search already knows about one child of a chance node,
+    // from searching only its first move
+    struct ChildProbe {
+      double value;
+      ShiftDirection move;
+      bool known; // value is that move's exact value
+    };
+
+    template<class BOARD>
+    class SearchArena {
+    public:
+      struct Frame {
+	// The sequence API draws against a BoardPtr, so the board is held
+	// through one, but it is allocated once and then only assigned to.
+	typename GameDriver<BOARD>::BoardPtr board;
+	typename ICardSequence<BOARD>::ICardSeqPtr seq;
+	std::vector<DrawOutcome> outcomes;
+	std::vector<ChildProbe> probes;
+      };
+
+      // enough outcomes for the deck plus every bonus card up to the max rank
+      static constexpr unsigned OutcomeReserve = 2*S_MAX_CARD_RANK;
+
+      explicit SearchArena(const unsigned maxDepth)
+	: m_frames(maxDepth+1)
+	{
+	  for(auto& frame : m_frames) {
+	    frame.outcomes.reserve(OutcomeReserve);
+	    frame.probes.reserve(OutcomeReserve * BOARD::dim);
+	  }
+	}
+
+      SearchArena(const SearchArena&) = delete;
+      SearchArena& operator=(const SearchArena&) = delete;
+
+      // frame for depth, holding copies of board and seq
+      Frame& frame(const unsigned depth, const BOARD& board, const ICardSequence<BOARD>& seq) {
+	copySeq(depth, seq);
+	Frame& result = m_frames[depth];
+	*result.board = board;
+	return result;
+      }
+
+      // frame for depth holding a copy of just board, for a caller that
+      // only reads seq itself
+      Frame& boardFrame(const unsigned depth, const BOARD& board, const ICardSequence<BOARD>& seq) {
+	ASSERT( depth < m_frames.size(), "search deeper than the arena was sized for" );
+	Frame& result = m_frames[depth];
+	if(!result.board) {
+	  fill(seq);
+	}
+	*result.board = board;
+	return result;
+      }
+
+      // re-copy just the sequence, e.g. once per chance outcome
+      void copySeq(const unsigned depth, const ICardSequence<BOARD>& seq) {
+	ASSERT( depth < m_frames.size(), "search deeper than the arena was sized for" );
+	Frame& result = m_frames[depth];
+	if(!result.seq) {
+	  fill(seq);
+	}
+	result.seq->assignFrom(seq);
+      }
+
+      unsigned maxDepth() const { return m_frames.size() - 1; }
+
+    private:
+      // allocate every frame up front, so a search that goes deeper than
+      // the previous ones still doesn't allocate
+      void fill(const ICardSequence<BOARD>& seq) {
+	for(auto& frame : m_frames) {
+	  frame.seq = seq.clone();
+	  frame.board.reset(new BOARD(std::vector<Card>()));
+	}
+      }
+
+    private:
+      std::vector<Frame> m_frames;
+    };
+
+  } // namespace game
+} // namespace threes
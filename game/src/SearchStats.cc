@@ -0,0 +1,116 @@
+#include "SearchStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace threes {
+  namespace game {
+
+    constexpr unsigned LatencyHistogram::NumBuckets;
+    constexpr unsigned SearchStats::MaxPly;
+
+    void LatencyHistogram::add(const std::chrono::steady_clock::duration elapsed) {
+      const uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+      unsigned b = 0;
+      for(uint64_t micros = nanos / 1000; micros > 0 && b < NumBuckets-1; micros >>= 1) { ++b; }
+      ++m_buckets[b];
+      ++m_count;
+      m_totalNanos += nanos;
+      m_maxNanos = std::max(m_maxNanos, nanos);
+    }
+
+    void LatencyHistogram::merge(const LatencyHistogram& other) {
+      for(unsigned b = 0; b < NumBuckets; ++b) {
+	m_buckets[b] += other.m_buckets[b];
+      }
+      m_count += other.m_count;
+      m_totalNanos += other.m_totalNanos;
+      m_maxNanos = std::max(m_maxNanos, other.m_maxNanos);
+    }
+
+    double LatencyHistogram::percentileMicros(const double p) const {
+      if(m_count == 0) { return 0.0; }
+      // nearest rank, same as BatchResult::scorePercentile
+      const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * m_count)));
+      uint64_t seen = 0;
+      for(unsigned b = 0; b < NumBuckets; ++b) {
+	seen += m_buckets[b];
+	if(seen >= rank) { return std::min(bucketUpperMicros(b), maxMicros()); }
+      }
+      return maxMicros();
+    }
+
+    void LatencyHistogram::writeJson(std::ostream& out) const {
+      out << "{\"count\": " << m_count
+	  << ", \"mean_us\": " << meanMicros()
+	  << ", \"max_us\": " << maxMicros()
+	  << ", \"p50_us\": " << percentileMicros(50)
+	  << ", \"p90_us\": " << percentileMicros(90)
+	  << ", \"p99_us\": " << percentileMicros(99)
+	  << ", \"buckets\": [";
+      // only the non-empty ones, keyed by their upper edge
+      bool first = true;
+      for(unsigned b = 0; b < NumBuckets; ++b) {
+	if(m_buckets[b] == 0) { continue; }
+	out << (first ? "" : ", ") << "{\"lt_us\": ";
+	if(b == NumBuckets-1) { out << "null"; } else { out << bucketUpperMicros(b); }
+	out << ", \"count\": " << m_buckets[b] << "}";
+	first = false;
+      }
+      out << "]}";
+    }
+
+    ////////////////////
+
+    uint64_t SearchStats::totalNodes() const {
+      uint64_t result = 0;
+      for(const uint64_t nodes : nodesPerPly) { result += nodes; }
+      return result;
+    }
+
+    void SearchStats::merge(const SearchStats& other) {
+      for(unsigned ply = 0; ply < MaxPly; ++ply) {
+	nodesPerPly[ply] += other.nodesPerPly[ply];
+      }
+      leafEvals += other.leafEvals;
+      cacheProbes += other.cacheProbes;
+      cacheHits += other.cacheHits;
+      playerNodes += other.playerNodes;
+      playerChildren += other.playerChildren;
+      chanceNodes += other.chanceNodes;
+      chanceChildren += other.chanceChildren;
+      moveLatency.merge(other.moveLatency);
+    }
+
+    void SearchStats::writeJson(std::ostream& out) const {
+      auto ratio = [](const uint64_t num, const uint64_t den) {
+	return den ? static_cast<double>(num) / den : 0.0;
+      };
+
+      unsigned deepest = MaxPly;
+      while(deepest > 0 && nodesPerPly[deepest-1] == 0) { --deepest; }
+
+      out << "{\n";
+      out << "  \"moves\": " << moveLatency.count() << ",\n";
+      out << "  \"nodes\": " << totalNodes() << ",\n";
+      out << "  \"nodes_per_ply\": [";
+      for(unsigned ply = 0; ply < deepest; ++ply) {
+	out << (ply ? ", " : "") << nodesPerPly[ply];
+      }
+      out << "],\n";
+      out << "  \"nodes_per_move\": " << ratio(totalNodes(), moveLatency.count()) << ",\n";
+      out << "  \"leaf_evals\": " << leafEvals << ",\n";
+      out << "  \"cache_probes\": " << cacheProbes << ",\n";
+      out << "  \"cache_hits\": " << cacheHits << ",\n";
+      out << "  \"cache_hit_rate\": " << ratio(cacheHits, cacheProbes) << ",\n";
+      out << "  \"player_nodes\": " << playerNodes << ",\n";
+      out << "  \"player_branching\": " << ratio(playerChildren, playerNodes) << ",\n";
+      out << "  \"chance_nodes\": " << chanceNodes << ",\n";
+      out << "  \"chance_branching\": " << ratio(chanceChildren, chanceNodes) << ",\n";
+      out << "  \"move_latency\": ";
+      moveLatency.writeJson(out);
+      out << "\n}\n";
+    }
+
+  } // namespace game
+} // namespace threes
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * Where a strategy's time goes: per move latency and, for searching
+ * strategies, counters for the search itself. Each strategy owns one and
+ * only its own thread touches it, so the counters are plain integers;
+ * results from several threads are combined with merge() afterwards.
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+namespace threes {
+  namespace game {
+
+    // Power of two buckets in microseconds: bucket 0 is under 1us, bucket b
+    // is [2^(b-1), 2^b) us, the last bucket takes everything longer.
+    class LatencyHistogram {
+    public:
+      static constexpr unsigned NumBuckets = 32;
+
+      void add(const std::chrono::steady_clock::duration elapsed);
+      void merge(const LatencyHistogram& other);
+
+      uint64_t count() const { return m_count; }
+      double meanMicros() const { return m_count ? 1e-3 * m_totalNanos / m_count : 0.0; }
+      double maxMicros() const { return 1e-3 * m_maxNanos; }
+      // upper edge of the bucket holding the p'th percentile, p in [0,100]
+      double percentileMicros(const double p) const;
+      uint64_t bucket(const unsigned b) const { return m_buckets[b]; }
+      static double bucketUpperMicros(const unsigned b) { return static_cast<double>(uint64_t(1) << b); }
+
+      void writeJson(std::ostream& out) const;
+
+    private:
+      std::array<uint64_t, NumBuckets> m_buckets{};
+      uint64_t m_count = 0;
+      uint64_t m_totalNanos = 0;
+      uint64_t m_maxNanos = 0;
+    };
+
+    struct SearchStats {
+      static constexpr unsigned MaxPly = 16; // deeper nodes count in the last
+
+      // search nodes (chance nodes for ExpectiMaxTree) by distance from the root
+      std::array<uint64_t, MaxPly> nodesPerPly{};
+      uint64_t leafEvals = 0;
+      uint64_t cacheProbes = 0;
+      uint64_t cacheHits = 0;
+      // expanded nodes and the children they had, for branching factors
+      uint64_t playerNodes = 0;
+      uint64_t playerChildren = 0;
+      uint64_t chanceNodes = 0;
+      uint64_t chanceChildren = 0;
+      // time spent choosing each move, as seen by the game driver
+      LatencyHistogram moveLatency;
+
+      void countNode(const unsigned ply) { ++nodesPerPly[ply < MaxPly ? ply : MaxPly-1]; }
+      uint64_t totalNodes() const;
+
+      void merge(const SearchStats& other);
+      void writeJson(std::ostream& out) const;
+    };
+
+  } // namespace game
+} // namespace threes
@@ -0,0 +1,160 @@
+#pragma once
+
+/*
+ * Game loop with the board, card sequence and strategy types fixed at
+ * compile time. GameDriverStgy finds its sequence and strategy by name and
+ * calls both through their interfaces every move; StaticGameDriver makes
+ * the same calls bound to SEQ and STGY, so tight simulation loops can
+ * inline them. For the same seed it plays the same game.
+ *
+ * The string factories stay the way in: registerStaticGames puts a
+ * combination in IStaticGames<BOARD>::s_factory under a name, which is
+ * looked up once (e.g. per runBatch worker) and then plays any number of
+ * games with no virtual calls or factory lookups per move.
+ */
+
+#include "Board.h"
+#include "CardSequence.h"
+#include "GameDriver.h"
+#include "GameDriverStrategy.h"
+#include "SearchStats.h"
+#include "Utils.h"
+
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace threes {
+  namespace game {
+
+    // STGY is used by reference, not owned, so it can carry its caches
+    // from game to game.
+    template<class BOARD, class SEQ, class STGY>
+    class StaticGameDriver : public GameDriver<BOARD> {
+      static_assert(std::is_final<SEQ>::value, "SEQ must be final for its draws to bind statically");
+      static_assert(std::is_base_of<IThreesStgy<BOARD>, STGY>::value, "STGY must be an IThreesStgy");
+
+    public:
+      StaticGameDriver(const std::string& sequencerArgs,
+		       const unsigned numStartCards,
+		       STGY& stgy,
+		       const uint64_t seed = RngContext::randomSeed());
+
+      virtual uint64_t play() override; // GameDriver interface
+
+    protected:
+      virtual void render() const override {}
+
+    private:
+      STGY& m_stgy;
+    };
+
+    // A name's worth of StaticGameDriver: one combination of types, with
+    // its strategy made once and reused for every game.
+    template<class BOARD>
+    class IStaticGames {
+    public:
+      using StaticGamesFactory = ro::ObjectFromStrFactory< IStaticGames<BOARD> >;
+      static StaticGamesFactory s_factory;
+      using StaticGamesPtr = typename StaticGamesFactory::ObjectPtr;
+
+      virtual ~IStaticGames() {}
+
+      // plays a whole game and returns its score, board() is its final board
+      virtual uint64_t play(const std::string& sequencerArgs, const unsigned numStartCards,
+			    const uint64_t seed, const bool commonRandom) = 0;
+      virtual const BOARD& board() const = 0;
+
+      // the strategy's, see IThreesStgy::stats
+      virtual const SearchStats& stats() const = 0;
+    };
+
+    template<class BOARD, class SEQ, class STGY>
+    class StaticGames : public IStaticGames<BOARD> {
+    public:
+      // args are the strategy's, as given to STGY::create
+      static typename IStaticGames<BOARD>::StaticGamesPtr create(const std::string& args);
+
+      virtual uint64_t play(const std::string& sequencerArgs, const unsigned numStartCards,
+			    const uint64_t seed, const bool commonRandom) override;
+      virtual const BOARD& board() const override { return *m_board; }
+      virtual const SearchStats& stats() const override { return m_stgy->stats(); }
+
+    private:
+      explicit StaticGames(std::unique_ptr<STGY> stgy) : m_stgy(std::move(stgy)) {}
+
+    private:
+      std::unique_ptr<STGY> m_stgy;
+      std::unique_ptr<BOARD> m_board;
+    };
+
+    // registers StaticGames<BOARD, SEQ, STGY> as name
+    template<class BOARD, class SEQ, class STGY>
+    void registerStaticGames(const std::string& name) {
+      IStaticGames<BOARD>::s_factory.registerCreator(name, StaticGames<BOARD, SEQ, STGY>::create);
+    }
+
+
+    //////////////////////////////////////////////////////////
+    // implementations
+    //////////////////////////////////////////////////////////
+
+    template<class BOARD, class SEQ, class STGY>
+    StaticGameDriver<BOARD, SEQ, STGY>::StaticGameDriver(const std::string& sequencerArgs,
+							 const unsigned numStartCards,
+							 STGY& stgy,
+							 const uint64_t seed)
+      : GameDriver<BOARD>(SEQ::create(sequencerArgs), numStartCards, seed)
+      , m_stgy(stgy)
+    {
+      ASSERT(dynamic_cast<const SEQ*>(this->m_cardSeqPtr.get()) != nullptr,
+	     "SEQ::create made some other kind of sequence");
+      // same split as GameDriverStgy, so both play the same game
+      m_stgy.seed(this->m_rng.split()());
+    }
+
+    template<class BOARD, class SEQ, class STGY>
+    uint64_t StaticGameDriver<BOARD, SEQ, STGY>::play() {
+      static constexpr unsigned MAX_CONSEC_INVALID = 1000u;
+      (void)MAX_CONSEC_INVALID; // only read by ASSERT
+
+      unsigned numConsecInvalid = 0;
+      MoveResult lastMove = MOVE_INVALID;
+      while( lastMove != END_GAME ) {
+	const ShiftDirection moveDir = m_stgy.STGY::move(this->m_boardPtr, this->m_cardSeqPtr);
+	lastMove = this->template move<SEQ>(moveDir);
+	if(lastMove != MOVE_INVALID) {
+	  numConsecInvalid = 0;
+	} else {
+	  ++numConsecInvalid;
+	  ASSERT(numConsecInvalid < MAX_CONSEC_INVALID,
+		 "strategy did many invalid moves in a row, giving up to avoid infinte loop");
+	}
+      }
+      return this->gameScore();
+    }
+
+    ////////////////////
+
+    template<class BOARD, class SEQ, class STGY>
+    typename IStaticGames<BOARD>::StaticGamesPtr
+    StaticGames<BOARD, SEQ, STGY>::create(const std::string& args) {
+      typename IThreesStgy<BOARD>::ThreesStgyPtr stgyPtr(STGY::create(args));
+      ASSERT(dynamic_cast<STGY*>(stgyPtr.get()) != nullptr, "STGY::create made some other kind of strategy");
+      std::unique_ptr<STGY> stgy(static_cast<STGY*>(stgyPtr.release()));
+      return typename IStaticGames<BOARD>::StaticGamesPtr(new StaticGames(std::move(stgy)));
+    }
+
+    template<class BOARD, class SEQ, class STGY>
+    uint64_t StaticGames<BOARD, SEQ, STGY>::play(const std::string& sequencerArgs,
+						 const unsigned numStartCards,
+						 const uint64_t seed, const bool commonRandom) {
+      StaticGameDriver<BOARD, SEQ, STGY> game(sequencerArgs, numStartCards, *m_stgy, seed);
+      game.setCommonRandom(commonRandom);
+      const uint64_t score = game.play();
+      m_board.reset(new BOARD(game.board()));
+      return score;
+    }
+
+  } // ns game
+} // ns threes
@@ -0,0 +1,214 @@
+#pragma once
+
+/*
+ * Self-play temporal difference training of an NTupleNetwork as an
+ * afterstate value function: the value of the board right after the tiles
+ * slide, before the new card goes in. Moves are picked greedily by merge
+ * score plus afterstate value, and each afterstate is pulled toward the
+ * next move's reward plus the next afterstate's value (TD(0)), or with
+ * lambda > 0, the last traceLength afterstates are too, decaying by lambda
+ * per step (truncated TD(lambda)).
+ *
+ * Training runs in rounds over worker threads. Each worker plays its games
+ * of the round against its own copy of the network, and the workers'
+ * weight changes are then summed in to the shared network in worker order,
+ * so the same seed and thread count always train the same weights.
+ */
+
+#include "Board.h"
+#include "GameDriver.h"
+#include "Hashing.h"
+#include "LineEvaluator.h"
+#include "NTupleNetwork.h"
+#include "Rng.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    struct TDConfig {
+      unsigned numGames = 1000;
+      unsigned numThreads = 1;
+      unsigned gamesPerRound = 8;  // per worker, between merges
+      float alpha = 0.1f;          // step size, spread over the network's lookups
+      float lambda = 0.0f;
+      unsigned traceLength = 5;    // afterstates updated per step when lambda > 0
+      unsigned reportEvery = 1000; // games per progress line
+      std::string seqName = "k28d";
+      std::string seqArgs = "default";
+      unsigned numStartCards = 9;
+      uint64_t seed = 0; // 0 picks a random one, game i is seeded from (seed, i)
+    };
+
+    struct TDResult {
+      std::vector<uint64_t> scores;    // one per game, in game order
+      std::vector<unsigned> maxCards;  // one per game, in game order
+      double seconds = 0.0;
+      uint64_t seed = 0;
+    };
+
+    // one training game, learning in to net as it plays
+    template<class BOARD>
+    class GameDriverTD : public GameDriver<BOARD> {
+    public:
+      GameDriverTD(const TDConfig& config, NTupleNetwork& net, const uint64_t seed)
+	: GameDriver<BOARD>(config.seqName, config.seqArgs, config.numStartCards, seed)
+	, m_config(config)
+	, m_net(net)
+	{}
+
+      virtual uint64_t play() override; // GameDriver interface
+
+    protected:
+      virtual void render() const override {} // no render for automated play
+
+      // pull every afterstate in the trace toward its target by error
+      void learn(const float error);
+
+    protected:
+      using GameDriver<BOARD>::m_boardPtr;
+
+      const TDConfig& m_config;
+      NTupleNetwork& m_net;
+      std::vector<uint64_t> m_trace; // most recent afterstate last
+    };
+
+    // trains net in place, progress (if not null) gets a line about every
+    // reportEvery games
+    template<class BOARD>
+    TDResult trainTD(NTupleNetwork& net, const TDConfig& config, std::ostream* progress = nullptr);
+
+
+    //////////////////////////////////////////////////////////
+    // implementations
+    //////////////////////////////////////////////////////////
+
+    template<class BOARD>
+    void GameDriverTD<BOARD>::learn(const float error) {
+      const float step = m_config.alpha * error / m_net.numLookups();
+      float decay = 1.0f;
+      for(auto itr = m_trace.rbegin(); itr != m_trace.rend(); ++itr) {
+	m_net.update(*itr, step * decay);
+	decay *= m_config.lambda;
+      }
+    }
+
+    template<class BOARD>
+    uint64_t GameDriverTD<BOARD>::play() {
+      const unsigned traceLength = m_config.lambda > 0.0f ? std::max(m_config.traceLength, 1u) : 1u;
+      m_trace.clear();
+
+      MoveResult lastMove = MOVE_VALID;
+      while( lastMove != END_GAME ) {
+	// greedy over reward + afterstate value
+	const uint64_t before = m_boardPtr->score();
+	ShiftDirection bestDir = NUM_DIRECTIONS;
+	float bestValue = -std::numeric_limits<float>::infinity();
+	uint64_t bestAfter = 0;
+	const MoveSet& moves = this->legalMoves();
+	for(auto dir : {DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT}) {
+	  if( !moves.canShift(dir) ) { continue; }
+	  BOARD after(*m_boardPtr);
+	  after.shiftTiles(dir, moves.moved[dir]);
+	  const uint64_t afterPacked = packedTiles(after);
+	  const float reward = static_cast<float>(after.score()) - before;
+	  const float value = reward + m_net.value(afterPacked);
+	  if(value > bestValue) {
+	    bestDir = dir;
+	    bestValue = value;
+	    bestAfter = afterPacked;
+	  }
+	}
+	ASSERT(bestDir != NUM_DIRECTIONS, "training game has no moves left but didn't end");
+
+	if(!m_trace.empty()) {
+	  learn(bestValue - m_net.value(m_trace.back()));
+	}
+	if(m_trace.size() == traceLength) { m_trace.erase(m_trace.begin()); }
+	m_trace.push_back(bestAfter);
+
+	lastMove = this->move(bestDir);
+      }
+      // nothing follows the last afterstate
+      learn(-m_net.value(m_trace.back()));
+
+      return this->gameScore();
+    }
+
+    template<class BOARD>
+    TDResult trainTD(NTupleNetwork& net, const TDConfig& config, std::ostream* progress) {
+      ASSERT(config.numThreads > 0 && config.gamesPerRound > 0, "need at least one worker and game per round");
+
+      TDResult result;
+      result.scores.resize(config.numGames, 0);
+      result.maxCards.resize(config.numGames, 0);
+      result.seed = config.seed != 0 ? config.seed : RngContext::randomSeed();
+
+      const auto start = std::chrono::steady_clock::now();
+
+      std::vector<NTupleNetwork> workerNets(config.numThreads, net);
+      const unsigned roundGames = config.numThreads * config.gamesPerRound;
+      unsigned reported = 0;
+      for(unsigned roundStart = 0; roundStart < config.numGames; roundStart += roundGames) {
+	// worker w plays games [roundStart + w*gamesPerRound, +gamesPerRound)
+	auto worker = [&](const unsigned w) {
+	  workerNets[w].weights() = net.weights();
+	  const unsigned first = roundStart + w * config.gamesPerRound;
+	  const unsigned last = std::min(first + config.gamesPerRound, config.numGames);
+	  for(unsigned gameIdx = first; gameIdx < last; ++gameIdx) {
+	    GameDriverTD<BOARD> game(config, workerNets[w], hashCombine(result.seed, gameIdx));
+	    result.scores[gameIdx] = game.play();
+	    result.maxCards[gameIdx] = game.board().maxCard().value;
+	  }
+	};
+
+	std::vector<std::thread> workers;
+	for(unsigned w = 1; w < config.numThreads; ++w) {
+	  workers.emplace_back(worker, w);
+	}
+	worker(0);
+	for(auto& thread : workers) {
+	  thread.join();
+	}
+
+	// sum of every worker's changes, in worker order
+	std::vector<float> merged(net.weights());
+	for(const auto& workerNet : workerNets) {
+	  const std::vector<float>& weights = workerNet.weights();
+	  for(size_t i = 0; i < merged.size(); ++i) {
+	    merged[i] += weights[i] - net.weights()[i];
+	  }
+	}
+	net.weights().swap(merged);
+
+	const unsigned roundEnd = std::min(roundStart + roundGames, config.numGames);
+	if(progress && (roundEnd - reported >= config.reportEvery || roundEnd == config.numGames)) {
+	  double meanScore = 0.0;
+	  unsigned maxCard = 0;
+	  for(unsigned i = reported; i < roundEnd; ++i) {
+	    meanScore += result.scores[i];
+	    maxCard = std::max(maxCard, result.maxCards[i]);
+	  }
+	  meanScore /= (roundEnd - reported);
+	  *progress << "games " << roundEnd << " mean score " << meanScore
+		    << " max card " << maxCard << std::endl;
+	  reported = roundEnd;
+	}
+      }
+
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      result.seconds = elapsed.count();
+      return result;
+    }
+
+  } // ns game
+} // ns threes
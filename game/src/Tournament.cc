@@ -0,0 +1,179 @@
+#include "Tournament.h"
+
+#include <cmath>
+#include <iomanip>
+
+namespace threes {
+  namespace game {
+
+    namespace {
+
+      // mean and sample variance of the mean
+      template<class T>
+      std::pair<double, double> meanAndVariance(const std::vector<T>& values) {
+	if(values.empty()) { return std::make_pair(0.0, 0.0); }
+	double mean = 0.0;
+	for(const T value : values) { mean += value; }
+	mean /= values.size();
+	if(values.size() < 2) { return std::make_pair(mean, 0.0); }
+	double squares = 0.0;
+	for(const T value : values) { squares += (value - mean) * (value - mean); }
+	return std::make_pair(mean, squares / (values.size() - 1) / values.size());
+      }
+
+      // keeps a test with no spread seen yet from dividing by zero
+      const double MinVariance = 1e-9;
+
+    } // anon
+
+    TournamentConfig TournamentConfig::fromStr(const std::string& args) {
+      TournamentConfig config;
+      auto opts = ro::parseKeyValues( ro::strsplit( args, ";" ) );
+      for(const auto& opt : opts) {
+	if     (opt.first == "games"  ) { config.maxGames = std::stoul(opt.second); }
+	else if(opt.first == "min"    ) { config.minGames = std::stoul(opt.second); }
+	else if(opt.first == "round"  ) { config.roundGames = std::stoul(opt.second); }
+	else if(opt.first == "alpha"  ) { config.alpha = std::stod(opt.second); }
+	else if(opt.first == "beta"   ) { config.beta = std::stod(opt.second); }
+	else if(opt.first == "score"  ) { config.scoreDelta = std::stod(opt.second); }
+	else if(opt.first == "card"   ) { config.targetCard = std::stoul(opt.second); }
+	else if(opt.first == "rate"   ) { config.rateDelta = std::stod(opt.second); }
+	else if(opt.first == "paired" ) { config.paired = (opt.second != "0"); }
+	else if(opt.first == "seed"   ) { config.seed = std::stoull(opt.second); }
+	else if(opt.first == "threads") { config.numThreads = std::stoul(opt.second); }
+	else { ASSERT(false, std::string("unknown tournament setting ") + opt.first); }
+      }
+      ASSERT(config.alpha > 0.0 && config.alpha < 1.0 && config.beta > 0.0 && config.beta < 1.0,
+	     "tournament alpha and beta must be in (0, 1)");
+      ASSERT(config.scoreDelta > 0.0 && config.rateDelta > 0.0, "tournament deltas must be positive");
+      return config;
+    }
+
+    const char* verdictName(const TournamentVerdict verdict) {
+      switch(verdict) {
+      case TournamentVerdict::Undecided:    return "undecided";
+      case TournamentVerdict::FirstBetter:  return "first better";
+      case TournamentVerdict::SecondBetter: return "second better";
+      case TournamentVerdict::NoDifference: return "no difference";
+      }
+      return "?";
+    }
+
+    double normalLlr(const double diff, const double variance, const double delta) {
+      return (delta * diff - 0.5 * delta * delta) / std::max(variance, MinVariance);
+    }
+
+    ////////////////////
+
+    void MetricTest::update(const double latestDiff, const double variance,
+			    const double lower, const double upper) {
+      diff = latestDiff;
+      stdError = std::sqrt(variance);
+      for(unsigned side = 0; side < 2; ++side) {
+	llr[side] = normalLlr(side == 0 ? diff : -diff, variance, delta);
+	if(sides[side] != Side::Open) { continue; }
+	if(llr[side] >= upper) { sides[side] = Side::Better; }
+	else if(llr[side] <= lower) { sides[side] = Side::Equal; }
+      }
+    }
+
+    TournamentVerdict MetricTest::verdict() const {
+      if(sides[0] == Side::Better) { return TournamentVerdict::FirstBetter; }
+      if(sides[1] == Side::Better) { return TournamentVerdict::SecondBetter; }
+      if(sides[0] == Side::Equal && sides[1] == Side::Equal) { return TournamentVerdict::NoDifference; }
+      return TournamentVerdict::Undecided;
+    }
+
+    ////////////////////
+
+    double TournamentResult::targetRate(const unsigned idx) const {
+      const auto& maxCards = results[idx].maxCards;
+      if(maxCards.empty()) { return 0.0; }
+      const auto hits = std::count_if(maxCards.begin(), maxCards.end(),
+				      [this](const unsigned card) { return card >= targetCard; });
+      return static_cast<double>(hits) / maxCards.size();
+    }
+
+    void TournamentResult::update(const TournamentConfig& config) {
+      if(tests.empty()) {
+	tests.emplace_back("score", config.scoreDelta);
+	tests.emplace_back("rate>=" + std::to_string(config.targetCard), config.rateDelta);
+      }
+      const double lower = std::log(config.beta / (1.0 - config.alpha));
+      const double upper = std::log((1.0 - config.beta) / config.alpha);
+
+      if(paired) {
+	ASSERT(results[0].scores.size() == results[1].scores.size(), "paired games need equal counts");
+	std::vector<double> scoreDiffs(results[0].scores.size());
+	for(size_t game = 0; game < scoreDiffs.size(); ++game) {
+	  scoreDiffs[game] = static_cast<double>(results[0].scores[game]) - results[1].scores[game];
+	}
+	const auto scoreDiff = meanAndVariance(scoreDiffs);
+	tests[0].update(scoreDiff.first, scoreDiff.second, lower, upper);
+
+	// only games where just one side reached the target count, half of
+	// one added to each kind for the same reason as below
+	const double n = results[0].maxCards.size();
+	double firstOnly = 0.5, secondOnly = 0.5;
+	for(size_t game = 0; game < results[0].maxCards.size(); ++game) {
+	  const bool firstHit = results[0].maxCards[game] >= targetCard;
+	  const bool secondHit = results[1].maxCards[game] >= targetCard;
+	  if(firstHit && !secondHit) { firstOnly += 1.0; }
+	  if(secondHit && !firstHit) { secondOnly += 1.0; }
+	}
+	const double meanDiff = (firstOnly - secondOnly) / (n + 1.0);
+	const double rateVariance = ((firstOnly + secondOnly) / (n + 1.0) - meanDiff * meanDiff) / n;
+	tests[1].update(targetRate(0) - targetRate(1), rateVariance, lower, upper);
+      } else {
+	const auto first = meanAndVariance(results[0].scores);
+	const auto second = meanAndVariance(results[1].scores);
+	tests[0].update(first.first - second.first, first.second + second.second, lower, upper);
+
+	// half a success added to each side keeps the variance off 0 when
+	// neither (or both) ever reach the target
+	std::array<double, 2> rateVariance;
+	for(unsigned idx = 0; idx < 2; ++idx) {
+	  const double n = results[idx].maxCards.size();
+	  const double p = (targetRate(idx) * n + 0.5) / (n + 1.0);
+	  rateVariance[idx] = p * (1.0 - p) / n;
+	}
+	tests[1].update(targetRate(0) - targetRate(1), rateVariance[0] + rateVariance[1], lower, upper);
+      }
+
+      verdict = TournamentVerdict::NoDifference;
+      for(const auto& test : tests) {
+	const TournamentVerdict testVerdict = test.verdict();
+	if(testVerdict == TournamentVerdict::FirstBetter || testVerdict == TournamentVerdict::SecondBetter) {
+	  verdict = testVerdict;
+	  return;
+	}
+	if(testVerdict == TournamentVerdict::Undecided) { verdict = TournamentVerdict::Undecided; }
+      }
+    }
+
+    void TournamentResult::print(std::ostream& out) const {
+      const std::streamsize oldPrecision = out.precision();
+      out << "Tournament of " << gamesPerStgy() << (paired ? " paired" : "")
+	  << " games each in " << rounds << " rounds, "
+	  << std::fixed << std::setprecision(2) << seconds << "s, seed " << seed << std::endl;
+      for(unsigned idx = 0; idx < 2; ++idx) {
+	out << (idx == 0 ? "first:  " : "second: ") << labels[idx]
+	    << " score mean " << results[idx].meanScore()
+	    << " p50 " << results[idx].scorePercentile(50)
+	    << ", max card >= " << targetCard << " " << std::setprecision(1)
+	    << 100.0 * targetRate(idx) << "%" << std::setprecision(2) << std::endl;
+      }
+      for(const auto& test : tests) {
+	const auto interval = test.confidenceInterval();
+	out << test.name << ": diff " << test.diff << " +- " << test.stdError
+	    << ", 95% CI [" << interval.first << ", " << interval.second << "]"
+	    << " (delta " << test.delta << "), llr " << test.llr[0] << " / " << test.llr[1]
+	    << ", " << verdictName(test.verdict()) << std::endl;
+      }
+      out << "Verdict: " << verdictName(verdict) << std::endl;
+      out.unsetf(std::ios_base::floatfield);
+      out.precision(oldPrecision);
+    }
+
+  } // ns game
+} // ns threes
@@ -0,0 +1,180 @@
+#pragma once
+
+/*
+ * Head to head comparison of two strategies that stops as soon as the
+ * answer is clear instead of after a fixed number of games.
+ *
+ * Both strategies play the same number of games, a round at a time
+ * through runBatch. After each round every metric (mean score, and the
+ * rate of reaching a target max card) gets two of Wald's sequential
+ * probability ratio tests on the difference first - second: "first is
+ * better by delta" against "no difference", and the same for second. The
+ * difference of the means is taken as normal with the variance estimated
+ * from the games so far. A test is over once its log likelihood ratio
+ * leaves [log(beta/(1-alpha)), log((1-beta)/alpha)].
+ *
+ * The tournament stops when any metric finds one side better, when every
+ * metric has found no difference worth delta, or at maxGames. alpha and
+ * beta are per test; there are four, so the chance of some false alarm
+ * is up to four times alpha.
+ *
+ * Paired mode plays game i of both strategies from the same seed with
+ * common random numbers (see GameDriver::setCommonRandom), so both get
+ * the same deck shuffles, bonus draws and insertion slots for as long as
+ * their boards allow. The tests then run on the per game differences,
+ * which lose the deck's share of the variance and need far fewer games.
+ */
+
+#include "BatchRunner.h"
+#include "Rng.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace threes {
+  namespace game {
+
+    struct TournamentConfig {
+      std::array<std::string, 2> stgyNames{{"random", "random"}};
+      std::array<std::string, 2> stgyArgs{{"", ""}};
+      std::string seqName = "k28d";
+      std::string seqArgs = "default";
+      unsigned numStartCards = 9;
+      unsigned numThreads = 1;
+      unsigned maxGames = 10000;   // per strategy
+      unsigned minGames = 100;     // per strategy before the first test
+      unsigned roundGames = 50;    // per strategy between tests
+      double alpha = 0.05;         // false alarm rate of each test
+      double beta = 0.05;          // miss rate of each test, at a difference of delta
+      double scoreDelta = 250.0;   // smallest mean score difference worth finding
+      unsigned targetCard = 384;   // max card counted as a success for the rate
+      double rateDelta = 0.05;     // smallest success rate difference worth finding
+      bool paired = false;         // same games for both, tested on per game differences
+      uint64_t seed = 0; // 0 picks a random one
+
+      // ';' delimited key=value settings, the strategies are set separately
+      // (their args have ';'s of their own)
+      static TournamentConfig fromStr(const std::string& args);
+    };
+
+    enum class TournamentVerdict { Undecided, FirstBetter, SecondBetter, NoDifference };
+    const char* verdictName(const TournamentVerdict verdict);
+
+    // Log likelihood ratio of "the mean difference is delta" against "it
+    // is 0", for an observed difference diff with the given variance.
+    double normalLlr(const double diff, const double variance, const double delta);
+
+    // The two one sided tests for one metric
+    struct MetricTest {
+      enum class Side { Open, Equal, Better };
+
+      std::string name;
+      double delta = 0.0;
+      double diff = 0.0;       // latest first - second
+      double stdError = 0.0;   // of diff
+      std::array<double, 2> llr{{0.0, 0.0}};  // first better, second better
+      std::array<Side, 2> sides{{Side::Open, Side::Open}};
+
+      MetricTest() = default;
+      MetricTest(const std::string& name, const double delta) : name(name), delta(delta) {}
+
+      // feeds in the latest estimate, sides already decided stay decided
+      void update(const double diff, const double variance, const double lower, const double upper);
+      TournamentVerdict verdict() const;
+      // normal confidence interval on diff, 95% by default
+      std::pair<double, double> confidenceInterval(const double z = 1.96) const {
+	return std::make_pair(diff - z * stdError, diff + z * stdError);
+      }
+    };
+
+    struct TournamentResult {
+      std::array<BatchResult, 2> results;  // every game of each strategy
+      std::array<std::string, 2> labels;
+      unsigned targetCard = 0;
+      bool paired = false;
+      std::vector<MetricTest> tests;       // score, then target card rate
+      unsigned rounds = 0;
+      TournamentVerdict verdict = TournamentVerdict::Undecided;
+      double seconds = 0.0;
+      uint64_t seed = 0;
+
+      unsigned gamesPerStgy() const { return results[0].scores.size(); }
+      double targetRate(const unsigned idx) const;
+
+      // reruns the tests on every game so far, then decides the verdict
+      void update(const TournamentConfig& config);
+      void print(std::ostream& out) const;
+    };
+
+    template<class BOARD>
+    TournamentResult runTournament(const TournamentConfig& config, std::ostream* progress = nullptr);
+
+
+    //////////////////////////////////////////////////////////
+    // implementations
+    //////////////////////////////////////////////////////////
+
+    template<class BOARD>
+    TournamentResult runTournament(const TournamentConfig& config, std::ostream* progress) {
+      ASSERT(config.roundGames > 0, "need at least one game per round");
+      ASSERT(config.minGames > 1, "need at least two games before testing");
+
+      TournamentResult result;
+      result.seed = config.seed != 0 ? config.seed : RngContext::randomSeed();
+      result.targetCard = config.targetCard;
+      result.paired = config.paired;
+      for(unsigned idx = 0; idx < 2; ++idx) {
+	result.labels[idx] = config.stgyNames[idx] +
+	  (config.stgyArgs[idx].empty() ? "" : "(" + config.stgyArgs[idx] + ")");
+      }
+
+      // independent games for each side, unless they're paired
+      const std::array<uint64_t, 2> stgySeeds{{ hashCombine(result.seed, 0),
+						hashCombine(result.seed, config.paired ? 0 : 1) }};
+
+      const auto start = std::chrono::steady_clock::now();
+      while(result.verdict == TournamentVerdict::Undecided && result.gamesPerStgy() < config.maxGames) {
+	const unsigned played = result.gamesPerStgy();
+	const unsigned wanted = played < config.minGames ? config.minGames : played + config.roundGames;
+	for(unsigned idx = 0; idx < 2; ++idx) {
+	  BatchConfig batch;
+	  batch.numGames = std::min(wanted, config.maxGames) - played;
+	  batch.numThreads = config.numThreads;
+	  batch.stgyName = config.stgyNames[idx];
+	  batch.stgyArgs = config.stgyArgs[idx];
+	  batch.seqName = config.seqName;
+	  batch.seqArgs = config.seqArgs;
+	  batch.numStartCards = config.numStartCards;
+	  batch.seed = stgySeeds[idx];
+	  batch.firstGame = played;
+	  batch.commonRandom = config.paired;
+	  result.results[idx].append(runBatch<BOARD>(batch));
+	}
+	++result.rounds;
+	result.update(config);
+
+	if(progress) {
+	  *progress << "round " << result.rounds << ": " << result.gamesPerStgy() << " games each";
+	  for(const auto& test : result.tests) {
+	    const auto interval = test.confidenceInterval();
+	    *progress << ", " << test.name << " diff " << test.diff
+		      << " [" << interval.first << ", " << interval.second << "]";
+	  }
+	  *progress << std::endl;
+	}
+      }
+
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      result.seconds = elapsed.count();
+      return result;
+    }
+
+  } // ns game
+} // ns threes
@@ -0,0 +1,156 @@
+#include "TranspositionTable.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define THREES_TT_HAS_MMAP 1
+#endif
+
+namespace threes {
+  namespace game {
+
+    TranspositionTable::ReplacementPolicy TranspositionTable::policyFromStr(const std::string& name) {
+      if(name == "always") { return REPLACE_ALWAYS; }
+      ASSERT(name == "depth", "unknown transposition table policy, only always/depth supported");
+      return REPLACE_DEPTH_PREFERRED;
+    }
+
+    TranspositionTable::TranspositionTable(const size_t budgetBytes,
+					   const ReplacementPolicy policy,
+					   const bool useHugePages)
+      : m_policy(policy)
+      , m_numBuckets(1)
+      , m_buckets(nullptr)
+      , m_rawAlloc(nullptr)
+      , m_mmapped(false)
+      , m_hugePages(false)
+      , m_generation(0)
+      , m_hits(0)
+      , m_misses(0)
+      , m_stores(0)
+      , m_evictions(0)
+    {
+      // largest power of two number of buckets that fits the budget
+      while( (m_numBuckets*2) * sizeof(Bucket) <= budgetBytes ) {
+	m_numBuckets *= 2;
+      }
+      const size_t bytes = m_numBuckets * sizeof(Bucket);
+
+#ifdef THREES_TT_HAS_MMAP
+      void* mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+      // explicit huge pages only work if the admin reserved some, fall through if not
+      if(useHugePages) {
+	mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	m_hugePages = (mem != MAP_FAILED);
+      }
+#endif
+      if(mem == MAP_FAILED) {
+	mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+	if(useHugePages && mem != MAP_FAILED) {
+	  m_hugePages = (madvise(mem, bytes, MADV_HUGEPAGE) == 0);
+	}
+#endif
+      }
+      if(mem != MAP_FAILED) {
+	// anonymous mappings are zero filled, i.e. every entry starts empty
+	m_buckets = static_cast<Bucket*>(mem);
+	m_mmapped = true;
+      }
+#else
+      (void)useHugePages; // no portable way to ask for them
+#endif
+
+      if(!m_mmapped) {
+	// plain new can't be trusted with 64 byte alignment before C++17
+	m_rawAlloc = new char[bytes + alignof(Bucket)];
+	const uintptr_t raw = reinterpret_cast<uintptr_t>(m_rawAlloc);
+	const uintptr_t aligned = (raw + alignof(Bucket) - 1) & ~static_cast<uintptr_t>(alignof(Bucket) - 1);
+	m_buckets = reinterpret_cast<Bucket*>(aligned);
+	clear();
+      }
+    }
+
+    TranspositionTable::~TranspositionTable() {
+#ifdef THREES_TT_HAS_MMAP
+      if(m_mmapped) {
+	munmap(m_buckets, sizeBytes());
+	return;
+      }
+#endif
+      delete[] m_rawAlloc;
+    }
+
+    void TranspositionTable::clear() {
+      std::memset(static_cast<void*>(m_buckets), 0, sizeBytes());
+    }
+
+    const TranspositionTable::Entry* TranspositionTable::probe(const uint64_t key) {
+      Bucket& bucket = bucketFor(key);
+      const uint32_t check = checkFor(key);
+      for(Entry& entry : bucket.entries) {
+	if(entry.count > 0 && entry.check == check) {
+	  ++m_hits;
+	  return &entry;
+	}
+      }
+      ++m_misses;
+      return nullptr;
+    }
+
+    TranspositionTable::Entry* TranspositionTable::chooseSlot(Bucket& bucket,
+							      const uint32_t check,
+							      const unsigned depth) {
+      if(m_policy == REPLACE_ALWAYS) {
+	return &bucket.entries[check % BucketSize];
+      }
+
+      // an existing entry for this key always gets updated in place
+      for(Entry& entry : bucket.entries) {
+	if(entry.count > 0 && entry.check == check) { return &entry; }
+      }
+
+      // otherwise empty, then stale, then shallowest
+      Entry* victim = nullptr;
+      for(Entry& entry : bucket.entries) {
+	if(entry.count == 0) { return &entry; }
+	const bool stale = (entry.generation != m_generation);
+	if(!victim) { victim = &entry; continue; }
+	const bool victimStale = (victim->generation != m_generation);
+	if( (stale && !victimStale) ||
+	    (stale == victimStale && entry.depth < victim->depth) ) {
+	  victim = &entry;
+	}
+      }
+
+      // keep a deeper entry from this search rather than overwrite it with a shallow one
+      if(victim->generation == m_generation && victim->depth > depth) {
+	return nullptr;
+      }
+      return victim;
+    }
+
+    void TranspositionTable::store(const uint64_t key, const unsigned depth,
+				   const double value, const unsigned count) {
+      const uint32_t check = checkFor(key);
+      Entry* slot = chooseSlot(bucketFor(key), check, depth);
+      if(!slot) { return; }
+
+      if(slot->count > 0 && slot->check != check) { ++m_evictions; }
+      ++m_stores;
+
+      slot->value = value;
+      slot->check = check;
+      slot->count = static_cast<uint16_t>(std::min<unsigned>(count, UINT16_MAX));
+      slot->depth = static_cast<uint8_t>(std::min<unsigned>(depth, UINT8_MAX));
+      slot->generation = m_generation;
+    }
+
+  } // namespace game
+} // namespace threes
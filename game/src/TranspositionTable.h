@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+ * Fixed memory budget cache of previously evaluated search nodes, keyed by a
+ * 64 bit hash of (board, card sequence state, move, depth).
+ *
+ * Entries are 16 bytes, grouped four to a 64 byte bucket so a probe touches
+ * a single cache line. The low bits of the key select the bucket, the high
+ * 32 bits are stored to verify a match.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace threes {
+  namespace game {
+
+    class TranspositionTable {
+    public:
+      enum ReplacementPolicy {
+	REPLACE_ALWAYS,          // one slot per key, newest entry always wins
+	REPLACE_DEPTH_PREFERRED  // any slot in the bucket, evict stale then shallow entries first
+      };
+
+      struct Entry {
+	double value;
+	uint32_t check;      // high 32 bits of the key
+	uint16_t count;      // number of samples averaged in to value, 0 means empty
+	uint8_t depth;       // remaining search depth below this node
+	uint8_t generation;  // search (move) number this entry was written in
+      };
+
+      static ReplacementPolicy policyFromStr(const std::string& name);
+
+    public:
+      TranspositionTable(const size_t budgetBytes,
+			 const ReplacementPolicy policy = REPLACE_DEPTH_PREFERRED,
+			 const bool useHugePages = false);
+      ~TranspositionTable();
+
+      TranspositionTable(const TranspositionTable&) = delete;
+      TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    public:
+      // returns the entry stored for key or nullptr, counts a hit or miss
+      const Entry* probe(const uint64_t key);
+
+      void store(const uint64_t key, const unsigned depth,
+		 const double value, const unsigned count);
+
+      // call once per root search, lets replacement prefer recent entries
+      void newSearch() { ++m_generation; }
+
+      void clear();
+
+    public:
+      size_t numEntries() const { return m_numBuckets * BucketSize; }
+      size_t sizeBytes() const { return m_numBuckets * sizeof(Bucket); }
+      bool hugePages() const { return m_hugePages; }
+
+      uint64_t hits() const { return m_hits; }
+      uint64_t misses() const { return m_misses; }
+      uint64_t stores() const { return m_stores; }
+      uint64_t evictions() const { return m_evictions; }
+
+    private:
+      static constexpr unsigned BucketSize = 4;
+      struct alignas(64) Bucket {
+	Entry entries[BucketSize];
+      };
+
+      Bucket& bucketFor(const uint64_t key) { return m_buckets[key & (m_numBuckets-1)]; }
+      static uint32_t checkFor(const uint64_t key) { return static_cast<uint32_t>(key >> 32); }
+
+      Entry* chooseSlot(Bucket& bucket, const uint32_t check, const unsigned depth);
+
+    private:
+      const ReplacementPolicy m_policy;
+      size_t m_numBuckets;
+      Bucket* m_buckets;
+      char* m_rawAlloc; // only set when mmap is unavailable
+      bool m_mmapped;
+      bool m_hugePages;
+      uint8_t m_generation;
+
+      uint64_t m_hits;
+      uint64_t m_misses;
+      uint64_t m_stores;
+      uint64_t m_evictions;
+    };
+
+  } // namespace game
+} // namespace threes
@@ -4,37 +4,184 @@
 #include "CardSequence.h"
 
 #include "GameDriverStrategy.h"
-
+#include "Hashing.h"
+#include "LineEvaluator.h"
+#include "NTupleNetwork.h"
+#include "SearchArena.h"
+#include "TranspositionTable.h"
+
+#include <chrono>
+#include <cmath>
 #include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace threes {
   namespace game {
 
+
+    // Settings for ExpectiMaxTree. The args string is "depth;samples" followed
+    // by optional ';' delimited key=value settings:
+    //   tt=<MB>               transposition table memory budget, 0 (default) disables it
+    //   ttpolicy=depth|always transposition table replacement policy
+    //   hugepages             back the transposition table with huge pages if possible
+    //   exact                 true expectimax: enumerate every insertion slot and
+    //                         drawn card with its probability instead of sampling,
+    //                         and take the best move at every player node. samples
+    //                         is ignored.
+    //   prune                 exact search with Star1/Star2 cutoffs at chance nodes,
+    //                         using valueBounds(). Plays the same moves as exact.
+    //   timems=<ms>           anytime mode: deepen one ply at a time, up to depth,
+    //   nodes=<N>             until either budget runs out, and play the best move
+    //                         of the deepest completed iteration. Either or both
+    //                         may be given; depth 1 always completes.
+    //   eval=heuristic|lut|ntuple
+    //                         leaf evaluator: valueFunction's board scan (default),
+    //                         the line lookup tables in LineEvaluator.h, or an
+    //                         NTupleNetwork (the last two 4x4 only)
+    //   weights=<file>        saved NTupleNetwork for eval=ntuple, e.g. from train_ntuple
+    struct ExpectiMaxConfig {
+      ExpectiMaxConfig(const unsigned depthIn, const unsigned samplesIn)
+	: depth(depthIn)
+	, samples(samplesIn)
+	, exact(false)
+	, prune(false)
+	, lookupEval(false)
+	, ntupleEval(false)
+	, ttMegabytes(0)
+	, ttPolicy(TranspositionTable::REPLACE_DEPTH_PREFERRED)
+	, ttHugePages(false)
+	, timeBudgetMs(0.0)
+	, nodeBudget(0)
+	{}
+
+      bool anytime() const { return timeBudgetMs > 0.0 || nodeBudget > 0; }
+
+      static ExpectiMaxConfig fromStr(const std::string& args) {
+	auto argv = ro::strsplit( args, ";" );
+	ASSERT(argv.size() >= 2,
+	       "Need two ';' delimited args for ExpectiMaxTree (depth and num samples)!");
+
+	ExpectiMaxConfig config(std::stoi(argv[0]), std::stoi(argv[1]));
+	auto opts = ro::parseKeyValues( std::vector<std::string>(argv.begin()+2, argv.end()) );
+	for(const auto& opt : opts) {
+	  if     (opt.first == "tt"       ) { config.ttMegabytes = std::stoul(opt.second); }
+	  else if(opt.first == "ttpolicy" ) { config.ttPolicy = TranspositionTable::policyFromStr(opt.second); }
+	  else if(opt.first == "hugepages") { config.ttHugePages = (opt.second != "0"); }
+	  else if(opt.first == "exact"    ) { config.exact = (opt.second != "0"); }
+	  else if(opt.first == "prune"    ) { config.prune = (opt.second != "0"); }
+	  else if(opt.first == "timems"   ) { config.timeBudgetMs = std::stod(opt.second); }
+	  else if(opt.first == "nodes"    ) { config.nodeBudget = std::stoull(opt.second); }
+	  else if(opt.first == "eval"     ) {
+	    ASSERT(opt.second == "heuristic" || opt.second == "lut" || opt.second == "ntuple",
+		   std::string("unknown ExpectiMaxTree evaluator ") + opt.second);
+	    config.lookupEval = (opt.second == "lut");
+	    config.ntupleEval = (opt.second == "ntuple");
+	  }
+	  else if(opt.first == "weights"  ) { config.ntupleWeights = opt.second; }
+	  else { ASSERT(false, std::string("unknown ExpectiMaxTree setting ") + opt.first); }
+	}
+	ASSERT(config.depth > 0 || !config.anytime(), "anytime search needs a max depth of at least 1");
+	ASSERT(!config.ntupleEval || !config.ntupleWeights.empty(), "eval=ntuple needs a weights=<file>");
+	// bounds only mean something against exact probabilities
+	if(config.prune) { config.exact = true; }
+	return config;
+      }
+
+      unsigned depth;
+      unsigned samples;
+      bool exact;
+      bool prune;
+      bool lookupEval;
+      bool ntupleEval;
+      std::string ntupleWeights;
+
+      size_t ttMegabytes;
+      TranspositionTable::ReplacementPolicy ttPolicy;
+      bool ttHugePages;
+
+      double timeBudgetMs;
+      uint64_t nodeBudget;
+    };
+
+
+    // The range a search node's value is wanted in. A node whose value turns
+    // out to be below alpha or above beta may stop early and return a bound
+    // instead. tol is how far past alpha/beta a bound has to be before it
+    // prunes anything, so rounding can't flip a decision.
+    struct SearchWindow {
+      double alpha;
+      double beta;
+      double tol;
+
+      static SearchWindow full() {
+	return SearchWindow{ -std::numeric_limits<double>::infinity(),
+			     std::numeric_limits<double>::infinity(), 0.0 };
+      }
+    };
     
     template<class BOARD>
     class ExpectiMaxTree : public IThreesStgy<BOARD> {
     public:
 
       ExpectiMaxTree(const unsigned depth, const unsigned samples)
-	: m_depth(depth)
-	, m_samples(samples)
+	: ExpectiMaxTree(ExpectiMaxConfig(depth, samples))
 	{}
+
+      explicit ExpectiMaxTree(const ExpectiMaxConfig& config)
+	: m_depth(config.depth)
+	, m_samples(config.exact ? 1 : config.samples)
+	, m_exact(config.exact)
+	, m_prune(config.prune)
+	, m_lookupEval(config.lookupEval)
+	, m_anytime(config.anytime())
+	, m_timeBudget(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			 std::chrono::duration<double, std::milli>(config.timeBudgetMs)))
+	, m_nodeBudget(config.nodeBudget)
+	, m_arena(config.depth)
+	, m_tt( config.ttMegabytes > 0 ?
+		new TranspositionTable(config.ttMegabytes << 20, config.ttPolicy, config.ttHugePages) :
+		nullptr )
+	, m_rootDepth(config.depth)
+	, m_nodes(0)
+	, m_cutoffs(0)
+	, m_prunedNodes(0)
+	, m_nextClockCheck(0)
+	, m_enforceBudget(false)
+	, m_outOfBudget(false)
+	, m_completedDepth(0)
+	{
+	  // the most children a chance node can have, so scoring a leaf layer
+	  // never allocates
+	  const size_t maxLeaves = SearchArena<BOARD>::OutcomeReserve * BOARD::dim;
+	  m_leaves.reserve(maxLeaves);
+	  m_leafOdds.reserve(maxLeaves);
+	  m_leafValues.reserve(maxLeaves);
+	  m_leafPacked.reserve(maxLeaves);
+	  m_leafMaxCards.reserve(maxLeaves);
+	  ASSERT(!m_lookupEval || BOARD::dim == 4, "eval=lut needs a 4x4 board");
+	  if(config.ntupleEval) {
+	    ASSERT(BOARD::dim == 4, "eval=ntuple needs a 4x4 board");
+	    m_net = NTupleNetwork::load(config.ntupleWeights);
+	    ASSERT(m_net, std::string("couldn't load n-tuple weights from ") + config.ntupleWeights);
+	  }
+	}
       
       static typename IThreesStgy<BOARD>::ThreesStgyPtr create(const std::string& args) {
-	auto argv = ro::strsplit( args, ";" );
-	ASSERT(argv.size() == 2,
-	       "Need two ';' delimited args for ExpectiMaxTree (depth and num samples)!");
-
-	const unsigned   depth(std::stoi(argv[0]));
-	const unsigned samples(std::stoi(argv[1]));
-	
-	return typename IThreesStgy<BOARD>::ThreesStgyPtr( new ExpectiMaxTree(depth, samples) );
+	return typename IThreesStgy<BOARD>::ThreesStgyPtr(
+	  new ExpectiMaxTree(ExpectiMaxConfig::fromStr(args)) );
       }
 
       
       virtual ShiftDirection move(const typename GameDriver<BOARD>::BoardPtr& boardPtr,
 				  const typename ICardSequence<BOARD>::ICardSeqPtr& seqPtr) override;
+
+      // cached values came from another game's samples, start clean
+      virtual void seed(const uint64_t seed) override {
+	IThreesStgy<BOARD>::seed(seed);
+	if(m_tt) { m_tt->clear(); }
+      }
     public:
 
       static std::array<unsigned, 3> getTopThreeValues(const typename BOARD::storage_t& rawBoardData);
@@ -47,13 +194,123 @@ namespace threes {
       // some ideas for value functions here
       // https://nbickford.wordpress.com/2014/04/18/how-to-beat-threes-and-2048/
       virtual double valueFunction(const BOARD& board);
+
+      // Lower/upper bounds on valueFunction for every leaf up to depth moves
+      // below board, 0 (no moves left) included. Pruning trusts these, so a
+      // subclass with its own valueFunction must override them to match.
+      virtual std::pair<double, double> valueBounds(const BOARD& board, const unsigned depth);
+
+      // valueFunction of n boards in to out, which exact search uses for
+      // the last layer of the tree. eval=lut scores them with the vector
+      // kernel in LineEvaluator.h, otherwise this calls valueFunction for
+      // each, so a subclass overriding just valueFunction still works.
+      virtual void valueFunctionBatch(const BOARD* boards, const size_t n, double* out);
 	
       double expectedValue( const BOARD& board, const ICardSequence<BOARD>& seq,
 			    const ShiftDirection move, const unsigned depth );
 
+      // nullptr unless a transposition table was configured
+      const TranspositionTable* transpositionTable() const { return m_tt.get(); }
+
+      // about the last call to move(): nodes visited (every expectedValue
+      // call) and the depth the chosen move was searched to. stats() has
+      // the same and more, summed over every move.
+      uint64_t lastSearchNodes() const { return m_nodes; }
+      unsigned lastSearchDepth() const { return m_completedDepth; }
+      // prune mode only: cutoffs taken, and children they skipped
+      uint64_t lastSearchCutoffs() const { return m_cutoffs; }
+      uint64_t lastSearchPrunedNodes() const { return m_prunedNodes; }
+
+    private:
+      // one random playout of depth moves below (board, seq, move)
+      double sampleExpectedValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+				  const ShiftDirection move, const unsigned depth );
+
+      // expectedValue within window, exact says whether the result is the
+      // node's real value or just a bound from a cutoff
+      double chanceValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+			  const ShiftDirection move, const unsigned depth,
+			  const SearchWindow& window, bool& exact );
+
+      // probability weighted value of every outcome of (board, seq, move)
+      double exactExpectedValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+				 const ShiftDirection move, const unsigned depth,
+				 const SearchWindow& window, bool& exact );
+
+      // exactExpectedValue at depth 1, where every child's value is its
+      // leaf value (or 0 if it has no moves), scoring the leaves as one batch
+      double leafLayerValue( const BOARD& shifted, const ICardSequence<BOARD>& seq,
+			     const ShiftDirection move, const unsigned slots,
+			     const typename ICardSequence<BOARD>::BoardPtrType& board );
+
+      // best move's value for the player at board, probe is an already
+      // searched move (Star2) that doesn't need searching again
+      double playerValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+			  const unsigned depth, const SearchWindow& window,
+			  const ChildProbe& probe, bool& exact );
+
+      // root value of move at depth, summed over m_samples, alpha is the
+      // best root value so far (prune mode)
+      double rootValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+			const ShiftDirection move, const unsigned depth,
+			const double alpha = std::numeric_limits<double>::lowest() );
+
+      // iterative deepening driver for the anytime mode
+      ShiftDirection anytimeMove( const BOARD& board, const ICardSequence<BOARD>& seq );
+
+      // once this returns true the current iteration's values are garbage
+      bool outOfBudget() {
+	if(!m_enforceBudget || m_outOfBudget) { return m_outOfBudget; }
+	if(m_nodeBudget > 0 && m_nodes >= m_nodeBudget) {
+	  m_outOfBudget = true;
+	}
+	// reading the clock costs more than a node, only look now and then
+	else if(m_timeBudget.count() > 0 && m_nodes >= m_nextClockCheck) {
+	  m_nextClockCheck = m_nodes + 64;
+	  m_outOfBudget = (std::chrono::steady_clock::now() >= m_deadline);
+	}
+	return m_outOfBudget;
+      }
+
+      static uint64_t nodeKey( const BOARD& board, const ICardSequence<BOARD>& seq,
+			       const ShiftDirection move, const unsigned depth ) {
+	const ZobristKeys& keys = zobristKeys();
+	const uint64_t boardKey = hashBoard(board) ^ keys.move[move] ^
+	  keys.depth[std::min(depth, ZobristKeys::MaxDepth-1)];
+	return hashCombine(boardKey, seq.hash());
+      }
+
     private:
       const unsigned m_depth;
       const unsigned m_samples;
+      const bool m_exact;
+      const bool m_prune;
+      const bool m_lookupEval;
+      NTupleNetwork::NTupleNetworkPtr m_net; // eval=ntuple
+      const bool m_anytime;
+      const std::chrono::steady_clock::duration m_timeBudget;
+      const uint64_t m_nodeBudget;
+      // boards and sequences the search works on, reused from move to move
+      SearchArena<BOARD> m_arena;
+      std::unique_ptr<TranspositionTable> m_tt;
+      // the leaf layer being scored, one array per field; leafLayerValue
+      // doesn't recurse, so one set serves the whole search
+      std::vector<BOARD> m_leaves;
+      std::vector<double> m_leafOdds;
+      std::vector<double> m_leafValues;
+      std::vector<uint64_t> m_leafPacked;
+      std::vector<uint32_t> m_leafMaxCards;
+
+      // per search state
+      unsigned m_rootDepth; // depth of the current root search, for stats by ply
+      uint64_t m_nodes;
+      uint64_t m_cutoffs;
+      uint64_t m_prunedNodes;
+      std::chrono::steady_clock::time_point m_deadline;
+      uint64_t m_nextClockCheck;
+      bool m_enforceBudget;
+      bool m_outOfBudget;
+      unsigned m_completedDepth;
       
     }; // class ExpectiMaxTree
 
@@ -70,16 +327,24 @@ namespace threes {
 	static constexpr std::array<ShiftDirection, NUM_DIRECTIONS>
 	  candidateMoves{ DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT};
 
+	if(m_tt) { m_tt->newSearch(); }
+	m_nodes = 0;
+	m_cutoffs = 0;
+	m_prunedNodes = 0;
+
+	if(m_anytime) {
+	  return anytimeMove(*(boardPtr.get()), *(seqPtr.get()));
+	}
+	m_completedDepth = m_depth;
+
 	double bestEv(std::numeric_limits<double>::lowest());
 	ShiftDirection bestDir(DIRECTION_UP);
 	bool anyValid=false;
+	const MoveSet moves = boardPtr->moves();
 	for(auto move : candidateMoves) {
-	  if( boardPtr->canShift(move) ) {
+	  if( moves.canShift(move) ) {
 	      anyValid = true;
-	      double accum = 0;
-	      for(unsigned i=0; i < m_samples; ++i ) {
-		accum += expectedValue(*(boardPtr.get()), *(seqPtr.get()), move, m_depth);
-	      }
+	      const double accum = rootValue(*(boardPtr.get()), *(seqPtr.get()), move, m_depth, bestEv);
 
 	      if( accum > bestEv ) {
 		bestEv = accum;
@@ -89,45 +354,174 @@ namespace threes {
 	}
 
 	ASSERT(anyValid, "forced to pick a move, but there are no valid ones!");
+	(void)anyValid; // only read by ASSERT
 	
 	return(bestDir);
     }
 
+    template<class BOARD>
+    ShiftDirection ExpectiMaxTree<BOARD>::anytimeMove( const BOARD& board,
+						       const ICardSequence<BOARD>& seq ) {
+      // moves in the order to search them, best first from the previous iteration
+      std::array<ShiftDirection, NUM_DIRECTIONS> order;
+      std::array<double, NUM_DIRECTIONS> values;
+      unsigned numMoves = 0;
+      const MoveSet moves = board.moves();
+      for(auto move : { DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT }) {
+	if( moves.canShift(move) ) { order[numMoves++] = move; }
+      }
+      ASSERT(numMoves > 0, "forced to pick a move, but there are no valid ones!");
+
+      m_deadline = std::chrono::steady_clock::now() + m_timeBudget;
+      m_nextClockCheck = 0;
+      m_outOfBudget = false;
+      m_completedDepth = 0;
+      ShiftDirection bestDir = order[0];
+
+      for(unsigned depth = 1; depth <= m_depth; ++depth) {
+	// always finish depth 1 so there's a real answer to fall back on
+	m_enforceBudget = (depth > 1);
+	// in prune mode the moves after the best are only bounded above, but
+	// that still ranks them below it
+	double bestEv(std::numeric_limits<double>::lowest());
+	for(unsigned i = 0; i < numMoves && !m_outOfBudget; ++i) {
+	  values[i] = rootValue(board, seq, order[i], depth, bestEv);
+	  bestEv = std::max(bestEv, values[i]);
+	}
+	if(m_outOfBudget) { break; }
+
+	// stable insertion sort, best first, so ties keep the previous order
+	for(unsigned i = 1; i < numMoves; ++i) {
+	  for(unsigned j = i; j > 0 && values[j] > values[j-1]; --j) {
+	    std::swap(values[j], values[j-1]);
+	    std::swap(order[j], order[j-1]);
+	  }
+	}
+	bestDir = order[0];
+	m_completedDepth = depth;
+      }
+
+      m_enforceBudget = false;
+      return bestDir;
+    }
+
+    template<class BOARD>
+    double ExpectiMaxTree<BOARD>::rootValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+					     const ShiftDirection move, const unsigned depth,
+					     const double alpha ) {
+      m_rootDepth = depth;
+      if(m_prune) {
+	// strict > picks the root move, so only beating alpha matters
+	const std::pair<double, double> bounds = valueBounds(board, depth);
+	const double scale = std::max(std::fabs(bounds.first), std::fabs(bounds.second));
+	const double tol = std::isfinite(scale) ? 1e-9 * (1.0 + scale) : 0.0;
+	bool exact;
+	return chanceValue(board, seq, move, depth,
+			   SearchWindow{alpha, std::numeric_limits<double>::infinity(), tol}, exact);
+      }
+
+      double accum = 0;
+      for(unsigned i=0; i < m_samples; ++i ) {
+	accum += expectedValue(board, seq, move, depth);
+      }
+      return accum;
+    }
     
     // implementations
     template<class BOARD>
     double ExpectiMaxTree<BOARD>::expectedValue( const BOARD& board, const ICardSequence<BOARD>& seq,
 					  const ShiftDirection move, const unsigned depth ) {
+      bool exact;
+      return chanceValue(board, seq, move, depth, SearchWindow::full(), exact);
+    }
+
+    template<class BOARD>
+    double ExpectiMaxTree<BOARD>::chanceValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+					       const ShiftDirection move, const unsigned depth,
+					       const SearchWindow& window, bool& exact ) {
+      exact = true;
+      // the caller will throw this value away
+      if(outOfBudget()) {
+	return 0.0;
+      }
+      ++m_nodes;
+      this->m_stats.countNode(m_rootDepth > depth ? m_rootDepth - depth : 0);
 
       // recursive base case, if no more depth required, just return the
       // best guess of the value of the board
       if(depth == 0) {
+	++this->m_stats.leafEvals;
 	return(valueFunction(board));
       }
-	  
+
+      if(!m_tt) {
+	return m_exact ? exactExpectedValue(board, seq, move, depth, window, exact) :
+	  sampleExpectedValue(board, seq, move, depth);
+      }
+
+      // An exact value is a single "sample" that is already complete.
+      // Each entry keeps the running mean of the samples taken so far for
+      // its node. Once it has m_samples of them it stands in for the whole
+      // subtree; until then keep sampling and fold the new sample in.
+      const uint64_t key = nodeKey(board, seq, move, depth);
+      double prevMean(0.0);
+      unsigned prevCount(0);
+      const TranspositionTable::Entry* entry = m_tt->probe(key);
+      ++this->m_stats.cacheProbes;
+      if(entry) {
+	if(entry->count >= m_samples) {
+	  ++this->m_stats.cacheHits;
+	  return entry->value;
+	}
+	prevMean = entry->value;
+	prevCount = entry->count;
+      }
+
+      const double sample = m_exact ? exactExpectedValue(board, seq, move, depth, window, exact) :
+	sampleExpectedValue(board, seq, move, depth);
+      // an unfinished subtree mustn't be cached, nor a bound from a cutoff
+      if(m_outOfBudget) { return 0.0; }
+      if(!exact) { return sample; }
+      const unsigned count = prevCount + 1;
+      m_tt->store(key, depth, prevMean + (sample - prevMean)/count, count);
+      return sample;
+    }
+
+    template<class BOARD>
+    double ExpectiMaxTree<BOARD>::sampleExpectedValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+						       const ShiftDirection move, const unsigned depth ) {
       static constexpr std::array<ShiftDirection, NUM_DIRECTIONS>
 	candidateMoves{ DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT};
 	  
       //   copy state to state'
-      typename GameDriver<BOARD>::BoardPtr boardCopy(new BOARD(board));
-      typename ICardSequence<BOARD>::ICardSeqPtr seqCopy(seq.clone());
+      typename SearchArena<BOARD>::Frame& frame = m_arena.frame(depth, board, seq);
+      const typename GameDriver<BOARD>::BoardPtr& boardCopy = frame.board;
+      const typename ICardSequence<BOARD>::ICardSeqPtr& seqCopy = frame.seq;
+      // the copy must not replay the real game's future draws
+      seqCopy->reseed(this->m_rng());
 
-      //   update state' with move
-      ASSERT( boardCopy->canShift(move), "invalid shift request in EV calc");
+      //   update state' with move (shiftBoard checks it's valid)
       Card insertCard(seqCopy->draw(boardCopy));
-      boardCopy->shiftBoard(move, insertCard);
+      boardCopy->shiftBoard(move, insertCard, this->m_rng);
 
       // for each valid move, determine expected value
       // of that move recursively
       unsigned numValidMoves(0);
       double accumulatedScore(0.0);
+      const MoveSet moves = boardCopy->moves();
       for(auto candidateMove : candidateMoves) {
-	if( boardCopy->canShift(candidateMove) ) {
+	if( moves.canShift(candidateMove) ) {
 	  ++numValidMoves;
 	  accumulatedScore += expectedValue(*(boardCopy.get()), *(seqCopy.get()),
 					    candidateMove, depth-1);
 	}
       }
+      // one sampled outcome, then the player's moves from it
+      ++this->m_stats.chanceNodes;
+      ++this->m_stats.chanceChildren;
+      ++this->m_stats.playerNodes;
+      this->m_stats.playerChildren += numValidMoves;
+
       // todo: weird case here where no valid moves results in a score of 0... maybe that is okay?
       if(numValidMoves == 0) {
 	return(0);
@@ -136,6 +530,266 @@ namespace threes {
       return accumulatedScore / static_cast<double>(numValidMoves);
     }
 
+    // Ballard's Star1/Star2 for a chance node whose children (the board after
+    // each card/slot outcome) are player nodes. With the full window, or
+    // without prune, this is plain expectimax: every child searched in
+    // order and summed.
+    //
+    // Star1: with sum the probability weighted value of the children so far
+    // and rem the probability left, the node's value lies in
+    // [sum + rem*L, sum + rem*U]. Once that is wholly below alpha or above
+    // beta, stop. Each child gets the window that would let its parent stop.
+    //
+    // Star2: before that, when there is a beta to beat, search just the
+    // first move of every child. Each result is a lower bound on the child,
+    // which can prove the node fails high before anything is fully
+    // searched, and which tightens the Star1 lower bound.
+    template<class BOARD>
+    double ExpectiMaxTree<BOARD>::exactExpectedValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+						      const ShiftDirection move, const unsigned depth,
+						      const SearchWindow& window, bool& exact ) {
+      static constexpr std::array<ShiftDirection, NUM_DIRECTIONS>
+	candidateMoves{ DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT};
+
+      exact = true;
+
+      BOARD shifted(board);
+      const unsigned movedMask = shifted.shiftTiles(move);
+      ASSERT( movedMask != 0, "invalid shift request in EV calc");
+      const unsigned slots = shifted.insertCandidates(move, movedMask);
+      unsigned numSlots = 0;
+      for(unsigned i = 0; i < BOARD::dim; ++i) {
+	if(slots & (1u << i)) { ++numSlots; }
+      }
+      ++this->m_stats.chanceNodes;
+
+      // at depth 1 every outcome has the same children, one leaf per slot,
+      // and scoring those few is cheaper than probing for a cutoff. Only
+      // the card showing is needed, so the sequence isn't copied.
+      if(depth == 1) {
+	this->m_stats.chanceChildren += numSlots;
+	return leafLayerValue(shifted, seq, move, slots, m_arena.boardFrame(depth, board, seq).board);
+      }
+
+      // the card is drawn against the board before the move, same as a real game
+      typename SearchArena<BOARD>::Frame& frame = m_arena.frame(depth, board, seq);
+      std::vector<DrawOutcome>& outcomes = frame.outcomes;
+      seq.drawOutcomes(frame.board, outcomes);
+      const unsigned numChildren = outcomes.size() * numSlots;
+      this->m_stats.chanceChildren += numChildren;
+
+      double lower(0.0), upper(0.0);
+      if(m_prune) {
+	const std::pair<double, double> bounds = valueBounds(board, depth);
+	lower = bounds.first;
+	upper = bounds.second;
+      }
+      const bool prune = m_prune && (window.alpha > lower || window.beta < upper);
+
+      // Star2 probing pass
+      std::vector<ChildProbe>& probes = frame.probes;
+      probes.assign(numChildren, ChildProbe{0.0, DIRECTION_UP, false});
+      double probedLower(0.0);      // sum of q*(lower bound) over every child
+      if(prune && window.beta < upper) {
+	double probedSum(0.0);
+	double rem(1.0);
+	unsigned child = 0;
+	for(const auto& outcome : outcomes) {
+	  m_arena.copySeq(depth, seq);
+	  const Card insertCard = frame.seq->drawOutcome(frame.board, outcome);
+	  const double q = outcome.probability / numSlots;
+
+	  for(unsigned slot = 0; slot < BOARD::dim; ++slot) {
+	    if( !(slots & (1u << slot)) ) { continue; }
+	    BOARD childBoard(shifted);
+	    childBoard.insertCard(move, slot, insertCard);
+	    rem -= q;
+
+	    ChildProbe& probe = probes[child++];
+	    probe.value = 0.0; // no moves left, exact
+	    probe.known = true;
+	    const MoveSet childMoves = childBoard.moves();
+	    for(auto candidateMove : candidateMoves) {
+	      if( !childMoves.canShift(candidateMove) ) { continue; }
+	      const SearchWindow probeWindow{ -std::numeric_limits<double>::infinity(),
+					      (window.beta - probedSum - rem*lower) / q,
+					      2.0 * window.tol / q };
+	      bool probeExact;
+	      probe.value = chanceValue(childBoard, *frame.seq, candidateMove, depth-1,
+					probeWindow, probeExact);
+	      probe.move = candidateMove;
+	      // a fail high result is still a valid lower bound, just not reusable
+	      probe.known = probeExact;
+	      break;
+	    }
+	    probedSum += q * probe.value;
+
+	    if(probedSum + rem*lower > window.beta + window.tol) {
+	      ++m_cutoffs;
+	      m_prunedNodes += numChildren - child;
+	      exact = false;
+	      return probedSum + rem*lower;
+	    }
+	  }
+	}
+	probedLower = probedSum;
+      } else {
+	probedLower = lower; // every child is at least lower
+	for(auto& probe : probes) { probe.value = lower; }
+      }
+
+      // Star1 pass, or plain expectimax without prune
+      double accumulatedScore(0.0);
+      double rem(1.0);
+      double remLower(probedLower);
+      unsigned child = 0;
+      bool allExact = true;
+      for(const auto& outcome : outcomes) {
+	m_arena.copySeq(depth, seq);
+	const Card insertCard = frame.seq->drawOutcome(frame.board, outcome);
+	const double slotOdds = outcome.probability / numSlots;
+
+	for(unsigned slot = 0; slot < BOARD::dim; ++slot) {
+	  if( !(slots & (1u << slot)) ) { continue; }
+	  BOARD childBoard(shifted);
+	  childBoard.insertCard(move, slot, insertCard);
+	  const ChildProbe& probe = probes[child++];
+
+	  SearchWindow childWindow = SearchWindow::full();
+	  if(prune) {
+	    rem -= slotOdds;
+	    remLower -= slotOdds * probe.value;
+	    childWindow = SearchWindow{ (window.alpha - accumulatedScore - rem*upper) / slotOdds,
+					(window.beta - accumulatedScore - remLower) / slotOdds,
+					2.0 * window.tol / slotOdds };
+	  }
+
+	  // player nodes take the best move; no moves left is worth 0
+	  bool childExact;
+	  const double best = playerValue(childBoard, *frame.seq, depth-1, childWindow, probe, childExact);
+	  accumulatedScore += slotOdds * best;
+	  allExact = allExact && childExact;
+
+	  if(prune) {
+	    if(accumulatedScore + rem*upper < window.alpha - window.tol) {
+	      ++m_cutoffs;
+	      m_prunedNodes += numChildren - child;
+	      exact = false;
+	      return accumulatedScore + rem*upper;
+	    }
+	    if(accumulatedScore + remLower > window.beta + window.tol) {
+	      ++m_cutoffs;
+	      m_prunedNodes += numChildren - child;
+	      exact = false;
+	      return accumulatedScore + remLower;
+	    }
+	  }
+	}
+      }
+      exact = allExact;
+      return accumulatedScore;
+    }
+
+    template<class BOARD>
+    double ExpectiMaxTree<BOARD>::leafLayerValue( const BOARD& shifted, const ICardSequence<BOARD>& seq,
+						  const ShiftDirection move, const unsigned slots,
+						  const typename ICardSequence<BOARD>::BoardPtrType& board ) {
+      unsigned numSlots = 0;
+      for(unsigned i = 0; i < BOARD::dim; ++i) {
+	if(slots & (1u << i)) { ++numSlots; }
+      }
+      const unsigned leafPly = m_rootDepth; // depth 0 nodes
+
+      // every outcome inserts the same card, the one already showing; they
+      // only differ in the sequence left behind, which a leaf's value
+      // doesn't read. So each slot is one leaf, and as the outcomes' odds
+      // sum to 1 it is worth 1/numSlots.
+      const Card insertCard = seq.peek(board);
+      const double slotOdds = 1.0 / numSlots;
+
+      // gather the children that have moves, the rest are worth 0. Each
+      // one's leaf value is what all of its moves' depth 0 nodes return,
+      // so it counts as that many nodes, the same as searching them one
+      // by one.
+      m_leaves.clear();
+      m_leafOdds.clear();
+      for(unsigned slot = 0; slot < BOARD::dim; ++slot) {
+	if( !(slots & (1u << slot)) ) { continue; }
+	m_leaves.push_back(shifted);
+	BOARD& childBoard = m_leaves.back();
+	childBoard.insertCard(move, slot, insertCard);
+
+	const unsigned numMoves = childBoard.moves().count();
+	++this->m_stats.playerNodes;
+	this->m_stats.playerChildren += numMoves;
+	m_nodes += numMoves;
+	this->m_stats.nodesPerPly[std::min(leafPly, SearchStats::MaxPly-1)] += numMoves;
+	// the caller will throw this value away
+	if(outOfBudget()) { return 0.0; }
+
+	if(numMoves == 0) {
+	  m_leaves.pop_back();
+	} else {
+	  m_leafOdds.push_back(slotOdds);
+	}
+      }
+
+      m_leafValues.resize(m_leaves.size());
+      valueFunctionBatch(m_leaves.data(), m_leaves.size(), m_leafValues.data());
+      this->m_stats.leafEvals += m_leaves.size();
+
+      double accumulatedScore(0.0);
+      for(size_t i = 0; i < m_leaves.size(); ++i) {
+	accumulatedScore += m_leafOdds[i] * m_leafValues[i];
+      }
+      return accumulatedScore;
+    }
+
+    template<class BOARD>
+    double ExpectiMaxTree<BOARD>::playerValue( const BOARD& board, const ICardSequence<BOARD>& seq,
+					       const unsigned depth, const SearchWindow& window,
+					       const ChildProbe& probe, bool& exact ) {
+      static constexpr std::array<ShiftDirection, NUM_DIRECTIONS>
+	candidateMoves{ DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT};
+
+      // the probe was the first valid move, so carrying on from it visits
+      // the moves in the same order as a fresh search
+      bool anyValid(m_prune && probe.known);
+      double best(anyValid ? probe.value : 0.0);
+      bool bestExact(true);
+      const MoveSet moves = board.moves();
+      unsigned movesLeft = moves.count();
+      ++this->m_stats.playerNodes;
+      this->m_stats.playerChildren += movesLeft;
+      if(anyValid) { --movesLeft; }
+
+      for(auto candidateMove : candidateMoves) {
+	if( !moves.canShift(candidateMove) ) { continue; }
+	if( m_prune && probe.known && candidateMove == probe.move ) { continue; }
+	--movesLeft;
+
+	const SearchWindow childWindow{ anyValid ? std::max(window.alpha, best) : window.alpha,
+					window.beta, window.tol };
+	bool childExact;
+	const double value = chanceValue(board, seq, candidateMove, depth, childWindow, childExact);
+	if(!anyValid || value > best) {
+	  best = value;
+	  bestExact = childExact;
+	}
+	anyValid = true;
+
+	if(m_prune && best > window.beta + window.tol) {
+	  ++m_cutoffs;
+	  m_prunedNodes += movesLeft;
+	  exact = false;
+	  return best;
+	}
+      }
+
+      exact = bestExact;
+      return best;
+    }
+
     //////////////////////////////////////
     
     template<class BOARD>
@@ -154,70 +808,104 @@ namespace threes {
 	 if they’re next to a wall and are next to a card of the second-largest size.
 	 The largest card gets a +3 bonus if it’s next to one wall, or a +6 bonus if it’s in a corner.
       */
+      if(m_lookupEval) {
+	return lineLookupValue(board);
+      }
+      if(m_net) {
+	return m_net->value(packedTiles(board));
+      }
+
       double score(board.maxCard().value);
-      auto rawBoardData(board.underlyingDataRef());
-      const std::array<unsigned, 3> topThree( getTopThreeValues( rawBoardData ) );
 
-      // check for empties everywhere
-      for( auto card : rawBoardData ) {
-	if(card.value == 0) { score += 3.0; }
-      }
+      // every empty space is worth 3
+      score += 3.0 * board.numEmpty();
+
+      // adjacent pairs and trapped cards only depend on their own row or
+      // column, the board keeps those scores per line
+      score += board.lineScores();
+
+      // bonuses for where the largest three cards are, from the tiles
+      // holding each of them
+      using Masks = TileMasks<BOARD::dim>;
+      const std::array<unsigned, 3> topThree( board.topThreeValues() );
+      auto tilesWithValue = [&board](const unsigned value) -> tile_mask_t {
+	return value == 0 ? 0 : board.rankMask(cardRank(Card(value)));
+      };
+      const tile_mask_t third   = tilesWithValue(topThree[0]);
+      const tile_mask_t second  = tilesWithValue(topThree[1]);
+      const tile_mask_t largest = tilesWithValue(topThree[2]);
+      // third largest next to a wall and the second largest
+      score += countTiles(third & Masks::wall() & Masks::neighbours(second));
+      // second largest next to a wall, and next to the largest
+      score += countTiles(second & Masks::wall());
+      score += countTiles(second & Masks::neighbours(largest));
+      // largest in a corner, or else against a wall
+      score += 6.0 * countTiles(largest & Masks::corner());
+      score += 3.0 * countTiles(largest & Masks::wall() & ~Masks::corner());
+      return(score);
+    }
+    
 
-      // check matching adjacent cards, card next to card 2x its value
-      unsigned row=0, col=0;
-      for(unsigned i = 0; i < rawBoardData.size(); ++i) {
 
-	const unsigned currCardVal = rawBoardData[i].value;
-	// if current square is empty, skip all the other bonuses
-	if( currCardVal > 0) { 
+    template<class BOARD>
+    void ExpectiMaxTree<BOARD>::valueFunctionBatch(const BOARD* boards, const size_t n, double* out) {
+      if(!m_lookupEval) {
+	for(size_t i = 0; i < n; ++i) {
+	  out[i] = valueFunction(boards[i]);
+	}
+	return;
+      }
+      m_leafPacked.resize(n);
+      m_leafMaxCards.resize(n);
+      for(size_t i = 0; i < n; ++i) {
+	m_leafPacked[i] = packedTiles(boards[i]);
+	m_leafMaxCards[i] = boards[i].maxCard().value;
+      }
+      lineLookupValues(m_leafPacked.data(), m_leafMaxCards.data(), n, out);
+    }
+
+    template<class BOARD>
+    std::pair<double, double> ExpectiMaxTree<BOARD>::valueBounds(const BOARD& board, const unsigned depth) {
+      // a learned network can return anything
+      if(m_net) {
+	return std::make_pair(-std::numeric_limits<double>::infinity(),
+			      std::numeric_limits<double>::infinity());
+      }
 
-	  // check down+right so as to not double count
-	  if( currCardVal > 2 ) {
-	    if( col < BOARD::dim - 1) { // check across columns
-	      const unsigned neighborCardVal = rawBoardData[i+1].value;
-	      score += addScoreLogic(currCardVal, neighborCardVal);
-	    }
-	    if( row < BOARD::dim - 1) { // check across rows
-	      const unsigned neighborCardVal = rawBoardData[i+BOARD::dim].value;
-	      score += addScoreLogic(currCardVal, neighborCardVal);
-	    }
-	  }
-	  //
-	  // "Trapped" penalties
-	  const bool trappedLeft (col == 0            || rawBoardData[i-1].value > currCardVal);
-	  const bool trappedRight(col == BOARD::dim-1 || rawBoardData[i+1].value > currCardVal);
-	  const bool trappedAbove(row == 0            || rawBoardData[i-BOARD::dim].value > currCardVal);
-	  const bool trappedBelow(row == BOARD::dim-1 || rawBoardData[i+BOARD::dim].value > currCardVal);
-
-	  if( trappedLeft  && trappedRight ) { score -= 5.0; }
-	  if( trappedAbove && trappedBelow ) { score -= 5.0; }
-	  //
-	  // extra bonuses for largest/second largest/third largest special conditions
-	  const bool nextToWall = (row == 0 || col == 0 || row == BOARD::dim-1 || col == BOARD::dim-1);
-	  const bool inCorner   = ((row == 0 || row == BOARD::dim-1) &&
-				   (col == 0 || col == BOARD::dim-1)   );
-	  if( currCardVal == topThree[0] && nextToWall ) { // third largest
-	    if(nextToOtherVal(row, col, topThree[1], rawBoardData)) { score += 1.0; }
+      static constexpr double N = BOARD::dim;
+
+      // every term but the max card, see valueFunction: up to 3 per empty
+      // square, 2 per adjacent pair, 6 per card in bonuses, and down to -10
+      // per card for being trapped both ways. The line lookup evaluator is
+      // the same less the bonuses, so the same bounds hold.
+      static constexpr double otherMax = 3.0*N*N + 2.0*2.0*N*(N-1) + 6.0*N*N;
+      static constexpr double otherMin = -10.0*N*N;
+
+      // The max card never drops. The next move can at most make the largest
+      // mergeable pair on the board (or insert a card no bigger than the
+      // max), and after that each move can at most double it.
+      unsigned maxTile = std::max(board.maxCard().value, 3u);
+      unsigned bestMerge = 0;
+      for(unsigned row = 0; row < BOARD::dim; ++row) {
+	for(unsigned col = 0; col < BOARD::dim; ++col) {
+	  const Card card = board.cardAtIndex(row, col);
+	  maxTile = std::max(maxTile, card.value);
+	  if(col+1 < BOARD::dim && card.canCombine(board.cardAtIndex(row, col+1))) {
+	    bestMerge = std::max(bestMerge, card.value + board.cardAtIndex(row, col+1).value);
 	  }
-	  else if( currCardVal == topThree[1] ) { // second largest
-	    if(nextToWall) { score += 1.0; }
-	    if(nextToOtherVal(row,col,topThree[2], rawBoardData)) { score += 1.0; }
+	  if(row+1 < BOARD::dim && card.canCombine(board.cardAtIndex(row+1, col))) {
+	    bestMerge = std::max(bestMerge, card.value + board.cardAtIndex(row+1, col).value);
 	  }
-	  else if( currCardVal == topThree[2] ) { // largest
-	    if(        inCorner ) { score += 6.0; }
-	    else if( nextToWall ) { score += 3.0; }
-	  }
-
-	} // end "if card != 0"
-	  
-	  // update the "matrix" indices
-	++col;
-	if(col == BOARD::dim) { col = 0; ++row; }
+	}
       }
-      return(score);
-    }
-    
+      double maxAfter = std::max(maxTile, bestMerge);
+      for(unsigned i = 1; i < depth; ++i) { maxAfter *= 2.0; }
+      maxAfter = std::min<double>(maxAfter, cardFromRank(S_MAX_CARD_RANK).value);
 
+      const double lower = std::min(0.0, board.maxCard().value + otherMin);
+      const double upper = std::max(0.0, maxAfter + otherMax);
+      return std::make_pair(lower, upper);
+    }
 
     template<class BOARD>
     std::array<unsigned, 3> ExpectiMaxTree<BOARD>::getTopThreeValues(const typename BOARD::storage_t& rawBoardData) {
@@ -254,20 +942,7 @@ namespace threes {
     
     template<class BOARD>
     double ExpectiMaxTree<BOARD>::addScoreLogic( const unsigned card1Val, const unsigned card2Val) {
-      double score = 0.0;
-      // exact match, check only to the right to not double count
-      if( card1Val == card2Val ) {
-	score += 2.0;
-      }
-      // next to a card twice its value
-      else if( card1Val == (2 * card2Val) ) {
-	score += 2.0;
-      }
-      // card1 is 2x next card's value
-      else if( card2Val == (2 * card1Val) ) {
-	score += 2.0;
-      }
-      return score;
+      return adjacencyPairScore(card1Val, card2Val);
     }
 
     template<class BOARD>
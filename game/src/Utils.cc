@@ -17,5 +17,19 @@ namespace ro {
     
   }
 
+  std::map<std::string, std::string> parseKeyValues(const std::vector<std::string>& tokens) {
+    std::map<std::string, std::string> result;
+    for(const std::string& token : tokens) {
+      if(token.empty()) { continue; }
+      const size_t eq = token.find('=');
+      if(eq == std::string::npos) {
+	result[token] = "1";
+      } else {
+	result[token.substr(0, eq)] = token.substr(eq+1);
+      }
+    }
+    return result;
+  }
+
 
 } // ns ro
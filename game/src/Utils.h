@@ -73,5 +73,9 @@ namespace ro {
 
 
   std::vector<std::string> strsplit(const std::string& str, const std::string& delim);
+
+  // parse "key=value" tokens (e.g. the tail of a strsplit config string) in
+  // to a map. A bare "key" maps to "1" so flags can be written without a value.
+  std::map<std::string, std::string> parseKeyValues(const std::vector<std::string>& tokens);
   
 } // ns ro
@@ -3,7 +3,9 @@
 #include <src/Card.h>
 #include <gtest/gtest.h>
 
+#include <cstring>
 #include <set>
+#include <type_traits>
 
 using Card = threes::game::Card;
 
@@ -94,3 +96,121 @@ TEST(DefaultBonusGen, BonusCardTests) {
   
 }
 
+
+TEST(CardSequenceK28, DrawOutcomes) {
+  using BoardType = threes::game::Board<4>;
+  using SeqType = threes::game::Kamikaze28Sequence<BoardType>;
+  std::unique_ptr<BoardType> noBonusBoard = std::make_unique<BoardType>(
+    std::vector<Card>{Card(3)}, std::vector<unsigned>{0});
+
+  SeqType seq(threes::game::threesDefaultShuffleDeck());
+  seq.seed(7);
+  const Card next = seq.peek(noBonusBoard);
+
+  // one card of the 12 is already dealt as next, so its value is less likely
+  std::vector<threes::game::DrawOutcome> outcomes;
+  seq.drawOutcomes(noBonusBoard, outcomes);
+  ASSERT_EQ( 3u, outcomes.size() );
+  double total = 0.0;
+  for(const auto& outcome : outcomes) {
+    EXPECT_FALSE( outcome.bonus );
+    EXPECT_DOUBLE_EQ( (outcome.next == next ? 3.0 : 4.0) / 11.0, outcome.probability );
+    total += outcome.probability;
+  }
+  EXPECT_DOUBLE_EQ( 1.0, total );
+
+  // fixing the outcome behaves like a draw that happened to pick it
+  auto seqCopy = seq.clone();
+  EXPECT_EQ( next, seqCopy->drawOutcome(noBonusBoard, outcomes[1]) );
+  EXPECT_EQ( outcomes[1].next, seqCopy->peek(noBonusBoard) );
+
+  // a board at 96 adds the 6 and 12 bonus cards
+  BoardType::storage_t bonusTiles{};
+  bonusTiles[0] = Card(96);
+  std::unique_ptr<BoardType> bonusBoard = std::make_unique<BoardType>(bonusTiles);
+  seq.drawOutcomes(bonusBoard, outcomes);
+  ASSERT_EQ( 5u, outcomes.size() );
+  total = 0.0;
+  double bonusTotal = 0.0;
+  for(const auto& outcome : outcomes) {
+    total += outcome.probability;
+    if(outcome.bonus) {
+      EXPECT_TRUE( outcome.next == Card(6) || outcome.next == Card(12) );
+      bonusTotal += outcome.probability;
+    }
+  }
+  EXPECT_DOUBLE_EQ( 1.0, total );
+  EXPECT_DOUBLE_EQ( 1.0/21.0, bonusTotal );
+
+  // an in order deck only ever has one outcome
+  SeqType ordered(threes::game::oneTwoThreeDeck(), threes::game::alwaysReturnNextIndex,
+		  threes::game::alwaysFalse< std::unique_ptr<BoardType> >,
+		  threes::game::nextIndexOdds,
+		  threes::game::neverBonusOdds< std::unique_ptr<BoardType> >);
+  ordered.drawOutcomes(bonusBoard, outcomes);
+  ASSERT_EQ( 1u, outcomes.size() );
+  EXPECT_EQ( Card(2), outcomes[0].next );
+  EXPECT_DOUBLE_EQ( 1.0, outcomes[0].probability );
+}
+
+TEST(CardSequenceK28, CommonRandomDeals) {
+  using BoardType = threes::game::Board<4>;
+  using SeqType = threes::game::Kamikaze28Sequence<BoardType>;
+  std::unique_ptr<BoardType> noBonusBoard = std::make_unique<BoardType>(
+    std::vector<Card>{Card(3)}, std::vector<unsigned>{0});
+  BoardType::storage_t bonusTiles{};
+  bonusTiles[0] = Card(96);
+  std::unique_ptr<BoardType> bonusBoard = std::make_unique<BoardType>(bonusTiles);
+
+  // one game never gets bonus cards, the other does now and then
+  SeqType plain(threes::game::threesDefaultShuffleDeck());
+  SeqType bonus(threes::game::threesDefaultShuffleDeck());
+  plain.seed(5);
+  bonus.seed(5);
+  std::vector<Card> plainDealt, bonusDealt;
+  unsigned numBonus = 0;
+  for(unsigned drawIdx = 0; drawIdx < 200; ++drawIdx) {
+    plain.reseedCommon(17, drawIdx);
+    plainDealt.push_back(plain.draw(noBonusBoard));
+    bonus.reseedCommon(17, drawIdx);
+    const Card card = bonus.draw(bonusBoard);
+    if(card.value > 3) { ++numBonus; } else { bonusDealt.push_back(card); }
+  }
+  ASSERT_GT( numBonus, 0u );
+
+  // the deck still deals the same cards in the same order
+  ASSERT_EQ( plainDealt.size(), bonusDealt.size() + numBonus );
+  EXPECT_TRUE( std::equal(bonusDealt.begin(), bonusDealt.end(), plainDealt.begin()) );
+}
+
+TEST(CardSequenceK28, StateCopies) {
+  using BoardType = threes::game::Board<4>;
+  using SeqType = threes::game::Kamikaze28Sequence<BoardType>;
+  static_assert(std::is_trivially_copyable<SeqType::State>::value, "state should copy as bytes");
+  std::unique_ptr<BoardType> board = std::make_unique<BoardType>(
+    std::vector<Card>{Card(3)}, std::vector<unsigned>{0});
+
+  SeqType seq(threes::game::threesDefaultShuffleDeck());
+  seq.seed(11);
+  for(unsigned i = 0; i < 5; ++i) { seq.draw(board); }
+  // a fresh deck of 12 with 5 dealt, plus the next card
+  EXPECT_EQ( 6u, seq.state().numRemaining() );
+  EXPECT_EQ( 6u, seq.state().dealt );
+
+  // a raw copy of the state is the same position in the deck
+  SeqType fromState(threes::game::threesDefaultShuffleDeck());
+  SeqType::State state;
+  std::memcpy(&state, &seq.state(), sizeof(state));
+  fromState.setState(state);
+  EXPECT_EQ( seq.hash(), fromState.hash() );
+  EXPECT_EQ( seq.peek(board), fromState.peek(board) );
+
+  // and with the rng too it carries on identically
+  SeqType copy(threes::game::threesDefaultShuffleDeck());
+  copy.assignFrom(seq);
+  for(unsigned i = 0; i < 30; ++i) {
+    EXPECT_EQ( seq.draw(board), copy.draw(board) );
+  }
+  // the deck refills once it runs out
+  EXPECT_EQ( 36u, seq.state().dealt );
+}
@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 
 #include <src/GameDriver.h>
+#include <src/BatchRunner.h>
 #include <src/Board.h>
+#include "TestCreators.h"
 #include <iostream>
 #include <sstream> // for istringstream to fake user input from str
 
@@ -26,9 +28,7 @@ using TestBoard = threes::game::Board<3, AlwaysGenerateMinVal>;
 
 // Demonstrate some basic assertions.
 TEST(GameDriver, Basic) {
-  threes::game::ICardSequence<TestBoard>::s_factory.registerCreator(
-  "k28d",
-  threes::game::Kamikaze28Sequence<TestBoard>::create);
+  threes::test::registerTestCreators<TestBoard>();
 
   std::istringstream userInput("");
   
@@ -40,3 +40,50 @@ TEST(GameDriver, Basic) {
   
   
 }
+
+TEST(GameDriver, Batch) {
+  using BatchBoard = threes::game::Board<4>;
+  threes::test::registerTestCreators<BatchBoard>();
+
+  threes::game::BatchConfig config;
+  config.numGames = 40;
+  config.numThreads = 4;
+
+  threes::game::BatchResult result = threes::game::runBatch<BatchBoard>(config);
+  ASSERT_EQ( 40u, result.scores.size() );
+  EXPECT_EQ( 4u, result.numThreads );
+
+  unsigned histogramTotal = 0;
+  for(const auto& bin : result.maxCardHistogram()) {
+    EXPECT_GE( bin.first, 3u );
+    histogramTotal += bin.second;
+  }
+  EXPECT_EQ( 40u, histogramTotal );
+
+  EXPECT_LE( result.scorePercentile(0), result.scorePercentile(50) );
+  EXPECT_LE( result.scorePercentile(50), result.scorePercentile(100) );
+  EXPECT_EQ( *std::max_element(result.scores.begin(), result.scores.end()),
+	     result.scorePercentile(100) );
+}
+
+TEST(GameDriver, SeededBatchRepeats) {
+  using BatchBoard = threes::game::Board<4>;
+  threes::test::registerTestCreators<BatchBoard>();
+
+  threes::game::BatchConfig config;
+  config.numGames = 20;
+  config.numThreads = 3;
+  config.seed = 1234;
+
+  // thread scheduling must not matter, only the seed
+  const threes::game::BatchResult first = threes::game::runBatch<BatchBoard>(config);
+  config.numThreads = 1;
+  const threes::game::BatchResult second = threes::game::runBatch<BatchBoard>(config);
+  EXPECT_EQ( 1234u, first.seed );
+  EXPECT_EQ( first.scores, second.scores );
+  EXPECT_EQ( first.maxCards, second.maxCards );
+
+  config.seed = 4321;
+  const threes::game::BatchResult other = threes::game::runBatch<BatchBoard>(config);
+  EXPECT_NE( first.scores, other.scores );
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <src/GameRecord.h>
+#include <src/BatchRunner.h>
+#include <src/Board.h>
+#include "TestCreators.h"
+
+#include <cstdio>
+#include <fstream>
+
+using BatchBoard = threes::game::Board<4>;
+
+TEST(GameRecord, EntryRoundTrip) {
+  using threes::game::Card;
+  std::vector<Card> cards{Card(1), Card(2), Card(3), Card(6144), Card(48)};
+  std::vector<unsigned> idx{0, 1, 7, 8, 15};
+  const BatchBoard board(cards, idx);
+
+  const auto entry = threes::game::GameRecordEntry::moveEntry(board, Card(12), threes::game::DIRECTION_LEFT);
+  for(unsigned i = 0; i < 16; ++i) {
+    EXPECT_EQ( board.underlyingDataRef()[i], entry.cardAt(i) );
+  }
+  EXPECT_EQ( Card(12), entry.nextCard() );
+  EXPECT_EQ( threes::game::DIRECTION_LEFT, entry.direction() );
+  EXPECT_FALSE( entry.gameEnd() );
+
+  const auto end = threes::game::GameRecordEntry::endEntry(board, 0x12345678u);
+  EXPECT_TRUE( end.gameEnd() );
+  EXPECT_EQ( 0x12345678u, end.score() );
+}
+
+TEST(GameRecord, BatchWriteAndRead) {
+  threes::test::registerTestCreators<BatchBoard>();
+  const std::string path("game_record_test.bin");
+
+  threes::game::BatchConfig config;
+  config.numGames = 6;
+  config.numThreads = 1; // games land in finishing order, one thread keeps game order
+  config.seed = 99;
+  config.recordPath = path;
+  const threes::game::BatchResult result = threes::game::runBatch<BatchBoard>(config);
+
+  auto reader = threes::game::GameRecordReader::open(path);
+  ASSERT_TRUE( reader != nullptr );
+  EXPECT_EQ( 4u, reader->dim() );
+
+  const std::vector<size_t> starts = reader->gameStarts();
+  ASSERT_EQ( config.numGames, starts.size() );
+  for(unsigned game = 0; game < config.numGames; ++game) {
+    const size_t last = (game + 1 < starts.size() ? starts[game + 1] : reader->size()) - 1;
+    const auto& end = (*reader)[last];
+    ASSERT_TRUE( end.gameEnd() );
+    EXPECT_EQ( result.scores[game], end.score() );
+
+    // every logged move was legal on the board it was logged with
+    for(size_t i = starts[game]; i < last; ++i) {
+      const auto& entry = (*reader)[i];
+      EXPECT_FALSE( entry.gameEnd() );
+      BatchBoard::storage_t data;
+      for(unsigned t = 0; t < 16; ++t) { data[t] = entry.cardAt(t); }
+      EXPECT_TRUE( BatchBoard(data).canShift(entry.direction()) );
+    }
+  }
+  reader.reset();
+
+  // a partial entry at the end means the file is cut short
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.put('x');
+  }
+  EXPECT_EQ( nullptr, threes::game::GameRecordReader::open(path) );
+
+  std::remove(path.c_str());
+  EXPECT_EQ( nullptr, threes::game::GameRecordReader::open(path) );
+}
@@ -265,3 +265,140 @@ TEST(BoardState, BiggerBoard) {
 //    6      0     2     1
 //
 
+
+TEST(BoardState, IncrementalFeatures) {
+  using BoardType = threes::game::Board<4>;
+
+  std::vector<Card> initialCards{Card(3), Card(1), Card(2), Card(6), Card(3), Card(12)};
+  std::vector<unsigned> insertIdx{0, 3, 5, 6, 10, 15};
+  BoardType board(initialCards, insertIdx);
+  threes::game::RngContext rng(7);
+  const std::array<Card, 4> nextCards{ Card(1), Card(2), Card(3), Card(6) };
+
+  // after every shift the maintained features match a board built fresh
+  // from the same tiles
+  for(unsigned i = 0; i < 200; ++i) {
+    bool moved = false;
+    for(unsigned d = 0; d < threes::game::NUM_DIRECTIONS && !moved; ++d) {
+      const auto dir = static_cast<threes::game::ShiftDirection>((i + d) % threes::game::NUM_DIRECTIONS);
+      if(board.canShift(dir)) {
+	board.shiftBoard(dir, nextCards[i % nextCards.size()], rng);
+	moved = true;
+      }
+    }
+    if(!moved) { break; }
+
+    const BoardType fresh(board.underlyingDataRef());
+    unsigned empties = 0;
+    for(auto card : board.underlyingDataRef()) { empties += (card.value == 0); }
+    EXPECT_EQ( empties, board.numEmpty() );
+    EXPECT_EQ( fresh.occupiedMask(), board.occupiedMask() );
+    EXPECT_EQ( fresh.topThreeValues(), board.topThreeValues() );
+    EXPECT_EQ( fresh.lineScores(), board.lineScores() );
+    uint64_t score = 0;
+    for(auto card : board.underlyingDataRef()) {
+      score += static_cast<uint64_t>(threes::game::standardCardScore(card) + 1e-2);
+    }
+    EXPECT_EQ( score, board.score() );
+    for(unsigned rank = 0; rank <= threes::game::S_MAX_CARD_RANK; ++rank) {
+      EXPECT_EQ( fresh.rankMask(rank), board.rankMask(rank) );
+    }
+  }
+}
+
+namespace {
+
+  // plain loop version of one shift, for checking the unrolled kernels.
+  // tile(slice, k) steps away from the wall the cards move toward
+  template<unsigned DIM>
+  unsigned referenceShift(std::array<Card, DIM*DIM>& data, const threes::game::ShiftDirection dir) {
+    auto tile = [dir](const unsigned slice, const unsigned k) {
+      switch(dir) {
+      case threes::game::DIRECTION_UP:    return slice + DIM*k;
+      case threes::game::DIRECTION_DOWN:  return slice + DIM*(DIM-1-k);
+      case threes::game::DIRECTION_LEFT:  return DIM*slice + k;
+      default:                            return DIM*slice + (DIM-1-k);
+      }
+    };
+    unsigned movedMask = 0;
+    for(unsigned slice = 0; slice < DIM; ++slice) {
+      for(unsigned k = 0; k + 1 < DIM; ++k) {
+	Card& curr = data[tile(slice, k)];
+	const Card next = data[tile(slice, k+1)];
+	if(!curr.canCombine(next)) { continue; }
+	curr = Card(curr.value + next.value);
+	for(unsigned j = k+1; j + 1 < DIM; ++j) {
+	  data[tile(slice, j)] = data[tile(slice, j+1)];
+	}
+	data[tile(slice, DIM-1)] = Card(0);
+	movedMask |= (1u << slice);
+	break;
+      }
+    }
+    return movedMask;
+  }
+
+  template<unsigned DIM>
+  void checkShiftKernels(const uint64_t seed) {
+    using BoardType = threes::game::Board<DIM>;
+    threes::game::RngContext rng(seed);
+    const std::array<Card, 6> cards{ Card(0), Card(1), Card(2), Card(3), Card(6), Card(12) };
+
+    for(unsigned trial = 0; trial < 100; ++trial) {
+      typename BoardType::storage_t data;
+      for(auto& card : data) { card = cards[rng.uniformInt(0, cards.size()-1)]; }
+
+      const threes::game::MoveSet moves = BoardType(data).moves();
+      for(unsigned d = 0; d < threes::game::NUM_DIRECTIONS; ++d) {
+	const auto dir = static_cast<threes::game::ShiftDirection>(d);
+	BoardType board(data);
+	typename BoardType::storage_t expected(data);
+	const unsigned expectedMask = referenceShift<DIM>(expected, dir);
+
+	EXPECT_EQ( expectedMask != 0, board.canShift(dir) );
+	EXPECT_EQ( expectedMask != 0, moves.canShift(dir) );
+	EXPECT_EQ( expectedMask, moves.moved[d] );
+	EXPECT_EQ( expectedMask, board.shiftTiles(dir) );
+	EXPECT_EQ( expected, board.underlyingDataRef() );
+	EXPECT_EQ( BoardType(expected).maxCard(), board.maxCard() );
+
+	// shifting just the slices moves() found does the same
+	BoardType masked(data);
+	masked.shiftTiles(dir, moves.moved[d]);
+	EXPECT_EQ( expected, masked.underlyingDataRef() );
+      }
+    }
+  }
+
+} // anon ns
+
+TEST(BoardState, ShiftKernelsOddSizes) {
+  checkShiftKernels<3>(3);
+  checkShiftKernels<5>(5);
+}
+
+TEST(BoardState, MoveSet) {
+  checkShiftKernels<4>(4);
+
+  // nothing can move on a full board with no pairs
+  threes::game::Board<4>::storage_t stuck;
+  for(unsigned i = 0; i < stuck.size(); ++i) {
+    stuck[i] = Card((i + i/4) % 2 ? 1 : 3);
+  }
+  const threes::game::MoveSet moves = threes::game::Board<4>(stuck).moves();
+  EXPECT_FALSE( moves.any() );
+  EXPECT_EQ( 0u, moves.count() );
+
+  // a 1 above a 2 in the first column merges up and down, emptying the
+  // top of the last column lets rows 0 and 1 slide right and column 3 up
+  stuck[0] = Card(1);
+  stuck[4] = Card(2);
+  stuck[3] = Card(0);
+  stuck[7] = Card(0);
+  const threes::game::MoveSet some = threes::game::Board<4>(stuck).moves();
+  EXPECT_EQ( 9u, some.moved[threes::game::DIRECTION_UP] );
+  EXPECT_EQ( 1u, some.moved[threes::game::DIRECTION_DOWN] );
+  EXPECT_EQ( 3u, some.moved[threes::game::DIRECTION_RIGHT] );
+  EXPECT_FALSE( some.canShift(threes::game::DIRECTION_LEFT) );
+  EXPECT_EQ( 3u, some.count() );
+}
@@ -0,0 +1,94 @@
+#include <src/Board.h>
+#include <src/Card.h>
+#include <src/LineEvaluator.h>
+#include <src/PackedBoard.h>
+#include <src/TreeStrategy.h>
+#include <gtest/gtest.h>
+
+using threes::game::Card;
+
+TEST(LineEvaluator, MatchesLineFeatures) {
+  using BoardType = threes::game::Board<4>;
+  using PackedType = threes::game::PackedBoard4<>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(48);
+  tiles[1] = Card(1);
+  tiles[5] = Card(2);
+  tiles[6] = Card(3);
+  tiles[10] = Card(6);
+  tiles[15] = Card(12);
+  BoardType board(tiles);
+  threes::game::RngContext rng(13);
+  const std::array<Card, 4> nextCards{ Card(3), Card(1), Card(2), Card(6) };
+
+  threes::game::ExpectiMaxTree<BoardType> lut(threes::game::ExpectiMaxConfig::fromStr("1;1;eval=lut"));
+  threes::game::ExpectiMaxTree<PackedType> packedLut(threes::game::ExpectiMaxConfig::fromStr("1;1;eval=lut"));
+
+  // the tables hold the same line scores the board maintains, and a
+  // packed board looks up the same value
+  for(unsigned i = 0; i < 100; ++i) {
+    const double expected = board.maxCard().value + 3.0*board.numEmpty() + board.lineScores();
+    EXPECT_EQ( expected, threes::game::lineLookupValue(board) );
+    EXPECT_EQ( expected, lut.valueFunction(board) );
+    EXPECT_EQ( expected, packedLut.valueFunction(PackedType::fromBoard(board)) );
+
+    bool moved = false;
+    for(unsigned d = 0; d < threes::game::NUM_DIRECTIONS && !moved; ++d) {
+      const auto dir = static_cast<threes::game::ShiftDirection>((i + d) % threes::game::NUM_DIRECTIONS);
+      if(board.canShift(dir)) {
+	board.shiftBoard(dir, nextCards[i % nextCards.size()], rng);
+	moved = true;
+      }
+    }
+    if(!moved) { break; }
+  }
+}
+
+TEST(LineEvaluator, SingleLines) {
+  const threes::game::LineEvalTables& tables = threes::game::lineEvalTables();
+  // ranks low nibble first: 6 6 0 0, pair +2, two empties
+  const unsigned line = 4 | (4 << 4);
+  EXPECT_EQ( (2 + 3*2) * threes::game::LineEvalScale, tables.row[line] );
+  EXPECT_EQ( 2 * threes::game::LineEvalScale, tables.col[line] );
+  // 3 12 3 12: each 3 trapped by the wall or a 12 on both sides (-5 each)
+  const unsigned trapped = 3 | (5 << 4) | (3 << 8) | (5 << 12);
+  EXPECT_EQ( -10 * threes::game::LineEvalScale, tables.row[trapped] );
+  // 3 12 3 0: the last 3 has an empty tile beside it, so isn't trapped
+  const unsigned open = 3 | (5 << 4) | (3 << 8);
+  EXPECT_EQ( (-5 + 3) * threes::game::LineEvalScale, tables.row[open] );
+}
+
+TEST(LineEvaluator, BatchMatchesSingle) {
+  using BoardType = threes::game::Board<4>;
+  threes::game::RngContext rng(5);
+
+  // an odd count, so both the vector and the leftover path run
+  std::vector<uint64_t> packed;
+  std::vector<uint32_t> maxCards;
+  std::vector<double> expected;
+  for(unsigned i = 0; i < 39; ++i) {
+    BoardType::storage_t tiles;
+    for(auto& tile : tiles) { tile = threes::game::cardFromRank(rng.uniformInt(0, 9)); }
+    const BoardType board(tiles);
+    packed.push_back(threes::game::packedTiles(board));
+    maxCards.push_back(board.maxCard().value);
+    expected.push_back(threes::game::lineLookupValue(board));
+  }
+
+  std::vector<double> values(packed.size(), -1.0);
+  threes::game::lineLookupValues(packed.data(), maxCards.data(), packed.size(), values.data());
+  EXPECT_EQ( expected, values );
+
+  // and through the tree's batch call
+  threes::game::ExpectiMaxTree<BoardType> lut(threes::game::ExpectiMaxConfig::fromStr("1;1;eval=lut"));
+  std::vector<BoardType> boards;
+  for(const uint64_t p : packed) {
+    BoardType::storage_t tiles;
+    for(unsigned t = 0; t < 16; ++t) { tiles[t] = threes::game::cardFromRank((p >> (4*t)) & 0xF); }
+    boards.emplace_back(tiles);
+  }
+  std::fill(values.begin(), values.end(), -1.0);
+  lut.valueFunctionBatch(boards.data(), boards.size(), values.data());
+  EXPECT_EQ( expected, values );
+}
@@ -0,0 +1,161 @@
+#include <src/Board.h>
+#include <src/Card.h>
+#include <src/CardSequence.h>
+#include <src/MCTSStrategy.h>
+#include <src/PackedBoard.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+using threes::game::Card;
+
+TEST(MCTS, Config) {
+  const threes::game::MCTSConfig defaults = threes::game::MCTSConfig::fromStr("");
+  EXPECT_EQ( 1000u, defaults.iterations );
+  EXPECT_EQ( threes::game::ROLLOUT_RANDOM, defaults.rollout );
+  EXPECT_FALSE( defaults.treeParallel );
+
+  const threes::game::MCTSConfig config =
+    threes::game::MCTSConfig::fromStr("iters=50;timems=20;c=0.5;rollout=greedy;rolloutdepth=8;threads=3;parallel=tree;vloss=2");
+  EXPECT_EQ( 50u, config.iterations );
+  EXPECT_DOUBLE_EQ( 20.0, config.timeBudgetMs );
+  EXPECT_DOUBLE_EQ( 0.5, config.exploration );
+  EXPECT_EQ( threes::game::ROLLOUT_GREEDY, config.rollout );
+  EXPECT_EQ( 8u, config.rolloutDepth );
+  EXPECT_EQ( 3u, config.numThreads );
+  EXPECT_TRUE( config.treeParallel );
+  EXPECT_EQ( 2u, config.virtualLoss );
+}
+
+using PackedType = threes::game::PackedBoard4<>;
+
+void checkSearch(const std::string& args) {
+  using Stgy = threes::game::MCTSStrategy<PackedType>;
+
+  threes::game::Board<4>::storage_t tiles{};
+  tiles[0] = Card(48);
+  tiles[1] = Card(1);
+  tiles[5] = Card(2);
+  tiles[6] = Card(3);
+  tiles[10] = Card(6);
+  tiles[15] = Card(12);
+  auto boardPtr = std::make_unique<PackedType>( PackedType::fromBoard(threes::game::Board<4>(tiles)) );
+  threes::game::ICardSequence<PackedType>::ICardSeqPtr seqPtr(
+    new threes::game::Kamikaze28Sequence<PackedType>(threes::game::threesDefaultShuffleDeck()) );
+  seqPtr->seed(19);
+
+  Stgy first(threes::game::MCTSConfig::fromStr(args));
+  Stgy second(threes::game::MCTSConfig::fromStr(args));
+  first.seed(4);
+  second.seed(4);
+  const threes::game::ShiftDirection move = first.move(boardPtr, seqPtr);
+  EXPECT_TRUE( boardPtr->canShift(move) );
+  EXPECT_EQ( 200u, first.lastSearchIterations() );
+  // the same seed searches the same way
+  EXPECT_EQ( move, second.move(boardPtr, seqPtr) );
+}
+
+TEST(MCTS, Search) {
+  checkSearch("iters=200;rolloutdepth=10");
+  checkSearch("iters=200;rollout=greedy;rolloutdepth=10");
+  checkSearch("iters=200;rollout=lut;rolloutdepth=10");
+  checkSearch("iters=200;rolloutdepth=10;threads=2");
+}
+
+TEST(MCTS, TreeParallel) {
+  using BoardType = threes::game::Board<4>;
+  using Stgy = threes::game::MCTSStrategy<BoardType>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(3);
+  tiles[3] = Card(3);
+  tiles[12] = Card(1);
+  tiles[15] = Card(2);
+  auto boardPtr = std::make_unique<BoardType>(tiles);
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seqPtr(
+    new threes::game::Kamikaze28Sequence<BoardType>(threes::game::threesDefaultShuffleDeck()) );
+  seqPtr->seed(23);
+
+  Stgy stgy(threes::game::MCTSConfig::fromStr("iters=300;rolloutdepth=10;threads=3;parallel=tree"));
+  const threes::game::ShiftDirection move = stgy.move(boardPtr, seqPtr);
+  EXPECT_TRUE( boardPtr->canShift(move) );
+  EXPECT_EQ( 300u, stgy.lastSearchIterations() );
+}
+
+// Kamikaze28Sequence that logs the card and deck state of the first draw
+// after every assignFrom, i.e. the first draw of every MCTS playout
+template<class BOARD>
+class PlayoutProbeSequence : public threes::game::ICardSequence<BOARD> {
+public:
+  using K28 = threes::game::Kamikaze28Sequence<BOARD>;
+  using typename threes::game::ICardSequence<BOARD>::BoardPtrType;
+  using typename threes::game::ICardSequence<BOARD>::ICardSeqPtr;
+  using Log = std::vector<std::pair<Card, threes::game::K28SequenceState>>;
+
+  PlayoutProbeSequence(const K28& inner, std::shared_ptr<Log> log)
+    : m_inner(inner), m_log(log), m_fresh(false) {}
+
+  virtual Card draw(const BoardPtrType& b) override {
+    if(m_fresh) {
+      m_log->emplace_back(m_inner.peek(b), m_inner.state());
+      m_fresh = false;
+    }
+    return m_inner.draw(b);
+  }
+  virtual Card peek(const BoardPtrType& b) const override { return m_inner.peek(b); }
+  virtual ICardSeqPtr clone() const override { return ICardSeqPtr(new PlayoutProbeSequence(*this)); }
+  virtual void assignFrom(const threes::game::ICardSequence<BOARD>& other) override {
+    m_inner.assignFrom(static_cast<const PlayoutProbeSequence&>(other).m_inner);
+    m_fresh = true;
+  }
+  virtual uint64_t hash() const override { return m_inner.hash(); }
+  virtual void drawOutcomes(const BoardPtrType& b,
+			    std::vector<threes::game::DrawOutcome>& outcomes) const override {
+    m_inner.drawOutcomes(b, outcomes);
+  }
+  virtual Card drawOutcome(const BoardPtrType& b, const threes::game::DrawOutcome& outcome) override {
+    return m_inner.drawOutcome(b, outcome);
+  }
+  virtual unsigned write_binary(std::ostream& out) const override { return m_inner.write_binary(out); }
+  virtual void seed(const uint64_t seed) override { m_inner.seed(seed); }
+
+private:
+  K28 m_inner;
+  std::shared_ptr<Log> m_log;
+  bool m_fresh;
+};
+
+// playouts start from the root's next card and deck, only later draws vary
+TEST(MCTS, PlayoutsKeepTheSequence) {
+  using BoardType = threes::game::Board<4>;
+  using Stgy = threes::game::MCTSStrategy<BoardType>;
+  using ProbeType = PlayoutProbeSequence<BoardType>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(3);
+  tiles[3] = Card(3);
+  tiles[12] = Card(1);
+  tiles[15] = Card(2);
+  auto boardPtr = std::make_unique<BoardType>(tiles);
+
+  // part way through the deck, so a fresh one would show
+  ProbeType::K28 k28(threes::game::threesDefaultShuffleDeck());
+  k28.seed(31);
+  for(unsigned i = 0; i < 5; ++i) { k28.draw(boardPtr); }
+  auto log = std::make_shared<ProbeType::Log>();
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seqPtr(new ProbeType(k28, log));
+
+  Stgy stgy(threes::game::MCTSConfig::fromStr("iters=50;rolloutdepth=5"));
+  stgy.seed(7);
+  stgy.move(boardPtr, seqPtr);
+
+  ASSERT_FALSE( log->empty() );
+  const Card rootNext = seqPtr->peek(boardPtr);
+  for(const auto& first : *log) {
+    EXPECT_EQ( rootNext, first.first );
+    EXPECT_EQ( k28.state().remaining, first.second.remaining );
+    EXPECT_EQ( k28.state().dealt, first.second.dealt );
+  }
+}
@@ -0,0 +1,101 @@
+#include <src/Board.h>
+#include <src/Card.h>
+#include <src/CardSequence.h>
+#include <src/LineEvaluator.h>
+#include <src/NTupleNetwork.h>
+#include <src/PackedBoard.h>
+#include <src/TDTrainer.h>
+#include <src/TreeStrategy.h>
+#include <gtest/gtest.h>
+#include "TestCreators.h"
+
+#include <cstdio>
+
+using threes::game::Card;
+
+TEST(NTuple, SymmetricValue) {
+  using PackedType = threes::game::PackedBoard4<>;
+
+  threes::game::NTupleNetwork net;
+  threes::game::RngContext rng(3);
+  for(auto& weight : net.weights()) {
+    weight = static_cast<float>(rng.uniformInt(0, 1000)) / 1000.0f;
+  }
+  EXPECT_EQ( 5u * threes::game::NTupleNetwork::NumSymmetries, net.numLookups() );
+
+  // 48  1  .  .
+  //  .  2  3  .
+  //  .  .  6  .
+  //  .  .  . 12
+  std::vector<Card> cards{Card(48), Card(1), Card(2), Card(3), Card(6), Card(12)};
+  PackedType board(cards, std::vector<unsigned>{0, 1, 5, 6, 10, 15});
+  // mirror image, left to right
+  PackedType mirrored(cards, std::vector<unsigned>{3, 2, 6, 5, 9, 12});
+  // transposed
+  PackedType transposed(threes::game::transposePacked(board.packed()));
+
+  const float value = net.value(board.packed());
+  EXPECT_FLOAT_EQ( value, net.value(mirrored.packed()) );
+  EXPECT_FLOAT_EQ( value, net.value(transposed.packed()) );
+
+  // an update moves every weight the board reads, some more than once when
+  // two symmetries of a pattern see the same tiles
+  net.update(board.packed(), 0.5f);
+  EXPECT_GE( net.value(board.packed()), value + 0.5f * net.numLookups() );
+}
+
+TEST(NTuple, SaveLoad) {
+  using BoardType = threes::game::Board<4>;
+
+  threes::game::NTupleNetwork net(std::vector<threes::game::NTupleNetwork::Pattern>{
+      { 0, 1, 2, 3 }, { 0, 4, 5 } });
+  threes::game::RngContext rng(5);
+  for(auto& weight : net.weights()) {
+    weight = static_cast<float>(rng.uniformInt(0, 1000)) - 500.0f;
+  }
+  const std::string path("ntuple_saveload_test.bin");
+  ASSERT_TRUE( net.save(path) );
+
+  auto loaded = threes::game::NTupleNetwork::load(path);
+  ASSERT_TRUE( loaded != nullptr );
+  EXPECT_EQ( net.patterns(), loaded->patterns() );
+  EXPECT_EQ( net.weights(), loaded->weights() );
+
+  // the search reads the same network back
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(48);
+  tiles[4] = Card(6);
+  tiles[5] = Card(3);
+  const BoardType board(tiles);
+  threes::game::ExpectiMaxTree<BoardType> stgy(
+    threes::game::ExpectiMaxConfig::fromStr("1;1;eval=ntuple;weights=" + path));
+  EXPECT_FLOAT_EQ( net.value(threes::game::packedTiles(board)), stgy.valueFunction(board) );
+
+  std::remove(path.c_str());
+  EXPECT_EQ( nullptr, threes::game::NTupleNetwork::load(path) );
+}
+
+TEST(NTuple, TDTraining) {
+  using TrainBoard = threes::game::PackedBoard4<>;
+  threes::test::registerTestCreators<TrainBoard>();
+
+  threes::game::TDConfig config;
+  config.numGames = 24;
+  config.numThreads = 3;
+  config.gamesPerRound = 2;
+  config.lambda = 0.5f;
+  config.seed = 7;
+
+  // same seed and threads, same weights
+  threes::game::NTupleNetwork first, second;
+  const threes::game::TDResult firstResult = threes::game::trainTD<TrainBoard>(first, config);
+  const threes::game::TDResult secondResult = threes::game::trainTD<TrainBoard>(second, config);
+  EXPECT_EQ( firstResult.scores, secondResult.scores );
+  EXPECT_EQ( first.weights(), second.weights() );
+
+  unsigned learned = 0;
+  for(const float weight : first.weights()) {
+    if(weight != 0.0f) { ++learned; }
+  }
+  EXPECT_GT( learned, 0u );
+}
@@ -0,0 +1,178 @@
+#include <src/PackedBoard.h>
+#include <src/Board.h>
+#include <src/Card.h>
+#include <src/TreeStrategy.h>
+#include <gtest/gtest.h>
+
+
+// random generator that always returns min value in the
+// random range for testing purposes
+class AlwaysGenerateMinVal {
+public:
+  AlwaysGenerateMinVal(const int min, const int max)
+    : m_min(min)
+  {(void)max;}
+
+  template<typename RAND_GEN>
+  int operator()(RAND_GEN& rd) const { (void)rd; return(m_min); }
+
+private:
+  const int m_min;
+};
+
+
+using threes::game::Card;
+using TestBoard = threes::game::Board<4, AlwaysGenerateMinVal>;
+using TestPacked = threes::game::PackedBoard4<AlwaysGenerateMinVal>;
+
+TEST(PackedBoard, CardRank) {
+  for(unsigned rank = 0; rank <= threes::game::S_MAX_CARD_RANK; ++rank) {
+    EXPECT_EQ( rank, threes::game::cardRank(threes::game::cardFromRank(rank)) );
+  }
+  EXPECT_EQ( Card(6), threes::game::cardFromRank(4) );
+  EXPECT_EQ( Card(6144), threes::game::cardFromRank(14) );
+}
+
+TEST(PackedBoard, RankScores) {
+  for(unsigned rank = 0; rank <= threes::game::S_MAX_CARD_RANK; ++rank) {
+    const Card card = threes::game::cardFromRank(rank);
+    EXPECT_EQ( static_cast<uint32_t>(threes::game::standardCardScore(card) + 1e-2),
+	       threes::game::cardScore(card) );
+  }
+  EXPECT_EQ( 3u, threes::game::cardScore(Card(3)) );
+  EXPECT_EQ( 0u, threes::game::cardScore(Card(2)) );
+}
+
+TEST(PackedBoard, Conversion) {
+  std::vector<Card> initialCards{Card(3), Card(12), Card(1), Card(1), Card(48), Card(2), Card(3),
+				 Card(3), Card(24), Card(0), Card(2), Card(0), Card(6), Card(0), Card(2)};
+  std::vector<unsigned> allIdx{0,1,2,3,4,5,6,7,8,9,10,11,12,13,14};
+  TestBoard board(initialCards, allIdx);
+
+  TestPacked packed = TestPacked::fromBoard(board);
+  EXPECT_EQ( 8u, sizeof(packed) );
+  for(unsigned row = 0; row < 4; ++row) {
+    for(unsigned col = 0; col < 4; ++col) {
+      EXPECT_EQ( board.cardAtIndex(row, col), packed.cardAtIndex(row, col) );
+    }
+  }
+  EXPECT_EQ( Card(48), packed.maxCard() );
+
+  TestBoard roundTrip = packed.toBoard();
+  EXPECT_EQ( board.underlyingDataRef(), roundTrip.underlyingDataRef() );
+  EXPECT_EQ( Card(48), roundTrip.maxCard() );
+
+  // this board can't shift up, see BoardState.BiggerBoard
+  EXPECT_FALSE( packed.canShift(threes::game::DIRECTION_UP) );
+}
+
+// rank 15 is the largest a nibble holds, so two of them don't merge
+TEST(PackedBoard, MaxRankDoesntCombine) {
+  EXPECT_FALSE( Card(12288).canCombine(Card(12288)) );
+  EXPECT_TRUE( Card(6144).canCombine(Card(6144)) );
+
+  std::vector<Card> initialCards{Card(12288), Card(12288), Card(3), Card(6), Card(3), Card(6), Card(3), Card(6)};
+  std::vector<unsigned> idx{0,1,4,5,8,9,12,13};
+  TestBoard board(initialCards, idx);
+  TestPacked packed = TestPacked::fromBoard(board);
+  EXPECT_FALSE( board.canShift(threes::game::DIRECTION_LEFT) );
+  EXPECT_FALSE( packed.canShift(threes::game::DIRECTION_LEFT) );
+  EXPECT_EQ( board.moves().count(), packed.moves().count() );
+}
+
+// play both boards in lockstep and check they always agree
+TEST(PackedBoard, MatchesBoard) {
+  std::vector<Card> initialCards{Card(1), Card(2), Card(3)};
+  std::vector<unsigned> insertIdx{0, 5, 10};
+  TestBoard board(initialCards, insertIdx);
+  TestPacked packed(initialCards, insertIdx);
+
+  const std::array<threes::game::ShiftDirection, 4> moveCycle{
+    threes::game::DIRECTION_LEFT, threes::game::DIRECTION_UP,
+    threes::game::DIRECTION_RIGHT, threes::game::DIRECTION_DOWN };
+
+  unsigned numMoves = 0;
+  for(unsigned turn = 0; turn < 500; ++turn) {
+    bool anyMove = false;
+    const threes::game::MoveSet moves = board.moves();
+    const threes::game::MoveSet packedMoves = packed.moves();
+    ASSERT_EQ( moves.legal, packedMoves.legal );
+    ASSERT_EQ( moves.moved, packedMoves.moved );
+    for(unsigned i = 0; i < moveCycle.size(); ++i) {
+      const threes::game::ShiftDirection dir = moveCycle[(turn + i) % moveCycle.size()];
+      ASSERT_EQ( board.canShift(dir), packed.canShift(dir) );
+      if( board.canShift(dir) ) {
+	const Card insert( (turn % 3) + 1 );
+	board.shiftBoard(dir, insert);
+	packed.shiftBoard(dir, insert);
+	anyMove = true;
+	++numMoves;
+	break;
+      }
+    }
+
+    EXPECT_EQ( board.underlyingDataRef(), packed.underlyingDataRef() );
+    EXPECT_EQ( board.score(), packed.score() );
+    if(!anyMove) { break; }
+  }
+  EXPECT_GT( numMoves, 10u );
+}
+
+TEST(PackedBoard, ExpectiMaxTree) {
+  using TreeStgy = threes::game::ExpectiMaxTree<TestPacked>;
+  using TreeStgyUnpacked = threes::game::ExpectiMaxTree<TestBoard>;
+
+  std::vector<Card> initialCards{Card(12), Card(6), Card(2)};
+  std::vector<unsigned> topRow{0, 1, 2};
+  TestBoard board(initialCards, topRow);
+  TestPacked packed(initialCards, topRow);
+
+  TreeStgy stgy(1, 1);
+  TreeStgyUnpacked stgyUnpacked(1, 1);
+  // unpacked board only learns its max card from shifts
+  EXPECT_EQ( stgy.valueFunction(packed),
+	     stgyUnpacked.valueFunction(board) + packed.maxCard().value );
+}
+
+TEST(PackedBoard, Transpose) {
+  std::vector<Card> initialCards{Card(1), Card(2), Card(3), Card(6), Card(12), Card(24)};
+  std::vector<unsigned> insertIdx{1, 2, 7, 8, 13, 14};
+  TestPacked packed(initialCards, insertIdx);
+  TestPacked transposed(threes::game::transposePacked(packed.packed()));
+
+  for(unsigned row = 0; row < 4; ++row) {
+    for(unsigned col = 0; col < 4; ++col) {
+      EXPECT_EQ( packed.cardAtIndex(row, col), transposed.cardAtIndex(col, row) );
+    }
+  }
+  EXPECT_EQ( packed.packed(), threes::game::transposePacked(transposed.packed()) );
+}
+
+TEST(PackedBoard, RowTables) {
+  const threes::game::RowTables& tables = threes::game::rowTables();
+
+  // 1 2 0 3 shifted left: 1+2 combine, 3 slides over
+  const unsigned line = 1u | (2u << 4) | (0u << 8) | (3u << 12);
+  const threes::game::RowShiftEntry& left = tables.towardLow[line];
+  EXPECT_EQ( 3u | (0u << 4) | (3u << 8), left.shifted );
+  EXPECT_TRUE( left.moved );
+  EXPECT_EQ( 3u, left.maxRank );
+  EXPECT_EQ( 3, left.scoreDelta );
+
+  // shifted right: 0 absorbs the 2, nothing combines
+  const threes::game::RowShiftEntry& right = tables.towardHigh[line];
+  EXPECT_EQ( 0u | (1u << 4) | (2u << 8) | (3u << 12), right.shifted );
+  EXPECT_TRUE( right.moved );
+  EXPECT_EQ( 0, right.scoreDelta );
+
+  // 6 6 12 12 shifted left: the first 6s combine in to 12, worth 27-9-9
+  const unsigned sixes = 4u | (4u << 4) | (5u << 8) | (5u << 12);
+  EXPECT_EQ( 5u | (5u << 4) | (5u << 8), tables.towardLow[sixes].shifted );
+  EXPECT_EQ( 9, tables.towardLow[sixes].scoreDelta );
+  EXPECT_EQ( 5u, tables.maxRank[sixes] );
+
+  // full line of distinct cards can't move
+  const unsigned stuck = 3u | (4u << 4) | (5u << 8) | (6u << 12);
+  EXPECT_FALSE( tables.towardLow[stuck].moved );
+  EXPECT_FALSE( tables.towardHigh[stuck].moved );
+}
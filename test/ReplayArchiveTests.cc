@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <src/ReplayArchive.h>
+#include <src/GameRecord.h>
+#include <src/BatchRunner.h>
+#include <src/Board.h>
+#include "TestCreators.h"
+
+#include <cstdio>
+#include <fstream>
+
+using BatchBoard = threes::game::Board<4>;
+
+TEST(ReplayArchive, ReplaysBatch) {
+  threes::test::registerTestCreators<BatchBoard>();
+
+  const std::string recordPath("replay_archive_test.rec");
+  const std::string archivePath("replay_archive_test.bin");
+
+  threes::game::BatchConfig config;
+  config.numGames = 5;
+  config.numThreads = 1;
+  config.seed = 17;
+  config.recordPath = recordPath;
+  config.archivePath = archivePath;
+  const threes::game::BatchResult result = threes::game::runBatch<BatchBoard>(config);
+
+  auto archive = threes::game::ReplayArchiveReader::open(archivePath);
+  auto record = threes::game::GameRecordReader::open(recordPath);
+  ASSERT_TRUE( archive != nullptr );
+  ASSERT_TRUE( record != nullptr );
+  EXPECT_EQ( 4u, archive->dim() );
+  EXPECT_EQ( "k28d", archive->seqName() );
+  ASSERT_EQ( config.numGames, archive->numGames() );
+
+  const std::vector<size_t> starts = record->gameStarts();
+  ASSERT_EQ( config.numGames, starts.size() );
+
+  // visit the games out of order, the index gives random access
+  for(const size_t game : { 3u, 0u, 4u, 1u, 2u }) {
+    threes::game::GameDriverReplay<BatchBoard> replay(*archive, game);
+    EXPECT_EQ( result.scores[game], replay.play() );
+
+    // every position matches the full record of the same game
+    const uint32_t numMoves = archive->numMoves(game);
+    ASSERT_EQ( (*record)[starts[game] + numMoves].gameEnd(), true );
+    for(uint32_t move = 0; move <= numMoves; move += 7) {
+      const BatchBoard board = threes::game::replayPosition<BatchBoard>(*archive, game, move);
+      const auto& entry = (*record)[starts[game] + move];
+      for(unsigned t = 0; t < 16; ++t) {
+	EXPECT_EQ( entry.cardAt(t), board.underlyingDataRef()[t] );
+      }
+      if(move < numMoves) {
+	EXPECT_EQ( entry.direction(), archive->move(game, move) );
+      }
+    }
+  }
+
+  // 2 bits a move plus a small per game header and index entry
+  std::ifstream archiveFile(archivePath, std::ios::binary | std::ios::ate);
+  std::ifstream recordFile(recordPath, std::ios::binary | std::ios::ate);
+  EXPECT_LT( 20*static_cast<size_t>(archiveFile.tellg()), static_cast<size_t>(recordFile.tellg()) );
+
+  archive.reset();
+  record.reset();
+  std::remove(recordPath.c_str());
+
+  // a closed archive opens, trailing junk means it's damaged
+  {
+    threes::game::ReplayArchiveWriter writer(archivePath, 4, "k28d", "default", 9);
+    writer.appendGame(1, { threes::game::DIRECTION_UP });
+  }
+  EXPECT_NE( nullptr, threes::game::ReplayArchiveReader::open(archivePath) );
+  {
+    std::ofstream out(archivePath, std::ios::binary | std::ios::app);
+    out.put('x');
+  }
+  EXPECT_EQ( nullptr, threes::game::ReplayArchiveReader::open(archivePath) );
+
+  // so does a move count that runs past the game's moves in to the index
+  {
+    threes::game::ReplayArchiveWriter writer(archivePath, 4, "k28d", "default", 9);
+    writer.appendGame(1, { threes::game::DIRECTION_UP });
+  }
+  {
+    std::fstream file(archivePath, std::ios::binary | std::ios::in | std::ios::out);
+    auto readU64 = [&file](const std::streamoff pos) {
+      unsigned char bytes[8];
+      file.seekg(pos);
+      file.read(reinterpret_cast<char*>(bytes), 8);
+      uint64_t value = 0;
+      for(unsigned i = 0; i < 8; ++i) { value |= uint64_t(bytes[i]) << (8*i); }
+      return value;
+    };
+    file.seekg(0, std::ios::end);
+    const std::streamoff size = file.tellg();
+    const uint64_t gameOffset = readU64(readU64(size - 16));
+    file.seekp(gameOffset + 8);
+    file.put(static_cast<char>(40));
+  }
+  EXPECT_EQ( nullptr, threes::game::ReplayArchiveReader::open(archivePath) );
+
+  // and a game count whose index size wraps round to the real one's
+  {
+    threes::game::ReplayArchiveWriter writer(archivePath, 4, "k28d", "default", 9);
+    writer.appendGame(1, { threes::game::DIRECTION_UP });
+  }
+  {
+    std::fstream file(archivePath, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-8, std::ios::end);
+    const uint64_t numGames = (uint64_t(1) << 61) + 1;
+    for(unsigned i = 0; i < 8; ++i) { file.put(static_cast<char>((numGames >> (8*i)) & 0xFF)); }
+  }
+  EXPECT_EQ( nullptr, threes::game::ReplayArchiveReader::open(archivePath) );
+  std::remove(archivePath.c_str());
+}
@@ -0,0 +1,65 @@
+#include <src/Board.h>
+#include <src/Card.h>
+#include <src/CardSequence.h>
+#include <src/GameDriver.h>
+#include <src/PackedBoard.h>
+#include <src/TreeStrategy.h>
+#include <gtest/gtest.h>
+
+// counts every heap allocation in the test binary, so a test can check a
+// block of code doesn't make any
+#include <src/AllocationCounter.h>
+
+using threes::game::Card;
+using Board4 = threes::game::Board<4>;
+
+template<class BOARD>
+BOARD convertBoard(const Board4& board) { return BOARD::fromBoard(board); }
+template<>
+Board4 convertBoard<Board4>(const Board4& board) { return board; }
+
+template<class BOARD>
+unsigned long allocationsPerSearch(const std::string& args) {
+  using TreeStgy = threes::game::ExpectiMaxTree<BOARD>;
+
+  Board4::storage_t tiles{};
+  tiles[0] = Card(48);
+  tiles[1] = Card(1);
+  tiles[5] = Card(2);
+  tiles[6] = Card(3);
+  tiles[10] = Card(6);
+  tiles[15] = Card(12);
+  auto boardPtr = std::make_unique<BOARD>( convertBoard<BOARD>(Board4(tiles)) );
+
+  typename threes::game::ICardSequence<BOARD>::ICardSeqPtr seqPtr(
+    new threes::game::Kamikaze28Sequence<BOARD>(threes::game::threesDefaultShuffleDeck()) );
+  seqPtr->seed(3);
+
+  TreeStgy stgy(threes::game::ExpectiMaxConfig::fromStr(args));
+  stgy.seed(5);
+  // first search fills the arena in, which also shows the counter works
+  s_allocations = 0;
+  s_countAllocations = true;
+  stgy.move(boardPtr, seqPtr);
+  s_countAllocations = false;
+  EXPECT_GT( s_allocations, 0ul );
+
+  s_allocations = 0;
+  s_countAllocations = true;
+  for(unsigned i = 0; i < 5; ++i) {
+    stgy.move(boardPtr, seqPtr);
+  }
+  s_countAllocations = false;
+  return s_allocations;
+}
+
+TEST(SearchArena, NoAllocationsPerMove) {
+  using PackedType = threes::game::PackedBoard4<>;
+
+  EXPECT_EQ( 0ul, allocationsPerSearch<Board4>("3;4") );
+  EXPECT_EQ( 0ul, allocationsPerSearch<Board4>("2;1;exact") );
+  EXPECT_EQ( 0ul, allocationsPerSearch<Board4>("3;4;tt=1") );
+  EXPECT_EQ( 0ul, allocationsPerSearch<Board4>("2;1;prune") );
+  EXPECT_EQ( 0ul, allocationsPerSearch<PackedType>("3;4") );
+  EXPECT_EQ( 0ul, allocationsPerSearch<PackedType>("2;1;exact") );
+}
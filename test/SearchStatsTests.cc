@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <src/SearchStats.h>
+#include <src/TreeStrategy.h>
+#include <src/Board.h>
+
+#include <sstream>
+
+using threes::game::Card;
+
+TEST(SearchStats, LatencyHistogram) {
+  threes::game::LatencyHistogram hist;
+  EXPECT_EQ( 0.0, hist.percentileMicros(50) );
+
+  // 0.5us, 3us, 3us, 100us
+  hist.add(std::chrono::nanoseconds(500));
+  hist.add(std::chrono::microseconds(3));
+  hist.add(std::chrono::microseconds(3));
+  hist.add(std::chrono::microseconds(100));
+  EXPECT_EQ( 4u, hist.count() );
+  EXPECT_EQ( 1u, hist.bucket(0) );  // under 1us
+  EXPECT_EQ( 2u, hist.bucket(2) );  // [2, 4)
+  EXPECT_EQ( 1u, hist.bucket(7) );  // [64, 128)
+  EXPECT_DOUBLE_EQ( 4.0, hist.percentileMicros(50) );
+  EXPECT_DOUBLE_EQ( 4.0, hist.percentileMicros(30) ); // rank ceil(1.2) = 2
+  EXPECT_DOUBLE_EQ( 100.0, hist.percentileMicros(100) ); // capped at the max seen
+  EXPECT_DOUBLE_EQ( 26.625, hist.meanMicros() );
+
+  threes::game::LatencyHistogram other;
+  other.add(std::chrono::seconds(10000)); // off the end, lands in the last bucket
+  hist.merge(other);
+  EXPECT_EQ( 5u, hist.count() );
+  EXPECT_EQ( 1u, hist.bucket(threes::game::LatencyHistogram::NumBuckets-1) );
+  EXPECT_DOUBLE_EQ( 1e10, hist.maxMicros() );
+}
+
+TEST(SearchStats, ExpectiMaxCounters) {
+  using BoardType = threes::game::Board<4>;
+  using SeqType = threes::game::Kamikaze28Sequence<BoardType>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(12);
+  tiles[5] = Card(1);
+  tiles[6] = Card(2);
+  tiles[10] = Card(3);
+  tiles[15] = Card(6);
+  auto boardPtr = std::make_unique<BoardType>(tiles);
+  SeqType seq(threes::game::threesDefaultShuffleDeck());
+  seq.seed(3);
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seqPtr(seq.clone());
+
+  threes::game::ExpectiMaxTree<BoardType> tree(threes::game::ExpectiMaxConfig::fromStr("2;1;exact;tt=1"));
+  tree.move(boardPtr, seqPtr);
+  const uint64_t firstNodes = tree.lastSearchNodes();
+  const threes::game::SearchStats stats = tree.stats();
+
+  // a root chance node per move, then their player children's moves, then leaves
+  EXPECT_EQ( tree.lastSearchNodes(), stats.totalNodes() );
+  // the last layer is scored once per board, however many moves lead to it
+  EXPECT_GT( stats.leafEvals, 0u );
+  EXPECT_LE( stats.leafEvals, stats.nodesPerPly[2] );
+  EXPECT_EQ( stats.nodesPerPly[1] + stats.nodesPerPly[2], stats.playerChildren );
+  EXPECT_EQ( stats.chanceNodes, stats.cacheProbes - stats.cacheHits );
+  EXPECT_GT( stats.chanceChildren, stats.chanceNodes );
+
+  // a second move adds on
+  tree.move(boardPtr, seqPtr);
+  EXPECT_EQ( firstNodes + tree.lastSearchNodes(), tree.stats().totalNodes() );
+
+  std::ostringstream json;
+  threes::game::SearchStats merged;
+  merged.merge(stats);
+  merged.merge(stats);
+  EXPECT_EQ( 2*stats.totalNodes(), merged.totalNodes() );
+  merged.writeJson(json);
+  EXPECT_NE( std::string::npos, json.str().find("\"nodes_per_ply\": [") );
+  EXPECT_NE( std::string::npos, json.str().find("\"move_latency\": {\"count\": 0") );
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include <src/StaticGameDriver.h>
+#include <src/BatchRunner.h>
+#include <src/TreeStrategy.h>
+#include <src/Board.h>
+#include "TestCreators.h"
+
+namespace {
+  using BoardType = threes::game::Board<4>;
+  using SeqType = threes::game::Kamikaze28Sequence<BoardType>;
+  using TreeType = threes::game::ExpectiMaxTree<BoardType>;
+}
+
+TEST(StaticGameDriver, SameGamesAsVirtual) {
+  threes::test::registerStaticTestGames<BoardType>();
+
+  for(const bool commonRandom : {false, true}) {
+    for(uint64_t seed = 1; seed <= 4; ++seed) {
+      threes::game::IThreesStgy<BoardType>::ThreesStgyPtr stgyPtr(
+	threes::game::IThreesStgy<BoardType>::s_factory.create("emtree", "1;1"));
+      threes::game::GameDriverStgy<BoardType> virtualGame("k28d", "default", 9, stgyPtr, false, seed);
+      virtualGame.setCommonRandom(commonRandom);
+      const uint64_t virtualScore = virtualGame.play();
+
+      TreeType tree(threes::game::ExpectiMaxConfig::fromStr("1;1"));
+      threes::game::StaticGameDriver<BoardType, SeqType, TreeType> staticGame("default", 9, tree, seed);
+      staticGame.setCommonRandom(commonRandom);
+      EXPECT_EQ( virtualScore, staticGame.play() );
+      EXPECT_EQ( virtualGame.board().underlyingDataRef(), staticGame.board().underlyingDataRef() );
+    }
+  }
+
+  // and through the batch runner's name lookup
+  threes::game::BatchConfig config;
+  config.numGames = 12;
+  config.numThreads = 2;
+  config.seed = 99;
+  const threes::game::BatchResult virtualBatch = threes::game::runBatch<BoardType>(config);
+  config.staticGames = true;
+  const threes::game::BatchResult staticBatch = threes::game::runBatch<BoardType>(config);
+  EXPECT_EQ( virtualBatch.scores, staticBatch.scores );
+  EXPECT_EQ( virtualBatch.maxCards, staticBatch.maxCards );
+}
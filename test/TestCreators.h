@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * Factory registrations shared by the tests. Every test binary runs all of
+ * its tests in one process and ObjectFromStrFactory asserts on a second
+ * registration of a name, so tests call these instead of registering
+ * creators themselves. Each registers its names once per process, however
+ * many tests call it.
+ */
+
+#include <src/CardSequence.h>
+#include <src/GameDriverStrategy.h>
+#include <src/StaticGameDriver.h>
+#include <src/TreeStrategy.h>
+
+namespace threes {
+  namespace test {
+
+    // "k28d" sequences and the "random" and "emtree" strategies for BOARD
+    template<class BOARD>
+    void registerTestCreators() {
+      static const bool registered = []() {
+	game::ICardSequence<BOARD>::s_factory.registerCreator("k28d", game::Kamikaze28Sequence<BOARD>::create);
+	game::IThreesStgy<BOARD>::s_factory.registerCreator("random", game::RandomStgy<BOARD>::create);
+	game::IThreesStgy<BOARD>::s_factory.registerCreator("emtree", game::ExpectiMaxTree<BOARD>::create);
+	return true;
+      }();
+      (void)registered;
+    }
+
+    // the above, plus the "k28d/random" and "k28d/emtree" static games
+    template<class BOARD>
+    void registerStaticTestGames() {
+      registerTestCreators<BOARD>();
+      static const bool registered = []() {
+	using SeqType = game::Kamikaze28Sequence<BOARD>;
+	game::registerStaticGames<BOARD, SeqType, game::RandomStgy<BOARD>>("k28d/random");
+	game::registerStaticGames<BOARD, SeqType, game::ExpectiMaxTree<BOARD>>("k28d/emtree");
+	return true;
+      }();
+      (void)registered;
+    }
+
+  } // namespace test
+} // namespace threes
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <src/Tournament.h>
+#include <src/TreeStrategy.h>
+#include <src/Board.h>
+#include "TestCreators.h"
+
+#include <cmath>
+
+using threes::game::TournamentVerdict;
+
+TEST(Tournament, MetricTestBounds) {
+  const double lower = std::log(0.05 / 0.95);
+  const double upper = std::log(0.95 / 0.05);
+
+  // the llr grows with the evidence for delta over 0
+  EXPECT_DOUBLE_EQ( 0.0, threes::game::normalLlr(5.0, 1.0, 10.0) );
+  EXPECT_DOUBLE_EQ( 50.0, threes::game::normalLlr(10.0, 1.0, 10.0) );
+
+  threes::game::MetricTest test("score", 10.0);
+  test.update(4.0, 100.0, lower, upper);
+  EXPECT_EQ( TournamentVerdict::Undecided, test.verdict() );
+  test.update(-12.0, 4.0, lower, upper);
+  EXPECT_EQ( TournamentVerdict::SecondBetter, test.verdict() );
+  EXPECT_DOUBLE_EQ( 2.0, test.stdError );
+
+  threes::game::MetricTest same("score", 10.0);
+  same.update(0.5, 4.0, lower, upper);
+  EXPECT_EQ( TournamentVerdict::NoDifference, same.verdict() );
+  // a decided side stays decided
+  same.update(20.0, 4.0, lower, upper);
+  EXPECT_EQ( TournamentVerdict::NoDifference, same.verdict() );
+}
+
+TEST(Tournament, ConfigFromStr) {
+  const auto config = threes::game::TournamentConfig::fromStr("games=500;min=20;round=10;score=100;card=192;seed=7;paired");
+  EXPECT_EQ( 500u, config.maxGames );
+  EXPECT_EQ( 20u, config.minGames );
+  EXPECT_EQ( 10u, config.roundGames );
+  EXPECT_DOUBLE_EQ( 100.0, config.scoreDelta );
+  EXPECT_EQ( 192u, config.targetCard );
+  EXPECT_EQ( 7u, config.seed );
+  EXPECT_DOUBLE_EQ( 0.05, config.alpha );
+  EXPECT_TRUE( config.paired );
+  EXPECT_FALSE( threes::game::TournamentConfig::fromStr("").paired );
+}
+
+TEST(Tournament, StopsEarly) {
+  using BoardType = threes::game::Board<4>;
+  threes::test::registerTestCreators<BoardType>();
+
+  threes::game::TournamentConfig config =
+    threes::game::TournamentConfig::fromStr("games=1000;min=20;round=10;seed=11;threads=2");
+  config.stgyNames = {{"random", "emtree"}};
+  config.stgyArgs = {{"", "1;1"}};
+
+  const threes::game::TournamentResult result = threes::game::runTournament<BoardType>(config);
+  EXPECT_EQ( TournamentVerdict::SecondBetter, result.verdict );
+  EXPECT_LT( result.gamesPerStgy(), 1000u );
+  EXPECT_EQ( result.gamesPerStgy(), result.results[1].scores.size() );
+  EXPECT_LT( result.results[0].meanScore(), result.results[1].meanScore() );
+
+  // same seed, same games
+  const threes::game::TournamentResult again = threes::game::runTournament<BoardType>(config);
+  EXPECT_EQ( result.results[0].scores, again.results[0].scores );
+  EXPECT_EQ( result.results[1].scores, again.results[1].scores );
+}
+
+TEST(Tournament, PairedSameGames) {
+  using BoardType = threes::game::Board<4>;
+  threes::test::registerTestCreators<BoardType>();
+
+  // a strategy against itself on the same games plays them identically
+  const threes::game::TournamentConfig config =
+    threes::game::TournamentConfig::fromStr("games=1000;min=30;round=10;seed=3;paired");
+  const threes::game::TournamentResult result = threes::game::runTournament<BoardType>(config);
+  EXPECT_EQ( TournamentVerdict::NoDifference, result.verdict );
+  EXPECT_LT( result.gamesPerStgy(), 1000u );
+  EXPECT_EQ( result.results[0].scores, result.results[1].scores );
+  EXPECT_DOUBLE_EQ( 0.0, result.tests[0].diff );
+  EXPECT_DOUBLE_EQ( 0.0, result.tests[0].confidenceInterval().second );
+}
@@ -0,0 +1,102 @@
+#include <src/TranspositionTable.h>
+#include <src/Hashing.h>
+#include <src/CardSequence.h>
+#include <src/TreeStrategy.h>
+#include <src/Board.h>
+#include <gtest/gtest.h>
+
+using threes::game::Card;
+using threes::game::TranspositionTable;
+
+TEST(TranspositionTable, ProbeStore) {
+  TranspositionTable tt(1 << 16, TranspositionTable::REPLACE_DEPTH_PREFERRED);
+  EXPECT_EQ( (1u << 16) / sizeof(TranspositionTable::Entry), tt.numEntries() );
+
+  const uint64_t key = 0x123456789ABCDEF0ULL;
+  EXPECT_EQ( nullptr, tt.probe(key) );
+  tt.store(key, 3, 42.5, 1);
+
+  const TranspositionTable::Entry* entry = tt.probe(key);
+  ASSERT_NE( nullptr, entry );
+  EXPECT_EQ( 42.5, entry->value );
+  EXPECT_EQ( 1u, entry->count );
+  EXPECT_EQ( 3u, entry->depth );
+
+  // same bucket, different check bits: a miss
+  EXPECT_EQ( nullptr, tt.probe(key ^ (1ULL << 40)) );
+  EXPECT_EQ( 1u, tt.hits() );
+  EXPECT_EQ( 2u, tt.misses() );
+
+  tt.clear();
+  EXPECT_EQ( nullptr, tt.probe(key) );
+}
+
+TEST(TranspositionTable, DepthPreferred) {
+  // a single bucket, so every key competes for the same four slots
+  TranspositionTable tt(64, TranspositionTable::REPLACE_DEPTH_PREFERRED);
+  EXPECT_EQ( 4u, tt.numEntries() );
+
+  for(uint64_t i = 0; i < 4; ++i) {
+    tt.store((i+1) << 32, 5, 1.0, 1);
+  }
+  // shallower than everything in the bucket, dropped
+  tt.store(99ULL << 32, 1, 2.0, 1);
+  EXPECT_EQ( nullptr, tt.probe(99ULL << 32) );
+
+  // once the search moves on old entries are fair game
+  tt.newSearch();
+  tt.store(99ULL << 32, 1, 2.0, 1);
+  EXPECT_NE( nullptr, tt.probe(99ULL << 32) );
+  EXPECT_EQ( 1u, tt.evictions() );
+}
+
+TEST(TranspositionTable, ReplaceAlways) {
+  TranspositionTable tt(64, TranspositionTable::REPLACE_ALWAYS, true);
+  tt.store(1ULL << 32, 5, 1.0, 1);
+  tt.store(5ULL << 32, 1, 2.0, 1); // same slot (check % 4), always wins
+  EXPECT_EQ( nullptr, tt.probe(1ULL << 32) );
+  ASSERT_NE( nullptr, tt.probe(5ULL << 32) );
+  EXPECT_EQ( 2.0, tt.probe(5ULL << 32)->value );
+}
+
+TEST(TranspositionTable, SequenceHash) {
+  using BoardType = threes::game::Board<4>;
+  std::unique_ptr<BoardType> noBoard;
+  threes::game::Kamikaze28Sequence<BoardType>
+    seqA( threes::game::threesDefaultShuffleDeck(), threes::game::alwaysReturnNextIndex,
+	  threes::game::alwaysFalse<std::unique_ptr<BoardType>> );
+  threes::game::Kamikaze28Sequence<BoardType>
+    seqB( threes::game::threesDefaultShuffleDeck(), threes::game::alwaysReturnNextIndex,
+	  threes::game::alwaysFalse<std::unique_ptr<BoardType>> );
+
+  EXPECT_EQ( seqA.hash(), seqB.hash() );
+  seqA.draw(noBoard);
+  EXPECT_NE( seqA.hash(), seqB.hash() );
+  seqB.draw(noBoard);
+  EXPECT_EQ( seqA.hash(), seqB.hash() );
+}
+
+TEST(TranspositionTable, ExpectiMaxTree) {
+  using BoardType = threes::game::Board<4>;
+  using TreeStgy = threes::game::ExpectiMaxTree<BoardType>;
+
+  threes::game::ExpectiMaxConfig config( threes::game::ExpectiMaxConfig::fromStr("2;4;tt=1;ttpolicy=always") );
+  EXPECT_EQ( 2u, config.depth );
+  EXPECT_EQ( 4u, config.samples );
+  EXPECT_EQ( 1u, config.ttMegabytes );
+  EXPECT_EQ( TranspositionTable::REPLACE_ALWAYS, config.ttPolicy );
+
+  TreeStgy stgy(config);
+  ASSERT_NE( nullptr, stgy.transpositionTable() );
+
+  std::vector<Card> initialCards{Card(1), Card(2), Card(3), Card(3)};
+  std::vector<unsigned> idx{0, 5, 10, 15};
+  std::unique_ptr<BoardType> board = std::make_unique<BoardType>(initialCards, idx);
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seq(
+    new threes::game::Kamikaze28Sequence<BoardType>(threes::game::threesDefaultShuffleDeck()) );
+
+  const threes::game::ShiftDirection dir = stgy.move(board, seq);
+  EXPECT_TRUE( board->canShift(dir) );
+  // repeated samples of the same root move land on the same node
+  EXPECT_GT( stgy.transpositionTable()->hits(), 0u );
+}
@@ -3,6 +3,8 @@
 #include <src/TreeStrategy.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+
 
 // random generator that always returns min value in the
 // random range for testing purposes
@@ -263,3 +265,133 @@ TEST(TreeStrategy, TotalScore) {
   EXPECT_EQ( stgy.valueFunction(trapR), 21.0 + 2.0 - 5.0);
   
 }
+
+// every leaf worth the same means the probabilities must sum to one
+template<class BOARD>
+class ConstantValueTree : public threes::game::ExpectiMaxTree<BOARD> {
+public:
+  using threes::game::ExpectiMaxTree<BOARD>::ExpectiMaxTree;
+  virtual double valueFunction(const BOARD& board) override { (void)board; return 5.0; }
+};
+
+TEST(TreeStrategy, ExactExpectiMax) {
+  using BoardType = threes::game::Board<4>;
+  using SeqType = threes::game::Kamikaze28Sequence<BoardType>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(96);
+  tiles[5] = Card(1);
+  tiles[6] = Card(2);
+  tiles[10] = Card(3);
+  tiles[15] = Card(6);
+  BoardType board(tiles); // max card 96, so bonus cards are in play
+  SeqType seq(threes::game::threesDefaultShuffleDeck());
+  seq.seed(11);
+
+  ConstantValueTree<BoardType> constant(threes::game::ExpectiMaxConfig::fromStr("2;1;exact"));
+  for(auto dir : { threes::game::DIRECTION_UP, threes::game::DIRECTION_DOWN,
+	threes::game::DIRECTION_LEFT, threes::game::DIRECTION_RIGHT }) {
+    if(board.canShift(dir)) {
+      EXPECT_DOUBLE_EQ( 5.0, constant.expectedValue(board, seq, dir, 2) );
+    }
+  }
+
+  // exact search has no randomness, and a transposition table only saves work
+  auto boardPtr = std::make_unique<BoardType>(board);
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seqPtr(seq.clone());
+  threes::game::ExpectiMaxTree<BoardType> plain(threes::game::ExpectiMaxConfig::fromStr("2;1;exact"));
+  threes::game::ExpectiMaxTree<BoardType> reseeded(threes::game::ExpectiMaxConfig::fromStr("2;1;exact"));
+  threes::game::ExpectiMaxTree<BoardType> cached(threes::game::ExpectiMaxConfig::fromStr("2;1;exact;tt=1"));
+  reseeded.seed(99);
+  const threes::game::ShiftDirection move = plain.move(boardPtr, seqPtr);
+  EXPECT_EQ( move, reseeded.move(boardPtr, seqPtr) );
+  EXPECT_EQ( move, cached.move(boardPtr, seqPtr) );
+  EXPECT_DOUBLE_EQ( plain.expectedValue(board, seq, move, 2),
+		    cached.expectedValue(board, seq, move, 2) );
+}
+
+TEST(TreeStrategy, AnytimeSearch) {
+  using BoardType = threes::game::Board<4>;
+  using TreeStgy = threes::game::ExpectiMaxTree<BoardType>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(48);
+  tiles[1] = Card(1);
+  tiles[5] = Card(2);
+  tiles[6] = Card(3);
+  tiles[10] = Card(6);
+  tiles[15] = Card(12);
+  auto boardPtr = std::make_unique<BoardType>(tiles);
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seqPtr(
+    new threes::game::Kamikaze28Sequence<BoardType>(threes::game::threesDefaultShuffleDeck()) );
+  seqPtr->seed(17);
+
+  // with room to finish every iteration it plays the fixed depth move
+  TreeStgy fixed(threes::game::ExpectiMaxConfig::fromStr("2;1;exact"));
+  TreeStgy unbounded(threes::game::ExpectiMaxConfig::fromStr("2;1;exact;nodes=100000000"));
+  EXPECT_EQ( fixed.move(boardPtr, seqPtr), unbounded.move(boardPtr, seqPtr) );
+  EXPECT_EQ( 2u, unbounded.lastSearchDepth() );
+
+  // a node budget stops the deepening early, but depth 1 always completes
+  TreeStgy nodeBound(threes::game::ExpectiMaxConfig::fromStr("8;2;nodes=2000"));
+  nodeBound.move(boardPtr, seqPtr);
+  EXPECT_GE( nodeBound.lastSearchDepth(), 1u );
+  EXPECT_LT( nodeBound.lastSearchDepth(), 8u );
+  EXPECT_LE( nodeBound.lastSearchNodes(), 2000u );
+
+  TreeStgy tiny(threes::game::ExpectiMaxConfig::fromStr("8;2;nodes=1"));
+  tiny.move(boardPtr, seqPtr);
+  EXPECT_EQ( 1u, tiny.lastSearchDepth() );
+
+  // a time budget bounds the move time
+  TreeStgy timed(threes::game::ExpectiMaxConfig::fromStr("12;4;timems=20"));
+  const auto start = std::chrono::steady_clock::now();
+  timed.move(boardPtr, seqPtr);
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_LT( elapsed.count(), 500.0 );
+  EXPECT_GE( timed.lastSearchDepth(), 1u );
+  EXPECT_LT( timed.lastSearchDepth(), 12u );
+}
+
+TEST(TreeStrategy, PrunedExpectiMax) {
+  using BoardType = threes::game::Board<4>;
+  using TreeStgy = threes::game::ExpectiMaxTree<BoardType>;
+
+  BoardType::storage_t tiles{};
+  tiles[0] = Card(48);
+  tiles[1] = Card(1);
+  tiles[5] = Card(2);
+  tiles[6] = Card(3);
+  tiles[10] = Card(6);
+  tiles[15] = Card(12);
+  auto boardPtr = std::make_unique<BoardType>(tiles);
+  threes::game::ICardSequence<BoardType>::ICardSeqPtr seqPtr(
+    new threes::game::Kamikaze28Sequence<BoardType>(threes::game::threesDefaultShuffleDeck()) );
+  seqPtr->seed(23);
+  threes::game::RngContext boardRng(29);
+
+  // cutoffs only skip work, every position of a game gets the same move
+  TreeStgy exact(threes::game::ExpectiMaxConfig::fromStr("2;1;exact"));
+  TreeStgy pruned(threes::game::ExpectiMaxConfig::fromStr("2;1;prune"));
+  TreeStgy cached(threes::game::ExpectiMaxConfig::fromStr("2;1;prune;tt=1"));
+  uint64_t exactNodes(0), prunedNodes(0), cutoffs(0);
+  auto anyMove = [&boardPtr]() {
+    for(auto dir : { threes::game::DIRECTION_UP, threes::game::DIRECTION_DOWN,
+	  threes::game::DIRECTION_LEFT, threes::game::DIRECTION_RIGHT }) {
+      if(boardPtr->canShift(dir)) { return true; }
+    }
+    return false;
+  };
+  for(unsigned i = 0; i < 40 && anyMove(); ++i) {
+    const threes::game::ShiftDirection move = exact.move(boardPtr, seqPtr);
+    EXPECT_EQ( move, pruned.move(boardPtr, seqPtr) );
+    EXPECT_EQ( move, cached.move(boardPtr, seqPtr) );
+    exactNodes += exact.lastSearchNodes();
+    prunedNodes += pruned.lastSearchNodes();
+    cutoffs += pruned.lastSearchCutoffs();
+
+    boardPtr->shiftBoard(move, seqPtr->draw(boardPtr), boardRng);
+  }
+  EXPECT_GT( cutoffs, 0u );
+  EXPECT_LT( prunedNodes, exactNodes );
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <Utils.h>
+#include <Rng.h>
 
 #include <string>
 
@@ -28,3 +29,37 @@ TEST(RegisterTest, StrSplit) {
   EXPECT_EQ(testv3[2], "TwoDelim");
   
 }
+
+TEST(RegisterTest, ParseKeyValues) {
+  auto argv( ro::strsplit("3;1;tt=64;hugepages", ";") );
+  auto opts( ro::parseKeyValues( std::vector<std::string>(argv.begin()+2, argv.end()) ) );
+  EXPECT_EQ(opts.size(), 2);
+  EXPECT_EQ(opts["tt"], "64");
+  EXPECT_EQ(opts["hugepages"], "1");
+  EXPECT_TRUE(opts.find("depth") == opts.end());
+}
+
+TEST(RegisterTest, RngContext) {
+  threes::game::RngContext a(42), b(42), c(43);
+  for(unsigned i = 0; i < 100; ++i) {
+    const uint64_t va = a();
+    EXPECT_EQ( va, b() );
+    EXPECT_NE( va, c() );
+  }
+
+  // split streams are reproducible but distinct from the parent
+  threes::game::RngContext childA = a.split();
+  threes::game::RngContext childB = b.split();
+  EXPECT_EQ( childA, childB );
+  EXPECT_EQ( a, b );
+  EXPECT_NE( childA(), a() );
+
+  for(unsigned i = 0; i < 1000; ++i) {
+    const unsigned v = a.uniformInt(3, 7);
+    EXPECT_GE( v, 3u );
+    EXPECT_LE( v, 7u );
+    const double d = a.uniform01();
+    EXPECT_GE( d, 0.0 );
+    EXPECT_LT( d, 1.0 );
+  }
+}